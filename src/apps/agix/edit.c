@@ -473,13 +473,21 @@ static int save_file(void) {
     int fd = sys_open(ed.filename, "w");
     if (fd < 0) return -1;
     
+    /* The file is written a line at a time; reserve it all up front */
+    uint32_t total = 0;
+    for (int i = 0; i < ed.line_count; i++)
+        total += strlen(ed.lines[i]) + 1;
+    sys_preallocate(fd, total);
+    
     for (int i = 0; i < ed.line_count; i++) {
         int len = strlen(ed.lines[i]);
         sys_write_file(fd, ed.lines[i], len);
         sys_write_file(fd, "\n", 1);
     }
     
+    /* Closing gives back the unused reservation, so sync after that */
     sys_close(fd);
+    sys_sync();
     ed.dirty = 0;
     return 0;
 }
@@ -58,6 +58,8 @@ OSLET_APP("File Manager", OSLET_KIND_GIX, "C:/ICONS/CABINET.ICO", OSLET_APP_FLAG
 #define MAX_FILE_COLS        9
 #define MAX_FILE_ROWS        6
 
+#define COPY_CHUNK           (256 * 1024)  /* bytes per sys_copy_range call */
+
 typedef struct {
     char name[64];
     char full_path[256];
@@ -1094,15 +1096,18 @@ static int copy_file_data(const char *src, const char *dst) {
         return -1;
     }
 
-    char buffer[512];
-    int bytes_read;
+    int copied;
     sys_mouse_busy_begin();
-    while ((bytes_read = sys_read(src_fd, buffer, sizeof(buffer))) > 0)
-        sys_write_file(dst_fd, buffer, bytes_read);
+    while ((copied = sys_copy_range(src_fd, dst_fd, COPY_CHUNK)) > 0)
+        sys_yield();
 
     sys_close(src_fd);
     sys_close(dst_fd);
     sys_mouse_busy_end();
+    if (copied < 0) {
+        sys_unlink(dst);
+        return -1;
+    }
     return 0;
 }
 
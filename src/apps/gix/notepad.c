@@ -106,9 +106,11 @@ static int save_text_to_file(const char *path, const char *text) {
         }
     }
 
+    /* A saved document should survive the power going off */
+    int rc = sys_fsync(fd);
     sys_close(fd);
     sys_mouse_busy_end();
-    return 0;
+    return rc;
 }
 
 static char *get_textbox_buffer(gui_control_t *ctrl) {
@@ -165,7 +165,11 @@ static const char *exception_names[] = {
 void isr_common_stub(int vector, int error_code, uint32_t eip) {
     /* Check if graphics mode is active */
     if (gfx_is_active()) {
-        /* Draw blue screen of death */
+        /* Draw blue screen of death, whatever was being clipped or
+           whichever surface was being drawn into */
+        gfx_seize();
+        gfx_end_surface();
+        gfx_reset_clip();
         gfx_fillrect(0, 0, GFX_WIDTH, GFX_HEIGHT, COLOR_BLUE);
         
         /* Draw header */
@@ -459,11 +459,13 @@ int ahci_write_sectors(uint32_t lba, uint8_t sector_count, const void *buffer) {
         if (run_command(AHCI_ATA_WRITE_DMA_EXT, lba + i, (void *)(src + (i * 512)), 1, 1) != 0)
             return -1;
     }
+    return 0;
+}
 
+int ahci_flush_cache(void) {
     if (ahci_flush_supported &&
         run_command(AHCI_ATA_FLUSH_EXT, 0, NULL, 0, 0) != 0) {
         ahci_flush_supported = 0;
     }
-
     return 0;
 }
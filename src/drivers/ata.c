@@ -436,6 +436,22 @@ int ata_write_sectors(uint32_t lba, uint8_t sector_count, const void *buffer) {
         }
     }
 
+    ata_release();
+    return 0;
+}
+
+/* Commit the drive's write cache. Flush errors are not treated as fatal:
+ * the sectors were accepted when they were written. */
+int ata_flush_cache(void) {
+    if (ata_usb_mode) return 0;
+    if (ata_ahci_mode) {
+        ata_acquire();
+        int result = ahci_flush_cache();
+        ata_release();
+        return result;
+    }
+
+    ata_acquire();
     /* Only attempt cache flush if we believe it's supported. If we detect
      * that the controller returns ERR for flush (common in PCem), mark it
      * unsupported for the rest of the boot to avoid noisy loops. */
@@ -460,8 +476,6 @@ int ata_write_sectors(uint32_t lba, uint8_t sector_count, const void *buffer) {
         }
     }
 
-    /* Don't treat flush errors as fatal; assume sector writes succeeded if
-     * ata_write_sectors returned success earlier. */
     ata_release();
     return 0;
 }
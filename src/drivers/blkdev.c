@@ -0,0 +1,342 @@
+#include "blkdev.h"
+#include "ata.h"
+#include "../console.h"
+#include "../mem/heap.h"
+#include "../task/task.h"
+#include "../task/timer.h"
+
+/* Per-class deadlines in milliseconds. A request whose deadline has passed
+ * is dispatched ahead of the elevator order. */
+static const uint32_t blk_read_expire_ms[BLK_PRIO_CLASSES]  = { 100, 500, 5000 };
+static const uint32_t blk_write_expire_ms[BLK_PRIO_CLASSES] = { 500, 5000, 20000 };
+
+static blkdev_t blk_devices[BLK_MAX_DEVICES];
+static blkdev_t *blk_boot = NULL;
+
+#ifdef FAT32_HOST
+/* tools/fathost runs this file as an ordinary single-threaded process. */
+static inline uint32_t blk_irq_save(void) {
+    return 0;
+}
+
+static inline void blk_irq_restore(uint32_t eflags) {
+    (void)eflags;
+}
+#else
+static inline uint32_t blk_irq_save(void) {
+    uint32_t eflags;
+    __asm__ volatile("pushfl\n\tpopl %0\n\tcli" : "=r"(eflags) :: "memory");
+    return eflags;
+}
+
+static inline void blk_irq_restore(uint32_t eflags) {
+    __asm__ volatile("pushl %0\n\tpopfl" :: "r"(eflags) : "cc", "memory");
+}
+#endif
+
+static int hd_read(blkdev_t *dev, uint32_t lba, uint32_t count, void *buf) {
+    (void)dev;
+    return ata_read_sectors(lba, (uint8_t)count, buf);
+}
+
+static int hd_write(blkdev_t *dev, uint32_t lba, uint32_t count, const void *buf) {
+    (void)dev;
+    return ata_write_sectors(lba, (uint8_t)count, buf);
+}
+
+static int hd_flush(blkdev_t *dev) {
+    (void)dev;
+    return ata_flush_cache();
+}
+
+void blk_init(void) {
+    memset_s(blk_devices, 0, sizeof(blk_devices));
+    /* The boot disk goes through ata_*_sectors, which already switches
+     * between IDE, AHCI and USB depending on what was probed. */
+    blk_boot = blk_register("hd0", 0, BLK_MAX_TRANSFER, hd_read, hd_write, NULL);
+    if (blk_boot) blk_boot->flush = hd_flush;
+}
+
+blkdev_t *blk_register(const char *name, uint32_t sector_count, uint32_t max_sectors,
+                       int (*read)(blkdev_t*, uint32_t, uint32_t, void*),
+                       int (*write)(blkdev_t*, uint32_t, uint32_t, const void*),
+                       void *priv) {
+    if (!name || !read) return NULL;
+
+    for (int i = 0; i < BLK_MAX_DEVICES; i++) {
+        blkdev_t *dev = &blk_devices[i];
+        if (dev->registered) continue;
+
+        memset_s(dev, 0, sizeof(*dev));
+        strcpy_s(dev->name, name, sizeof(dev->name));
+        dev->sector_count = sector_count;
+        if (max_sectors == 0 || max_sectors > 255) max_sectors = 255;
+        dev->max_sectors = max_sectors;
+        dev->read = read;
+        dev->write = write;
+        dev->priv = priv;
+        dev->registered = 1;
+        return dev;
+    }
+    return NULL;
+}
+
+blkdev_t *blk_find(const char *name) {
+    if (!name) return NULL;
+    for (int i = 0; i < BLK_MAX_DEVICES; i++) {
+        if (blk_devices[i].registered && strcmp_s(blk_devices[i].name, name) == 0)
+            return &blk_devices[i];
+    }
+    return NULL;
+}
+
+blkdev_t *blk_boot_device(void) {
+    return blk_boot;
+}
+
+blk_prio_t blk_current_prio(void) {
+    task_t *t = task_get_current();
+    if (!t) return BLK_PRIO_BE;
+    switch (t->priority) {
+        case PRIORITY_HIGH: return BLK_PRIO_RT;
+        case PRIORITY_IDLE: return BLK_PRIO_IDLE;
+        default:            return BLK_PRIO_BE;
+    }
+}
+
+/* Split a transfer into backend-sized commands. */
+static int blk_transfer(blkdev_t *dev, int write, uint32_t lba, uint32_t count, uint8_t *buf) {
+    while (count > 0) {
+        uint32_t n = count > dev->max_sectors ? dev->max_sectors : count;
+        int res = write ? dev->write(dev, lba, n, buf) : dev->read(dev, lba, n, buf);
+        dev->stats.commands++;
+        if (res != 0) {
+            dev->stats.errors++;
+            return -1;
+        }
+        if (write) dev->stats.sectors_written += n;
+        else dev->stats.sectors_read += n;
+        lba += n;
+        count -= n;
+        buf += n * BLK_SECTOR_SIZE;
+    }
+    return 0;
+}
+
+static void blk_queue_insert(blkdev_t *dev, blk_request_t *req) {
+    blk_request_t **pp = &dev->queue[req->prio];
+    while (*pp && (*pp)->lba <= req->lba)
+        pp = &(*pp)->next;
+    req->next = *pp;
+    *pp = req;
+}
+
+static void blk_queue_unlink(blkdev_t *dev, blk_request_t *req) {
+    blk_request_t **pp = &dev->queue[req->prio];
+    while (*pp && *pp != req)
+        pp = &(*pp)->next;
+    if (*pp) *pp = req->next;
+    req->next = NULL;
+}
+
+/* Deadline first, then C-LOOK within the most urgent non-empty class:
+ * the lowest LBA at or past the head, wrapping to the lowest overall. */
+static blk_request_t *blk_pick(blkdev_t *dev) {
+    uint32_t now = timer_get_ticks();
+    blk_request_t *expired = NULL;
+
+    for (int c = 0; c < BLK_PRIO_CLASSES; c++) {
+        for (blk_request_t *r = dev->queue[c]; r; r = r->next) {
+            if ((int32_t)(now - r->deadline) < 0) continue;
+            if (!expired || (int32_t)(r->deadline - expired->deadline) < 0)
+                expired = r;
+        }
+    }
+    if (expired) {
+        dev->stats.expired++;
+        return expired;
+    }
+
+    for (int c = 0; c < BLK_PRIO_CLASSES; c++) {
+        if (!dev->queue[c]) continue;
+        for (blk_request_t *r = dev->queue[c]; r; r = r->next) {
+            if (r->lba >= dev->head_lba) return r;
+        }
+        return dev->queue[c];
+    }
+    return NULL;
+}
+
+/* Find a queued request of the same direction that starts where the batch
+ * currently ends, in any class. */
+static blk_request_t *blk_find_adjacent(blkdev_t *dev, uint32_t lba, uint8_t write) {
+    for (int c = 0; c < BLK_PRIO_CLASSES; c++) {
+        for (blk_request_t *r = dev->queue[c]; r; r = r->next) {
+            if (r->lba > lba) break;
+            if (r->lba == lba && r->write == write) return r;
+        }
+    }
+    return NULL;
+}
+
+static int blk_take_batch(blkdev_t *dev, blk_request_t **batch, uint32_t *out_lba, uint32_t *out_count) {
+    uint32_t eflags = blk_irq_save();
+
+    blk_request_t *first = blk_pick(dev);
+    if (!first) {
+        blk_irq_restore(eflags);
+        return 0;
+    }
+    blk_queue_unlink(dev, first);
+
+    int n = 1;
+    batch[0] = first;
+    uint32_t lba = first->lba;
+    uint32_t count = first->count;
+
+    while (n < BLK_MAX_MERGE) {
+        blk_request_t *next = blk_find_adjacent(dev, lba + count, first->write);
+        if (!next || count + next->count > BLK_MAX_TRANSFER) break;
+        blk_queue_unlink(dev, next);
+        batch[n++] = next;
+        count += next->count;
+        dev->stats.merged++;
+    }
+
+    blk_irq_restore(eflags);
+    *out_lba = lba;
+    *out_count = count;
+    return n;
+}
+
+static void blk_dispatch(blkdev_t *dev, blk_request_t **batch, int n, uint32_t lba, uint32_t count) {
+    int write = batch[0]->write;
+    int contiguous = 1;
+    int result;
+
+    for (int i = 1; i < n; i++) {
+        if (batch[i]->buf != batch[i - 1]->buf + batch[i - 1]->count * BLK_SECTOR_SIZE) {
+            contiguous = 0;
+            break;
+        }
+    }
+
+    if (!contiguous && !dev->bounce)
+        dev->bounce = kmalloc(BLK_MAX_TRANSFER * BLK_SECTOR_SIZE);
+
+    if (contiguous) {
+        result = blk_transfer(dev, write, lba, count, batch[0]->buf);
+        for (int i = 0; i < n; i++) batch[i]->result = result;
+    } else if (dev->bounce) {
+        uint8_t *p = dev->bounce;
+        if (write) {
+            for (int i = 0; i < n; i++) {
+                memcpy_s(p, batch[i]->buf, batch[i]->count * BLK_SECTOR_SIZE);
+                p += batch[i]->count * BLK_SECTOR_SIZE;
+            }
+        }
+        result = blk_transfer(dev, write, lba, count, dev->bounce);
+        if (!write && result == 0) {
+            p = dev->bounce;
+            for (int i = 0; i < n; i++) {
+                memcpy_s(batch[i]->buf, p, batch[i]->count * BLK_SECTOR_SIZE);
+                p += batch[i]->count * BLK_SECTOR_SIZE;
+            }
+        }
+        for (int i = 0; i < n; i++) batch[i]->result = result;
+    } else {
+        /* No bounce buffer: fall back to one command per request. */
+        for (int i = 0; i < n; i++)
+            batch[i]->result = blk_transfer(dev, write, batch[i]->lba, batch[i]->count, batch[i]->buf);
+    }
+
+    dev->head_lba = lba + count;
+    for (int i = 0; i < n; i++) batch[i]->done = 1;
+}
+
+/* Whoever finds the queue idle drives it until its own request completes;
+ * other submitters yield and pick up dispatching once it is released. */
+static void blk_run_queue(blkdev_t *dev, blk_request_t *mine) {
+    blk_request_t *batch[BLK_MAX_MERGE];
+    uint32_t lba, count;
+
+    while (!mine->done) {
+        int n = blk_take_batch(dev, batch, &lba, &count);
+        if (n == 0) break;
+        blk_dispatch(dev, batch, n, lba, count);
+    }
+
+    dev->dispatching = 0;
+}
+
+static int blk_submit(blkdev_t *dev, int write, uint32_t lba, uint32_t count, void *buf, blk_prio_t prio) {
+    if (!dev || !dev->registered || !buf || count == 0) return -1;
+    if (write && !dev->write) return -1;
+    if (dev->sector_count && (lba >= dev->sector_count || count > dev->sector_count - lba))
+        return -1;
+    if ((unsigned)prio >= BLK_PRIO_CLASSES) prio = BLK_PRIO_BE;
+
+    uint32_t expire_ms = write ? blk_write_expire_ms[prio] : blk_read_expire_ms[prio];
+    blk_request_t req;
+    req.lba = lba;
+    req.count = count;
+    req.buf = (uint8_t*)buf;
+    req.write = write ? 1 : 0;
+    req.prio = (uint8_t)prio;
+    req.done = 0;
+    req.result = -1;
+    req.deadline = timer_get_ticks() + (expire_ms * timer_get_frequency()) / 1000;
+    req.next = NULL;
+
+    uint32_t eflags = blk_irq_save();
+    blk_queue_insert(dev, &req);
+    dev->stats.requests++;
+    blk_irq_restore(eflags);
+
+    for (;;) {
+        eflags = blk_irq_save();
+        if (req.done) {
+            blk_irq_restore(eflags);
+            break;
+        }
+        if (!dev->dispatching) {
+            dev->dispatching = 1;
+            blk_irq_restore(eflags);
+            blk_run_queue(dev, &req);
+            continue;
+        }
+        blk_irq_restore(eflags);
+        task_yield();
+    }
+
+    return req.result;
+}
+
+int blk_read_prio(blkdev_t *dev, uint32_t lba, uint32_t count, void *buf, blk_prio_t prio) {
+    return blk_submit(dev, 0, lba, count, buf, prio);
+}
+
+int blk_write_prio(blkdev_t *dev, uint32_t lba, uint32_t count, const void *buf, blk_prio_t prio) {
+    return blk_submit(dev, 1, lba, count, (void*)buf, prio);
+}
+
+int blk_read(blkdev_t *dev, uint32_t lba, uint32_t count, void *buf) {
+    return blk_submit(dev, 0, lba, count, buf, blk_current_prio());
+}
+
+int blk_write(blkdev_t *dev, uint32_t lba, uint32_t count, const void *buf) {
+    return blk_submit(dev, 1, lba, count, (void*)buf, blk_current_prio());
+}
+
+/* Ask the device to commit its write cache. Writes only count as durable
+ * once this has returned; the backends no longer do it after every write. */
+int blk_flush(blkdev_t *dev) {
+    if (!dev || !dev->registered) return -1;
+    if (!dev->flush) return 0;
+    dev->stats.flushes++;
+    if (dev->flush(dev) != 0) {
+        dev->stats.errors++;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <stdint.h>
+
+#define BLK_SECTOR_SIZE   512
+#define BLK_MAX_DEVICES   4
+#define BLK_MAX_TRANSFER  128   /* sectors per merged command */
+#define BLK_MAX_MERGE     16    /* requests folded into one command */
+
+/* I/O priority classes. Lower classes are dispatched first; IDLE only runs
+ * when nothing else is queued, and every request carries a deadline so no
+ * class can be starved forever. */
+typedef enum {
+    BLK_PRIO_RT   = 0,
+    BLK_PRIO_BE   = 1,
+    BLK_PRIO_IDLE = 2
+} blk_prio_t;
+
+#define BLK_PRIO_CLASSES 3
+
+struct blkdev;
+
+typedef struct blk_request {
+    uint32_t lba;
+    uint32_t count;
+    uint8_t *buf;
+    uint8_t write;
+    uint8_t prio;
+    volatile uint8_t done;
+    int result;
+    uint32_t deadline;
+    struct blk_request *next;
+} blk_request_t;
+
+typedef struct {
+    uint32_t requests;        /* requests submitted by callers */
+    uint32_t commands;        /* backend transfers actually issued */
+    uint32_t merged;          /* requests folded into a neighbour */
+    uint32_t expired;         /* requests dispatched by deadline */
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+    uint32_t flushes;         /* device write caches emptied */
+    uint32_t errors;
+} blk_stats_t;
+
+typedef struct blkdev {
+    char name[8];
+    uint8_t registered;
+    uint32_t sector_count;    /* 0 if the backend cannot tell */
+    uint32_t max_sectors;     /* largest single backend transfer */
+    int (*read)(struct blkdev *dev, uint32_t lba, uint32_t count, void *buf);
+    int (*write)(struct blkdev *dev, uint32_t lba, uint32_t count, const void *buf);
+    int (*flush)(struct blkdev *dev);  /* NULL if writes are durable already */
+    void *priv;
+
+    blk_request_t *queue[BLK_PRIO_CLASSES];  /* each kept sorted by LBA */
+    uint32_t head_lba;
+    volatile int dispatching;
+    uint8_t *bounce;
+    blk_stats_t stats;
+} blkdev_t;
+
+void blk_init(void);
+blkdev_t *blk_register(const char *name, uint32_t sector_count, uint32_t max_sectors,
+                       int (*read)(blkdev_t*, uint32_t, uint32_t, void*),
+                       int (*write)(blkdev_t*, uint32_t, uint32_t, const void*),
+                       void *priv);
+blkdev_t *blk_find(const char *name);
+blkdev_t *blk_boot_device(void);
+
+blk_prio_t blk_current_prio(void);
+int blk_read(blkdev_t *dev, uint32_t lba, uint32_t count, void *buf);
+int blk_write(blkdev_t *dev, uint32_t lba, uint32_t count, const void *buf);
+int blk_read_prio(blkdev_t *dev, uint32_t lba, uint32_t count, void *buf, blk_prio_t prio);
+int blk_write_prio(blkdev_t *dev, uint32_t lba, uint32_t count, const void *buf, blk_prio_t prio);
+int blk_flush(blkdev_t *dev);
@@ -5,6 +5,7 @@
 #define FAT32_MAX_PATH 256
 #define FAT32_MAX_OPEN_FILES 32
 #define FAT32_MAX_VOLUMES 4
+#define FAT32_MAX_OPEN_DIRS 16
 
 #define FAT_ATTR_READ_ONLY 0x01
 #define FAT_ATTR_HIDDEN    0x02
@@ -14,6 +15,14 @@
 #define FAT_ATTR_ARCHIVE   0x20
 #define FAT_ATTR_LFN       0x0F
 
+/* Yielding spin lock that counts how often it had to wait */
+typedef struct {
+    volatile int held;
+    uint32_t acquired;
+    uint32_t contended;      /* acquisitions that found it already held */
+    uint32_t waits;          /* yields spent waiting */
+} fat32_lock_t;
+
 typedef struct {
     char name[FAT32_MAX_PATH];
     uint32_t size;
@@ -24,21 +33,61 @@ typedef struct {
     uint8_t attr;
 } fat32_dirent_t;
 
+typedef struct {
+    uint32_t file_cluster;   /* index of the run's first cluster within the file */
+    uint32_t disk_cluster;
+    uint32_t count;
+} fat32_extent_t;
+
 typedef struct {
     uint32_t position;
     uint32_t size;
     uint32_t first_cluster;
     uint32_t current_cluster;
     uint32_t cluster_offset;
+    uint8_t *cache;          /* cache_count clusters starting at cache_cluster */
+    uint32_t cache_cluster;
+    uint32_t cache_count;    /* 0 when cache holds nothing */
+    uint32_t cache_cap;      /* clusters the cache buffer can hold */
+    uint32_t ra_window;      /* clusters to fetch on the next sequential miss */
+    uint32_t ra_next;        /* position a sequential reader would continue at */
+    uint32_t dirty_cluster;  /* cached cluster with unwritten data, 0 if none */
+    uint32_t last_cluster;   /* tail of the chain, 0 until first needed */
+    uint32_t dirent_cluster; /* where the short directory entry lives */
+    uint32_t dirent_offset;
+    uint8_t meta_dirty;      /* size/timestamps not yet written to the entry */
+    uint8_t reserved;        /* chain preallocated past size, trimmed on close */
+    fat32_extent_t *extents; /* contiguous runs covering a prefix of the chain */
+    uint32_t extent_count;
+    uint32_t extent_cap;
     uint8_t in_use;
     uint8_t drive;
     uint8_t mode;
     char path[FAT32_MAX_PATH];
+    fat32_lock_t lock;       /* position and handle state */
 } fat32_file_t;
 
+/* Directory cursor: walks the directory one cluster at a time, so memory
+ * use does not depend on how many entries it holds. */
+typedef struct {
+    uint8_t in_use;
+    uint8_t drive;
+    uint8_t loaded;          /* buf holds cluster */
+    uint8_t done;
+    uint8_t lfn_valid;
+    uint8_t lfn_checksum;
+    uint32_t cluster;
+    uint32_t index;          /* next 32-byte slot in buf */
+    uint8_t *buf;
+    char lfn[FAT32_MAX_PATH];
+} fat32_dir_t;
+
+struct blkdev;
+
 typedef struct {
     uint8_t drive_letter;
     uint8_t mounted;
+    struct blkdev *dev;
     uint32_t first_fat_sector;
     uint32_t first_data_sector;
     uint32_t root_cluster;
@@ -48,22 +97,58 @@ typedef struct {
     uint8_t num_fats;
     uint8_t *fat_cache;
     uint32_t fat_cache_size;
+    uint32_t *fat_dirty_map;  /* one bit per FAT sector changed since the last sync */
+    uint32_t cluster_count;   /* data clusters; valid numbers are 2..cluster_count+1 */
+    uint32_t *free_map;       /* one bit per cluster, set when free */
+    uint32_t free_count;
+    uint32_t fsinfo_lba;      /* 0 if the volume has no FSInfo sector */
+    uint8_t fsinfo_dirty;
+    fat32_lock_t lock;        /* metadata, directories and handle caches */
 } fat32_volume_t;
 
+typedef struct {
+    uint32_t acquired;
+    uint32_t contended;
+    uint32_t waits;
+} fat32_lock_count_t;
+
+typedef struct {
+    fat32_lock_count_t table;                     /* open tables, mounts, cwd */
+    fat32_lock_count_t dcache;
+    fat32_lock_count_t files;                     /* all handle locks together */
+    fat32_lock_count_t volume[FAT32_MAX_VOLUMES];
+    uint8_t volume_drive[FAT32_MAX_VOLUMES];      /* 0 if the slot is unmounted */
+} fat32_lock_stats_t;
+
 void fat32_init(void);
 int fat32_mount_drive(uint8_t drive_letter, uint32_t start_lba);
+int fat32_mount_device(uint8_t drive_letter, struct blkdev *dev, uint32_t start_lba);
 int fat32_unmount_drive(uint8_t drive_letter);
 int fat32_mount_auto(uint8_t drive_letter);
+int fat32_format(struct blkdev *dev, uint32_t start_lba, uint32_t sectors, uint32_t spc,
+                 const char *label);
 int find_fat32_partition(uint32_t *out_start_lba);
+void fat32_set_scrub(int enable);
+void fat32_set_writeback(uint32_t interval_ms);
+int fat32_sync(void);
+int fat32_statfs(uint8_t drive_letter, uint32_t *total_clusters, uint32_t *free_clusters,
+                 uint32_t *cluster_bytes);
+void fat32_lock_stats(fat32_lock_stats_t *out);
 
 fat32_file_t* fat32_open(const char *path, const char *mode);
 int fat32_read(fat32_file_t *file, void *buffer, size_t size);
 int fat32_write(fat32_file_t *file, const void *buffer, size_t size);
+int fat32_copy(fat32_file_t *dst, fat32_file_t *src, uint32_t size);
+int fat32_preallocate(fat32_file_t *file, uint32_t size);
 int fat32_seek(fat32_file_t *file, uint32_t offset);
 uint32_t fat32_tell(fat32_file_t *file);
+int fat32_flush(fat32_file_t *file);
 void fat32_close(fat32_file_t *file);
 
 int fat32_list_dir(const char *path, fat32_dirent_t *entries, int max_entries);
+fat32_dir_t* fat32_opendir(const char *path);
+int fat32_readdir(fat32_dir_t *dir, fat32_dirent_t *entry);
+void fat32_closedir(fat32_dir_t *dir);
 int fat32_mkdir(const char *path);
 int fat32_rmdir(const char *path);
 int fat32_unlink(const char *path);
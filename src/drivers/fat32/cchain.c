@@ -1,14 +1,48 @@
 #include "private.h"
 
-static uint32_t cluster_to_lba(fat32_volume_t *vol, uint32_t cluster) {
+uint32_t cluster_to_lba(fat32_volume_t *vol, uint32_t cluster) {
     return vol->first_data_sector + (cluster - 2) * vol->sectors_per_cluster;
 }
 
+/* FAT entries that describe real clusters; the tail of the last FAT
+ * sector has slots past the end of the data area that must never be used. */
+static uint32_t fat_entries(fat32_volume_t *vol) {
+    uint32_t entries = vol->fat_cache_size / 4;
+    if (vol->cluster_count && vol->cluster_count + 2 < entries)
+        entries = vol->cluster_count + 2;
+    return entries;
+}
+
+/* Data reads running without the volume lock, see read_data_clusters */
+typedef struct {
+    uint8_t busy;
+    uint8_t stale;
+    uint8_t drive;
+    uint32_t start;
+    uint32_t count;
+} inflight_t;
+
+static inflight_t inflight[FAT32_MAX_OPEN_FILES];
+
+static void inflight_stale(fat32_volume_t *vol, uint32_t cluster, uint32_t count) {
+    for (int i = 0; i < FAT32_MAX_OPEN_FILES; i++) {
+        inflight_t *io = &inflight[i];
+        if (io->busy && io->drive == vol->drive_letter &&
+            cluster < io->start + io->count && io->start < cluster + count)
+            io->stale = 1;
+    }
+}
+
+static inline void free_map_set(fat32_volume_t *vol, uint32_t cluster, int free) {
+    uint32_t bit = 1u << (cluster & 31);
+    if (free) vol->free_map[cluster >> 5] |= bit;
+    else vol->free_map[cluster >> 5] &= ~bit;
+}
+
 uint32_t get_next_cluster(fat32_volume_t *vol, uint32_t cluster) {
     if (!vol->fat_cache) return FAT32_EOC;
     if (cluster < 2) return FAT32_EOC;
-    uint32_t entries = vol->fat_cache_size / 4;
-    if (cluster >= entries) return FAT32_EOC;
+    if (cluster >= fat_entries(vol)) return FAT32_EOC;
     uint32_t val;
     memcpy_s(&val, vol->fat_cache + cluster * 4, 4);
     return (val & 0x0FFFFFFF);
@@ -16,123 +50,374 @@ uint32_t get_next_cluster(fat32_volume_t *vol, uint32_t cluster) {
 
 void set_next_cluster(fat32_volume_t *vol, uint32_t cluster, uint32_t value) {
     if (!vol->fat_cache || cluster < 2) return;
-    uint32_t entries = vol->fat_cache_size / 4;
-    if (cluster >= entries) return;
+    if (cluster >= fat_entries(vol)) return;
     
     uint32_t cur;
     memcpy_s(&cur, vol->fat_cache + cluster * 4, 4);
     uint32_t newval = (cur & 0xF0000000) | (value & 0x0FFFFFFF);
     memcpy_s(vol->fat_cache + cluster * 4, &newval, 4);
     
+    if (vol->free_map) {
+        int was_free = (cur & 0x0FFFFFFF) == 0;
+        int now_free = (value & 0x0FFFFFFF) == 0;
+        if (was_free != now_free) {
+            free_map_set(vol, cluster, now_free);
+            if (now_free) vol->free_count++;
+            else vol->free_count--;
+            vol->fsinfo_dirty = 1;
+        }
+    }
+    
+    if (vol->fat_dirty_map) {
+        uint32_t sector = cluster * 4 / vol->bytes_per_sector;
+        vol->fat_dirty_map[sector >> 5] |= 1u << (sector & 31);
+    }
     int idx = volume_index(vol);
     if (idx >= 0) fat_dirty[idx] = 1;
 }
 
-uint32_t alloc_cluster(fat32_volume_t *vol) {
-    if (!vol->fat_cache) return 0;
-    uint32_t entries = vol->fat_cache_size / 4;
-    if (entries <= 2) return 0;
-    
+/* Build the free bitmap from the FAT. The FSInfo values are only hints:
+ * a stale free count is corrected and flagged for write-back. */
+int build_free_map(fat32_volume_t *vol, uint32_t hint_free, uint32_t hint_next) {
+    uint32_t entries = fat_entries(vol);
+    uint32_t words = (entries + 31) / 32;
+
+    vol->free_map = kmalloc(words * 4);
+    if (!vol->free_map) return -1;
+    memset_s(vol->free_map, 0, words * 4);
+
+    uint32_t free_count = 0;
+    const uint32_t *fat = (const uint32_t*)vol->fat_cache;
+    for (uint32_t c = 2; c < entries; c++) {
+        if ((fat[c] & 0x0FFFFFFF) == 0) {
+            free_map_set(vol, c, 1);
+            free_count++;
+        }
+    }
+
+    vol->free_count = free_count;
+    vol->fsinfo_dirty = (hint_free != free_count);
+
     int idx = volume_index(vol);
-    uint32_t start = (idx >= 0 && last_alloc[idx] >= 2 && last_alloc[idx] < entries) 
-                     ? last_alloc[idx] + 1 : 2;
-    if (start >= entries) start = 2;
-    
-    for (uint32_t pass = 0; pass < 2; pass++) {
-        for (uint32_t cur = start; cur < entries; cur++) {
-            uint32_t val;
-            memcpy_s(&val, vol->fat_cache + cur * 4, 4);
-            if ((val & 0x0FFFFFFF) == 0) {
-                set_next_cluster(vol, cur, FAT32_EOC);
-                if (idx >= 0) last_alloc[idx] = cur;
-                return cur;
+    if (idx >= 0 && hint_next >= 2 && hint_next < entries)
+        last_alloc[idx] = hint_next;
+    return 0;
+}
+
+/* First cluster at or after start (and before end) that begins a run of
+ * at least want free clusters; 0 if there is none. Whole words are
+ * skipped or consumed at once. */
+static uint32_t find_free_run(fat32_volume_t *vol, uint32_t start, uint32_t end, uint32_t want) {
+    uint32_t run_start = 0, run_len = 0;
+    uint32_t c = start;
+
+    while (c < end) {
+        uint32_t word = vol->free_map[c >> 5];
+        if ((c & 31) == 0 && word == 0xFFFFFFFF && c + 32 <= end) {
+            if (run_len == 0) run_start = c;
+            run_len += 32;
+            c += 32;
+        } else {
+            uint32_t w = word >> (c & 31);
+            if (w == 0) {
+                run_len = 0;
+                c = (c | 31) + 1;
+                continue;
+            }
+            if (!(w & 1)) {
+                run_len = 0;
+                c += __builtin_ctz(w);
+                continue;
             }
+            if (run_len == 0) run_start = c;
+            run_len++;
+            c++;
         }
-        start = 2;
+        if (run_len >= want) return run_start;
     }
     return 0;
 }
+
+/* Allocate one cluster, preferring the one right after prev so the chain
+ * stays contiguous. When that is taken, look for a free run of want
+ * clusters so the rest of a large write can follow on; failing that take
+ * any free cluster. */
+uint32_t alloc_cluster_near(fat32_volume_t *vol, uint32_t prev, uint32_t want) {
+    if (!vol->fat_cache || !vol->free_map || vol->free_count == 0) return 0;
+    uint32_t entries = fat_entries(vol);
+    if (entries <= 2) return 0;
+    
+    int idx = volume_index(vol);
+    uint32_t cur = 0;
+
+    if (prev >= 2 && prev + 1 < entries &&
+        (vol->free_map[(prev + 1) >> 5] & (1u << ((prev + 1) & 31))))
+        cur = prev + 1;
+
+    uint32_t start = (idx >= 0 && last_alloc[idx] >= 2 && last_alloc[idx] < entries)
+                     ? last_alloc[idx] : 2;
+    if (want < 1) want = 1;
+    if (!cur && want > 1) {
+        cur = find_free_run(vol, start, entries, want);
+        if (!cur) cur = find_free_run(vol, 2, entries, want);
+    }
+    if (!cur) {
+        cur = find_free_run(vol, start, entries, 1);
+        if (!cur) cur = find_free_run(vol, 2, start, 1);
+    }
+    if (!cur) return 0;
+
+    set_next_cluster(vol, cur, FAT32_EOC);
+    if (idx >= 0) last_alloc[idx] = cur + 1;
+    return cur;
+}
+
+/* Allocate count clusters that are contiguous on disk and chain them,
+ * right after prev if there is room. Returns the first one, or 0 if no
+ * free run is long enough. */
+uint32_t alloc_cluster_run(fat32_volume_t *vol, uint32_t prev, uint32_t count) {
+    if (!vol->fat_cache || !vol->free_map || count == 0 || vol->free_count < count) return 0;
+    uint32_t entries = fat_entries(vol);
+    int idx = volume_index(vol);
+    uint32_t cur = 0;
+
+    if (prev >= 2 && prev + 1 + count <= entries &&
+        find_free_run(vol, prev + 1, prev + 1 + count, count) == prev + 1)
+        cur = prev + 1;
+    if (!cur) {
+        uint32_t start = (idx >= 0 && last_alloc[idx] >= 2 && last_alloc[idx] < entries)
+                         ? last_alloc[idx] : 2;
+        cur = find_free_run(vol, start, entries, count);
+        if (!cur) cur = find_free_run(vol, 2, entries, count);
+    }
+    if (!cur) return 0;
+
+    for (uint32_t i = 0; i < count; i++)
+        set_next_cluster(vol, cur + i, i + 1 < count ? cur + i + 1 : FAT32_EOC);
+    if (idx >= 0) last_alloc[idx] = cur + count;
+    return cur;
+}
+
+uint32_t alloc_cluster(fat32_volume_t *vol) {
+    return alloc_cluster_near(vol, 0, 1);
+}
+
+int cluster_is_free(fat32_volume_t *vol, uint32_t cluster) {
+    if (!vol->free_map || cluster < 2 || cluster >= fat_entries(vol)) return 0;
+    return (vol->free_map[cluster >> 5] >> (cluster & 31)) & 1;
+}
+
+/* Open handles may still cache clusters that were just freed. Buffered
+ * data for a freed cluster is thrown away; anything else is written back
+ * before the cache is dropped. */
+static void drop_freed_caches(fat32_volume_t *vol) {
+    inflight_stale(vol, 0, FAT32_EOC);
+    for (int i = 0; i < FAT32_MAX_OPEN_FILES; i++) {
+        fat32_file_t *f = &open_files[i];
+        if (!f->in_use || f->drive != vol->drive_letter || f->cache_count == 0) continue;
+
+        int stale = 0;
+        for (uint32_t c = 0; c < f->cache_count && !stale; c++)
+            stale = cluster_is_free(vol, f->cache_cluster + c);
+        if (!stale) continue;
+
+        if (f->dirty_cluster && cluster_is_free(vol, f->dirty_cluster))
+            f->dirty_cluster = 0;
+        file_writeback(vol, f);
+        f->cache_count = 0;
+    }
+}
+
+/* Only the FAT is touched; the data stays on disk until the clusters are
+ * reused, or until the background scrubber gets to it if enabled. */
 void free_cluster_chain(fat32_volume_t *vol, uint32_t start) {
     if (!vol->fat_cache || start < 2) return;
-    uint32_t entries = vol->fat_cache_size / 4;
+    drop_extent_maps(vol);
+    uint32_t entries = fat_entries(vol);
     uint32_t cluster = start;
     uint32_t safety = 0;
-    
-    size_t cluster_size = vol->sectors_per_cluster * vol->bytes_per_sector;
-    uint8_t *zero_buf = kmalloc(cluster_size);
-    if (zero_buf) {
-        memset_s(zero_buf, 0, cluster_size);
-    }
+    uint32_t run_start = 0, run_len = 0;
     
     while (cluster >= 2 && cluster < FAT32_EOC && safety < entries) {
         uint32_t next = get_next_cluster(vol, cluster);
+        set_next_cluster(vol, cluster, 0);
         
-        if (zero_buf) {
-            if (write_cluster(vol, cluster, zero_buf) != 0) {
-                printf("Failed to clear cluster %u\n", cluster);
-            }
+        if (run_len && cluster == run_start + run_len) {
+            run_len++;
+        } else {
+            if (run_len) scrub_queue(vol, run_start, run_len);
+            run_start = cluster;
+            run_len = 1;
         }
-        
-        set_next_cluster(vol, cluster, 0);
         cluster = next;
         safety++;
     }
+    if (run_len) scrub_queue(vol, run_start, run_len);
     
-    if (zero_buf) {
-        kfree(zero_buf);
+    drop_freed_caches(vol);
+}
+
+/* Write the running free count and allocation hint back to FSInfo. */
+static int sync_fsinfo(fat32_volume_t *vol) {
+    if (!vol->fsinfo_dirty || !vol->fsinfo_lba) return 0;
+
+    uint8_t *sector = kmalloc(vol->bytes_per_sector);
+    if (!sector) return -1;
+
+    int rc = -1;
+    if (blk_read(vol->dev, vol->fsinfo_lba, 1, sector) == 0) {
+        fat32_fsinfo_t *info = (fat32_fsinfo_t*)sector;
+        if (info->lead_sig == FSINFO_LEAD_SIG && info->struct_sig == FSINFO_STRUCT_SIG) {
+            int idx = volume_index(vol);
+            info->free_count = vol->free_count;
+            info->next_free = (idx >= 0) ? last_alloc[idx] : FSINFO_UNKNOWN;
+            rc = blk_write(vol->dev, vol->fsinfo_lba, 1, sector);
+        }
     }
+    kfree(sector);
+    if (rc == 0) vol->fsinfo_dirty = 0;
+    return rc;
 }
 
 int sync_fat(fat32_volume_t *vol) {
     if (!vol->fat_cache) return -1;
     int idx = volume_index(vol);
-    if (idx >= 0 && !fat_dirty[idx]) return 0;
+    if (idx >= 0 && !fat_dirty[idx]) return sync_fsinfo(vol);
     
     uint32_t sectors = vol->sectors_per_fat;
-    uint32_t bps = vol->bytes_per_sector;
-    if (bps == 0) return -1;
+    if (vol->bytes_per_sector == 0) return -1;
     
-    for (uint8_t copy = 0; copy < vol->num_fats; copy++) {
-        uint32_t base = vol->first_fat_sector + copy * vol->sectors_per_fat;
-        for (uint32_t i = 0; i < sectors; i++) {
-            if (ata_write_sectors(base + i, 1, vol->fat_cache + i * bps) != 0)
+    /* Only the runs of sectors that changed are written, to every copy */
+    uint32_t *map = vol->fat_dirty_map;
+    uint32_t sec = 0;
+    while (sec < sectors) {
+        if (map && !(map[sec >> 5] & (1u << (sec & 31)))) {
+            sec++;
+            continue;
+        }
+        uint32_t n = 1;
+        while (sec + n < sectors && (!map || (map[(sec + n) >> 5] & (1u << ((sec + n) & 31)))))
+            n++;
+        for (uint8_t copy = 0; copy < vol->num_fats; copy++) {
+            uint32_t base = vol->first_fat_sector + copy * vol->sectors_per_fat;
+            if (blk_write(vol->dev, base + sec, n, vol->fat_cache + sec * vol->bytes_per_sector) != 0)
                 return -1;
         }
+        if (map) {
+            for (uint32_t i = sec; i < sec + n; i++)
+                map[i >> 5] &= ~(1u << (i & 31));
+        }
+        sec += n;
     }
     
     if (idx >= 0) fat_dirty[idx] = 0;
-    return 0;
+    return sync_fsinfo(vol);
 }
 int read_cluster(fat32_volume_t *vol, uint32_t cluster, void *buffer) {
-    if (cluster < 2 || cluster >= FAT32_EOC) return -1;
-    uint32_t lba = cluster_to_lba(vol, cluster);
-    for (uint32_t i = 0; i < vol->sectors_per_cluster; i++) {
-        if (ata_read_sectors(lba + i, 1, (uint8_t*)buffer + i * vol->bytes_per_sector) != 0) {
-            return -1;
-        }
+    return read_clusters(vol, cluster, 1, buffer);
+}
+
+/* Read count physically consecutive clusters with a single request. */
+int read_clusters(fat32_volume_t *vol, uint32_t cluster, uint32_t count, void *buffer) {
+    if (cluster < 2 || cluster >= FAT32_EOC || count == 0) return -1;
+
+    /* Writes still buffered in an open file must land before the disk copy
+     * is read back. */
+    for (int i = 0; i < FAT32_MAX_OPEN_FILES; i++) {
+        fat32_file_t *f = &open_files[i];
+        if (f->in_use && f->drive == vol->drive_letter && f->dirty_cluster >= cluster &&
+            f->dirty_cluster < cluster + count)
+            file_writeback(vol, f);
     }
-    return 0;
+    return blk_read(vol->dev, cluster_to_lba(vol, cluster), count * vol->sectors_per_cluster, buffer);
 }
-int write_cluster(fat32_volume_t *vol, uint32_t cluster, const void *buffer) {
-    if (cluster < 2 || cluster >= FAT32_EOC) return -1;
+
+/* read_clusters for file data, called with the volume lock held. The lock
+ * is let go while the transfer is in flight so other handles can get on;
+ * if any of the clusters is written or freed meanwhile the read is simply
+ * repeated with the lock kept. */
+int read_data_clusters(fat32_volume_t *vol, uint32_t cluster, uint32_t count, void *buffer) {
+    if (cluster < 2 || cluster >= FAT32_EOC || count == 0) return -1;
+
+    inflight_t *io = NULL;
+    for (int i = 0; i < FAT32_MAX_OPEN_FILES && !io; i++) {
+        if (!inflight[i].busy) io = &inflight[i];
+    }
+    if (!io) return read_clusters(vol, cluster, count, buffer);
+
+    for (int i = 0; i < FAT32_MAX_OPEN_FILES; i++) {
+        fat32_file_t *f = &open_files[i];
+        if (f->in_use && f->drive == vol->drive_letter && f->dirty_cluster >= cluster &&
+            f->dirty_cluster < cluster + count)
+            file_writeback(vol, f);
+    }
+
+    uint8_t drive = vol->drive_letter;
+    io->busy = 1;
+    io->stale = 0;
+    io->drive = drive;
+    io->start = cluster;
+    io->count = count;
+    volume_unlock(vol);
+    int rc = blk_read(vol->dev, cluster_to_lba(vol, cluster), count * vol->sectors_per_cluster, buffer);
+    fat32_lock(&vol->lock);
+    io->busy = 0;
+
+    if (!vol->mounted || vol->drive_letter != drive) return -1;
+    if (rc == 0 && !io->stale) return 0;
+    return read_clusters(vol, cluster, count, buffer);
+}
+
+/* Number of clusters, up to max, for which the chain starting at cluster
+ * simply walks upwards on disk. */
+uint32_t cluster_run(fat32_volume_t *vol, uint32_t cluster, uint32_t max) {
+    uint32_t n = 1;
+    while (n < max && get_next_cluster(vol, cluster + n - 1) == cluster + n)
+        n++;
+    return n;
+}
+
+/* Other handles caching this cluster would now read stale data. */
+void drop_cached_cluster(fat32_volume_t *vol, uint32_t cluster, const void *keep) {
+    inflight_stale(vol, cluster, 1);
+    for (int i = 0; i < FAT32_MAX_OPEN_FILES; i++) {
+        fat32_file_t *f = &open_files[i];
+        if (!f->in_use || f->drive != vol->drive_letter || f->cache_count == 0) continue;
+        if (cluster < f->cache_cluster || cluster >= f->cache_cluster + f->cache_count) continue;
+
+        size_t cluster_size = vol->sectors_per_cluster * vol->bytes_per_sector;
+        const uint8_t *k = (const uint8_t*)keep;
+        if (k >= f->cache && k < f->cache + f->cache_count * cluster_size) continue;
+
+        /* A buffered copy of this very cluster is superseded by the write;
+         * anything else buffered in the run still has to go out. */
+        if (f->dirty_cluster && f->dirty_cluster != cluster)
+            file_writeback(vol, f);
+        f->dirty_cluster = 0;
+        f->cache_count = 0;
+    }
+}
+
+/* Write count clusters that are contiguous on disk in one request. */
+int write_clusters(fat32_volume_t *vol, uint32_t cluster, uint32_t count, const void *buffer) {
+    if (cluster < 2 || cluster >= FAT32_EOC || count == 0) return -1;
     uint32_t lba = cluster_to_lba(vol, cluster);
+    for (uint32_t i = 0; i < count; i++)
+        drop_cached_cluster(vol, cluster + i, buffer);
 
-    for (uint32_t i = 0; i < vol->sectors_per_cluster; i++) {
-        int attempts = 0;
-        int res = -1;
-        const uint8_t *buf_ptr = (const uint8_t*)buffer + i * vol->bytes_per_sector;
-        while (attempts < 3) {
-            res = ata_write_sectors(lba + i, 1, buf_ptr);
-            if (res == 0) break;
-
-            /* small delay before retry to allow controller to recover */
-            for (volatile int d = 0; d < 50000; d++);
-            attempts++;
-        }
+    int attempts = 0;
+    int res = -1;
+    while (attempts < 3) {
+        res = blk_write(vol->dev, lba, count * vol->sectors_per_cluster, buffer);
+        if (res == 0) break;
 
-        if (res != 0) {
-            return -1;
-        }
+        /* small delay before retry to allow controller to recover */
+        for (volatile int d = 0; d < 50000; d++);
+        attempts++;
     }
-    return 0;
+    return res;
+}
+
+int write_cluster(fat32_volume_t *vol, uint32_t cluster, const void *buffer) {
+    return write_clusters(vol, cluster, 1, buffer);
 }
@@ -0,0 +1,201 @@
+#include "private.h"
+
+/* Cache of directory lookups, keyed by (drive, parent cluster, name).
+ * Negative entries remember names that were not found. Entries are chained
+ * per hash bucket and kept on an LRU list; the least recently used one is
+ * recycled when the table is full. Only short enough names are cached. */
+
+#define DCACHE_ENTRIES  256
+#define DCACHE_BUCKETS  64
+#define DCACHE_NAME_MAX 64
+#define DCACHE_NONE     (-1)
+
+typedef struct {
+    uint8_t used;
+    uint8_t negative;
+    uint8_t drive;
+    uint32_t parent;
+    uint32_t hash;
+    char name[DCACHE_NAME_MAX];
+    fat32_direntry_t entry;
+    uint32_t cluster;   /* where entry lives on disk */
+    uint32_t offset;
+    int16_t chain;      /* next in bucket */
+    int16_t prev, next; /* LRU list, most recent first */
+} dcache_entry_t;
+
+static dcache_entry_t dcache[DCACHE_ENTRIES];
+static int16_t dcache_bucket[DCACHE_BUCKETS];
+static int16_t lru_head = DCACHE_NONE, lru_tail = DCACHE_NONE;
+static int dcache_ready = 0;
+static fat32_lock_t dcache_lock;  /* shared by all volumes, so it has its own */
+
+void dcache_reset(void) {
+    memset_s(dcache, 0, sizeof(dcache));
+    for (int i = 0; i < DCACHE_BUCKETS; i++) dcache_bucket[i] = DCACHE_NONE;
+
+    /* Every slot starts on the LRU list, unused ones at the tail */
+    for (int i = 0; i < DCACHE_ENTRIES; i++) {
+        dcache[i].chain = DCACHE_NONE;
+        dcache[i].prev = (int16_t)(i - 1);
+        dcache[i].next = (int16_t)(i + 1 < DCACHE_ENTRIES ? i + 1 : DCACHE_NONE);
+    }
+    lru_head = 0;
+    lru_tail = DCACHE_ENTRIES - 1;
+    dcache_ready = 1;
+}
+
+static uint32_t dcache_hash(uint8_t drive, uint32_t parent, const char *name) {
+    uint32_t h = 2166136261u ^ drive;
+    h = (h ^ parent) * 16777619u;
+    for (const char *p = name; *p; p++)
+        h = (h ^ (uint8_t)toupper_s(*p)) * 16777619u;
+    return h;
+}
+
+static void lru_unlink(int16_t i) {
+    if (dcache[i].prev != DCACHE_NONE) dcache[dcache[i].prev].next = dcache[i].next;
+    else lru_head = dcache[i].next;
+    if (dcache[i].next != DCACHE_NONE) dcache[dcache[i].next].prev = dcache[i].prev;
+    else lru_tail = dcache[i].prev;
+}
+
+static void lru_push_front(int16_t i) {
+    dcache[i].prev = DCACHE_NONE;
+    dcache[i].next = lru_head;
+    if (lru_head != DCACHE_NONE) dcache[lru_head].prev = i;
+    lru_head = i;
+    if (lru_tail == DCACHE_NONE) lru_tail = i;
+}
+
+static void lru_push_back(int16_t i) {
+    dcache[i].next = DCACHE_NONE;
+    dcache[i].prev = lru_tail;
+    if (lru_tail != DCACHE_NONE) dcache[lru_tail].next = i;
+    lru_tail = i;
+    if (lru_head == DCACHE_NONE) lru_head = i;
+}
+
+static void dcache_remove(int16_t i) {
+    if (!dcache[i].used) return;
+
+    int16_t *pp = &dcache_bucket[dcache[i].hash % DCACHE_BUCKETS];
+    while (*pp != DCACHE_NONE && *pp != i)
+        pp = &dcache[*pp].chain;
+    if (*pp == i) *pp = dcache[i].chain;
+
+    dcache[i].used = 0;
+    dcache[i].chain = DCACHE_NONE;
+    lru_unlink(i);
+    lru_push_back(i);
+}
+
+/* 0 if cached as present, -1 if cached as absent, 1 on a miss. */
+int dcache_lookup(fat32_volume_t *vol, uint32_t parent, const char *name,
+                  fat32_direntry_t *out, uint32_t *out_cluster, uint32_t *out_offset) {
+    if (!dcache_ready || strlen_s(name) >= DCACHE_NAME_MAX) return 1;
+
+    uint32_t h = dcache_hash(vol->drive_letter, parent, name);
+    int rc = 1;
+    fat32_lock(&dcache_lock);
+    for (int16_t i = dcache_bucket[h % DCACHE_BUCKETS]; i != DCACHE_NONE; i = dcache[i].chain) {
+        dcache_entry_t *d = &dcache[i];
+        if (d->hash != h || d->drive != vol->drive_letter || d->parent != parent) continue;
+        if (strcasecmp_s(d->name, name) != 0) continue;
+
+        lru_unlink(i);
+        lru_push_front(i);
+        rc = -1;
+        if (!d->negative) {
+            memcpy_s(out, &d->entry, sizeof(fat32_direntry_t));
+            if (out_cluster) *out_cluster = d->cluster;
+            if (out_offset) *out_offset = d->offset;
+            rc = 0;
+        }
+        break;
+    }
+    fat32_unlock(&dcache_lock);
+    return rc;
+}
+
+/* entry == NULL records a negative entry. */
+void dcache_insert(fat32_volume_t *vol, uint32_t parent, const char *name,
+                   const fat32_direntry_t *entry, uint32_t cluster, uint32_t offset) {
+    if (!dcache_ready || strlen_s(name) >= DCACHE_NAME_MAX) return;
+
+    fat32_lock(&dcache_lock);
+    int16_t i = lru_tail;
+    dcache_remove(i);
+    lru_unlink(i);
+
+    dcache_entry_t *d = &dcache[i];
+    d->used = 1;
+    d->negative = entry ? 0 : 1;
+    d->drive = vol->drive_letter;
+    d->parent = parent;
+    d->hash = dcache_hash(vol->drive_letter, parent, name);
+    strcpy_s(d->name, name, sizeof(d->name));
+    if (entry) memcpy_s(&d->entry, entry, sizeof(fat32_direntry_t));
+    d->cluster = cluster;
+    d->offset = offset;
+
+    int16_t *bucket = &dcache_bucket[d->hash % DCACHE_BUCKETS];
+    d->chain = *bucket;
+    *bucket = i;
+    lru_push_front(i);
+    fat32_unlock(&dcache_lock);
+}
+
+/* A directory entry was rewritten or removed. */
+void dcache_drop_location(fat32_volume_t *vol, uint32_t cluster, uint32_t offset) {
+    if (!dcache_ready) return;
+    fat32_lock(&dcache_lock);
+    for (int16_t i = 0; i < DCACHE_ENTRIES; i++) {
+        dcache_entry_t *d = &dcache[i];
+        if (d->used && !d->negative && d->drive == vol->drive_letter &&
+            d->cluster == cluster && d->offset == offset)
+            dcache_remove(i);
+    }
+    fat32_unlock(&dcache_lock);
+}
+
+/* A name appeared in parent. Short name aliases make it hard to tell which
+ * negative entries that affects, so all of the directory's go. */
+void dcache_drop_negative(fat32_volume_t *vol, uint32_t parent) {
+    if (!dcache_ready) return;
+    fat32_lock(&dcache_lock);
+    for (int16_t i = 0; i < DCACHE_ENTRIES; i++) {
+        dcache_entry_t *d = &dcache[i];
+        if (d->used && d->negative && d->drive == vol->drive_letter && d->parent == parent)
+            dcache_remove(i);
+    }
+    fat32_unlock(&dcache_lock);
+}
+
+/* The directory itself went away; its cluster may be reused. */
+void dcache_drop_dir(fat32_volume_t *vol, uint32_t parent) {
+    if (!dcache_ready) return;
+    fat32_lock(&dcache_lock);
+    for (int16_t i = 0; i < DCACHE_ENTRIES; i++) {
+        dcache_entry_t *d = &dcache[i];
+        if (d->used && d->drive == vol->drive_letter && d->parent == parent)
+            dcache_remove(i);
+    }
+    fat32_unlock(&dcache_lock);
+}
+
+void dcache_drop_volume(uint8_t drive_letter) {
+    if (!dcache_ready) return;
+    fat32_lock(&dcache_lock);
+    for (int16_t i = 0; i < DCACHE_ENTRIES; i++) {
+        if (dcache[i].used && dcache[i].drive == drive_letter)
+            dcache_remove(i);
+    }
+    fat32_unlock(&dcache_lock);
+}
+
+void dcache_lock_stats(fat32_lock_count_t *out) {
+    out->acquired = dcache_lock.acquired;
+    out->contended = dcache_lock.contended;
+    out->waits = dcache_lock.waits;
+}
@@ -1,19 +1,20 @@
 #include "private.h"
 
-int find_in_dir(fat32_volume_t *vol, uint32_t dir_cluster, const char *name, 
-                       fat32_direntry_t *out, uint32_t *out_cluster, uint32_t *out_offset) {
+/* Returns 0 if found, -1 if not there, -2 if the directory could not be read. */
+static int scan_dir(fat32_volume_t *vol, uint32_t dir_cluster, const char *name, 
+                    fat32_direntry_t *out, uint32_t *out_cluster, uint32_t *out_offset) {
     char search[11];
     parse_filename(name, search);
     
     size_t cluster_size = vol->sectors_per_cluster * vol->bytes_per_sector;
     uint8_t *cluster_buf = kmalloc(cluster_size);
-    if (!cluster_buf) return -1;
+    if (!cluster_buf) return -2;
     
     uint32_t cluster = dir_cluster;
     while (cluster >= 2 && cluster < FAT32_EOC) {
         if (read_cluster(vol, cluster, cluster_buf) != 0) {
             kfree(cluster_buf);
-            return -1;
+            return -2;
         }
         
         fat32_direntry_t *entries = (fat32_direntry_t*)cluster_buf;
@@ -23,10 +24,9 @@ int find_in_dir(fat32_volume_t *vol, uint32_t dir_cluster, const char *name,
         int lfn_valid = 0;
         
         for (uint32_t i = 0; i < count; i++) {
-            if (entries[i].name[0] == 0x00) {
-                kfree(cluster_buf);
-                return -1;
-            }
+            /* Older trees extended directories without sealing the
+             * previous cluster, so only trust the marker per cluster */
+            if (entries[i].name[0] == 0x00) break;
             if ((uint8_t)entries[i].name[0] == 0xE5) {
                 lfn_valid = 0;
                 continue;
@@ -99,10 +99,30 @@ int find_in_dir(fat32_volume_t *vol, uint32_t dir_cluster, const char *name,
     return -1;
 }
 
+int find_in_dir(fat32_volume_t *vol, uint32_t dir_cluster, const char *name, 
+                fat32_direntry_t *out, uint32_t *out_cluster, uint32_t *out_offset) {
+    fat32_direntry_t entry;
+    uint32_t cluster = 0, offset = 0;
+
+    int rc = dcache_lookup(vol, dir_cluster, name, &entry, &cluster, &offset);
+    if (rc > 0) {
+        rc = scan_dir(vol, dir_cluster, name, &entry, &cluster, &offset);
+        if (rc == -2) return -1;
+        dcache_insert(vol, dir_cluster, name, rc == 0 ? &entry : NULL, cluster, offset);
+    }
+    if (rc != 0) return -1;
+
+    memcpy_s(out, &entry, sizeof(fat32_direntry_t));
+    if (out_cluster) *out_cluster = cluster;
+    if (out_offset) *out_offset = offset;
+    return 0;
+}
+
 int add_dir_entry(fat32_volume_t *vol, uint32_t dir_cluster, const char *name, 
                         uint32_t first_cluster, uint32_t size, uint8_t attr) {
     char short_name[11];
     parse_filename(name, short_name);
+    dcache_drop_negative(vol, dir_cluster);
     
     int name_len = strlen_s(name);
     int needs_lfn = 0;
@@ -218,6 +238,20 @@ int add_dir_entry(fat32_volume_t *vol, uint32_t dir_cluster, const char *name,
         
         uint32_t next = get_next_cluster(vol, cluster);
         if (next >= FAT32_EOC) {
+            /* Unused slots left here would read as end-of-directory and
+             * hide everything placed in the new cluster. */
+            int sealed = 0;
+            for (uint32_t i = 0; i < count; i++) {
+                if (entries[i].name[0] == 0x00) {
+                    entries[i].name[0] = (char)0xE5;
+                    sealed = 1;
+                }
+            }
+            if (sealed && write_cluster(vol, cluster, cluster_buf) != 0) {
+                kfree(cluster_buf);
+                return -1;
+            }
+
             uint32_t new_cluster = alloc_cluster(vol);
             if (new_cluster == 0) {
                 kfree(cluster_buf);
@@ -247,6 +281,7 @@ int remove_dir_entry(fat32_volume_t *vol, uint32_t dir_cluster, const char *name
     
     if (find_in_dir(vol, dir_cluster, name, &entry, &cluster, &offset) != 0)
         return -1;
+    dcache_drop_location(vol, cluster, offset);
     
     size_t cluster_size = vol->sectors_per_cluster * vol->bytes_per_sector;
     uint8_t *cluster_buf = kmalloc(cluster_size);
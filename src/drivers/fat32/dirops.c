@@ -1,15 +1,7 @@
 #include "private.h"
 
-static int fat32_list_dir_unlocked(const char *path, fat32_dirent_t *entries, int max_entries) {
-    if (!entries || max_entries <= 0) return -1;
-
-    uint8_t drive;
-    char rest[FAT32_MAX_PATH];
-    if (parse_path(path, &drive, rest, sizeof(rest)) != 0) return -1;
-
-    fat32_volume_t *vol = get_volume(drive);
-    if (!vol) return -1;
-
+/* Point a cursor at the start of the directory rest names on vol. */
+static int dir_start(fat32_volume_t *vol, const char *rest, fat32_dir_t *dir) {
     uint32_t dir_cluster;
     char filename[FAT32_MAX_PATH];
     if (navigate_path(vol, rest, &dir_cluster, filename) != 0) return -1;
@@ -23,125 +15,148 @@ static int fat32_list_dir_unlocked(const char *path, fat32_dirent_t *entries, in
     }
 
     size_t cluster_size = vol->sectors_per_cluster * vol->bytes_per_sector;
-    uint8_t *cluster_buf = kmalloc(cluster_size);
-    if (!cluster_buf) return -1;
+    dir->buf = kmalloc(cluster_size);
+    if (!dir->buf) return -1;
 
-    int count = 0;
-    uint32_t cluster = dir_cluster;
+    dir->drive = vol->drive_letter;
+    dir->cluster = dir_cluster;
+    dir->index = 0;
+    dir->loaded = 0;
+    dir->done = 0;
+    dir->lfn_valid = 0;
+    return 0;
+}
+
+static void dir_short_name(const fat32_direntry_t *e, char *out) {
+    int j = 0;
+    int name_end = 7;
+    while (name_end >= 0 && e->name[name_end] == ' ') name_end--;
     
-    while (cluster >= 2 && cluster < FAT32_EOC && count < max_entries) {
-        if (read_cluster(vol, cluster, cluster_buf) != 0) {
-            kfree(cluster_buf);
-            return -1;
-        }
-        
-        fat32_direntry_t *dir_entries = (fat32_direntry_t*)cluster_buf;
-        uint32_t entries_count = cluster_size / 32;
-        
-        char lfn_buffer[FAT32_MAX_PATH];
-        int lfn_valid = 0;
-        uint8_t lfn_checksum_val = 0;
+    for (int k = 0; k <= name_end; k++) {
+        out[j++] = e->name[k];
+    }
+    
+    if (e->name[8] != ' ') {
+        out[j++] = '.';
+        int ext_end = 10;
+        while (ext_end >= 8 && e->name[ext_end] == ' ') ext_end--;
         
-        for (uint32_t i = 0; i < entries_count && count < max_entries; i++) {
-            if (count >= max_entries) break;
+        for (int k = 8; k <= ext_end; k++) {
+            out[j++] = e->name[k];
+        }
+    }
+    out[j] = '\0';
+}
 
-            if (dir_entries[i].name[0] == 0x00) {
+/* Next visible entry: 1 if one was returned, 0 at the end, -1 on error. */
+static int dir_next(fat32_volume_t *vol, fat32_dir_t *dir, fat32_dirent_t *out) {
+    uint32_t entries_count = vol->sectors_per_cluster * vol->bytes_per_sector / 32;
+
+    while (!dir->done) {
+        if (!dir->loaded) {
+            if (dir->cluster < 2 || dir->cluster >= FAT32_EOC) {
+                dir->done = 1;
                 break;
             }
+            if (read_cluster(vol, dir->cluster, dir->buf) != 0) return -1;
+            dir->loaded = 1;
+            dir->index = 0;
+        }
+        if (dir->index >= entries_count) {
+            dir->cluster = get_next_cluster(vol, dir->cluster);
+            dir->loaded = 0;
+            continue;
+        }
+
+        fat32_direntry_t *e = &((fat32_direntry_t*)dir->buf)[dir->index++];
+
+        /* End marker only closes this cluster, as list_dir always did */
+        if (e->name[0] == 0x00) {
+            dir->index = entries_count;
+            dir->lfn_valid = 0;
+            continue;
+        }
+        
+        if ((uint8_t)e->name[0] == 0xE5) {
+            dir->lfn_valid = 0;
+            continue;
+        }
+        
+        if (e->attr == FAT_ATTR_LFN) {
+            lfn_entry_t *lfn = (lfn_entry_t*)e;
+            int order = lfn->order & 0x3F;
+            int is_last = (lfn->order & 0x40) != 0;
             
-            if ((uint8_t)dir_entries[i].name[0] == 0xE5) {
-                lfn_valid = 0;
-                continue;
-            }
-            
-            if (dir_entries[i].attr == FAT_ATTR_LFN) {
-                lfn_entry_t *lfn = (lfn_entry_t*)&dir_entries[i];
-                int order = lfn->order & 0x3F;
-                int is_last = (lfn->order & 0x40) != 0;
-                
-                if (is_last) {
-                    lfn_checksum_val = lfn->checksum;
-                    lfn_valid = 1;
-                    memset_s(lfn_buffer, 0, sizeof(lfn_buffer));
-                }
-                
-                if (lfn_valid && order > 0 && order <= 20) {
-                    int base = (order - 1) * 13;
-                    uint16_t temp1[5], temp2[6], temp3[2];
-                    memcpy_s(temp1, lfn->name1, sizeof(temp1));
-                    memcpy_s(temp2, lfn->name2, sizeof(temp2));
-                    memcpy_s(temp3, lfn->name3, sizeof(temp3));
-                    utf16_to_ascii(temp1, lfn_buffer + base, 5);
-                    utf16_to_ascii(temp2, lfn_buffer + base + 5, 6);
-                    utf16_to_ascii(temp3, lfn_buffer + base + 11, 2);
-                }
-                continue;
-            }
-            
-            if (dir_entries[i].attr & FAT_ATTR_VOLUME_ID) {
-                lfn_valid = 0;
-                continue;
-            }
-            
-            if (dir_entries[i].name[0] == '.' && 
-                (dir_entries[i].name[1] == ' ' || dir_entries[i].name[1] == '.')) {
-                lfn_valid = 0;
-                continue;
+            if (is_last) {
+                dir->lfn_checksum = lfn->checksum;
+                dir->lfn_valid = 1;
+                memset_s(dir->lfn, 0, sizeof(dir->lfn));
             }
             
-            memset_s(entries[count].name, 0, sizeof(entries[count].name));
-            
-            if (lfn_valid && lfn_checksum(dir_entries[i].name) == lfn_checksum_val) {
-                strcpy_s(entries[count].name, lfn_buffer, sizeof(entries[count].name));
-            } else {
-                int j = 0;
-                int name_end = 7;
-                while (name_end >= 0 && dir_entries[i].name[name_end] == ' ') name_end--;
-                
-                for (int k = 0; k <= name_end; k++) {
-                    entries[count].name[j++] = dir_entries[i].name[k];
-                }
-                
-                if (dir_entries[i].name[8] != ' ') {
-                    entries[count].name[j++] = '.';
-                    int ext_end = 10;
-                    while (ext_end >= 8 && dir_entries[i].name[ext_end] == ' ') ext_end--;
-                    
-                    for (int k = 8; k <= ext_end; k++) {
-                        entries[count].name[j++] = dir_entries[i].name[k];
-                    }
-                }
-                entries[count].name[j] = '\0';
+            if (dir->lfn_valid && order > 0 && order <= 20) {
+                int base = (order - 1) * 13;
+                uint16_t temp1[5], temp2[6], temp3[2];
+                memcpy_s(temp1, lfn->name1, sizeof(temp1));
+                memcpy_s(temp2, lfn->name2, sizeof(temp2));
+                memcpy_s(temp3, lfn->name3, sizeof(temp3));
+                utf16_to_ascii(temp1, dir->lfn + base, 5);
+                utf16_to_ascii(temp2, dir->lfn + base + 5, 6);
+                utf16_to_ascii(temp3, dir->lfn + base + 11, 2);
             }
-            
-            entries[count].size = dir_entries[i].file_size;
-            entries[count].first_cluster = ((uint32_t)dir_entries[i].first_cluster_high << 16) |
-                                          dir_entries[i].first_cluster_low;
-            entries[count].mtime = dir_entries[i].modified_time;
-            entries[count].mdate = dir_entries[i].modified_date;
-            entries[count].is_directory = (dir_entries[i].attr & FAT_ATTR_DIRECTORY) ? 1 : 0;
-            entries[count].attr = dir_entries[i].attr;
-            count++;
-            lfn_valid = 0;
+            continue;
+        }
+        
+        if (e->attr & FAT_ATTR_VOLUME_ID) {
+            dir->lfn_valid = 0;
+            continue;
+        }
+        
+        if (e->name[0] == '.' && (e->name[1] == ' ' || e->name[1] == '.')) {
+            dir->lfn_valid = 0;
+            continue;
         }
         
-        cluster = get_next_cluster(vol, cluster);
+        memset_s(out->name, 0, sizeof(out->name));
+        if (dir->lfn_valid && lfn_checksum(e->name) == dir->lfn_checksum)
+            strcpy_s(out->name, dir->lfn, sizeof(out->name));
+        else
+            dir_short_name(e, out->name);
+        
+        out->size = e->file_size;
+        out->first_cluster = ((uint32_t)e->first_cluster_high << 16) | e->first_cluster_low;
+        out->mtime = e->modified_time;
+        out->mdate = e->modified_date;
+        out->is_directory = (e->attr & FAT_ATTR_DIRECTORY) ? 1 : 0;
+        out->attr = e->attr;
+        dir->lfn_valid = 0;
+        return 1;
+    }
+    return 0;
+}
+
+static int fat32_list_dir_unlocked(fat32_volume_t *vol, const char *rest, fat32_dirent_t *entries,
+                                   int max_entries) {
+    if (!entries || max_entries <= 0) return -1;
+
+    fat32_dir_t dir;
+    if (dir_start(vol, rest, &dir) != 0) return -1;
+
+    int count = 0;
+    while (count < max_entries) {
+        int rc = dir_next(vol, &dir, &entries[count]);
+        if (rc < 0) {
+            kfree(dir.buf);
+            return -1;
+        }
+        if (rc == 0) break;
+        count++;
     }
     
-    kfree(cluster_buf);
+    kfree(dir.buf);
     return count;
 }
 
-static int fat32_mkdir_unlocked(const char *path) {
-    if (!path) return -1;
-    
-    uint8_t drive;
-    char rest[FAT32_MAX_PATH];
-    if (parse_path(path, &drive, rest, sizeof(rest)) != 0) return -1;
-    
-    fat32_volume_t *vol = get_volume(drive);
-    if (!vol) return -1;
-    
+static int fat32_mkdir_unlocked(fat32_volume_t *vol, const char *rest) {
     uint32_t dir_cluster;
     char dirname[FAT32_MAX_PATH];
     if (navigate_path(vol, rest, &dir_cluster, dirname) != 0) return -1;
@@ -191,20 +206,11 @@ static int fat32_mkdir_unlocked(const char *path) {
     }
     
     kfree(cluster_buf);
-    sync_fat(vol);
+    meta_commit(vol);
     return 0;
 }
 
-static int fat32_rmdir_unlocked(const char *path) {
-    if (!path) return -1;
-    
-    uint8_t drive;
-    char rest[FAT32_MAX_PATH];
-    if (parse_path(path, &drive, rest, sizeof(rest)) != 0) return -1;
-    
-    fat32_volume_t *vol = get_volume(drive);
-    if (!vol) return -1;
-    
+static int fat32_rmdir_unlocked(fat32_volume_t *vol, const char *rest) {
     uint32_t dir_cluster;
     char dirname[FAT32_MAX_PATH];
     if (navigate_path(vol, rest, &dir_cluster, dirname) != 0) return -1;
@@ -241,21 +247,13 @@ static int fat32_rmdir_unlocked(const char *path) {
     
     if (remove_dir_entry(vol, dir_cluster, dirname) != 0) return -1;
     
+    dcache_drop_dir(vol, target_cluster);
     free_cluster_chain(vol, target_cluster);
-    sync_fat(vol);
+    meta_commit(vol);
     return 0;
 }
 
-static int fat32_unlink_unlocked(const char *path) {
-    if (!path) return -1;
-    
-    uint8_t drive;
-    char rest[FAT32_MAX_PATH];
-    if (parse_path(path, &drive, rest, sizeof(rest)) != 0) return -1;
-    
-    fat32_volume_t *vol = get_volume(drive);
-    if (!vol) return -1;
-    
+static int fat32_unlink_unlocked(fat32_volume_t *vol, const char *rest) {
     uint32_t dir_cluster;
     char filename[FAT32_MAX_PATH];
     if (navigate_path(vol, rest, &dir_cluster, filename) != 0) return -1;
@@ -272,24 +270,17 @@ static int fat32_unlink_unlocked(const char *path) {
     
     if (first_cluster >= 2) free_cluster_chain(vol, first_cluster);
     
-    sync_fat(vol);
+    meta_commit(vol);
     return 0;
 }
 
-static int fat32_rename_unlocked(const char *oldpath, const char *newpath) {
-    if (!oldpath || !newpath) return -1;
-    
-    uint8_t old_drive, new_drive;
-    char old_rest[FAT32_MAX_PATH], new_rest[FAT32_MAX_PATH];
-    
-    if (parse_path(oldpath, &old_drive, old_rest, sizeof(old_rest)) != 0) return -1;
+static int fat32_rename_unlocked(fat32_volume_t *vol, const char *old_rest, const char *newpath) {
+    uint8_t new_drive;
+    char new_rest[FAT32_MAX_PATH];
     if (parse_path(newpath, &new_drive, new_rest, sizeof(new_rest)) != 0) return -1;
     
     /* Both paths must be on the same drive */
-    if (old_drive != new_drive) return -1;
-    
-    fat32_volume_t *vol = get_volume(old_drive);
-    if (!vol) return -1;
+    if (new_drive != vol->drive_letter) return -1;
     
     /* Parse old path to get directory and filename */
     uint32_t old_dir_cluster;
@@ -373,12 +364,14 @@ static int fat32_rename_unlocked(const char *oldpath, const char *newpath) {
                 return -1;
             }
             
-            sync_fat(vol);
+            meta_commit(vol);
             return 0;
         }
         
         /* Simple 8.3 rename: just update the name in place */
         memcpy_s(entries[entry_idx].name, new_83name, 11);
+        dcache_drop_location(vol, entry_cluster, entry_offset);
+        dcache_drop_negative(vol, old_dir_cluster);
         
         /* Update modification time */
         rtc_time_t rtc;
@@ -392,7 +385,7 @@ static int fat32_rename_unlocked(const char *oldpath, const char *newpath) {
         }
         
         kfree(cluster_buf);
-        sync_fat(vol);
+        meta_commit(vol);
         return 0;
     }
     
@@ -409,20 +402,11 @@ static int fat32_rename_unlocked(const char *oldpath, const char *newpath) {
         return -1;
     }
     
-    sync_fat(vol);
+    meta_commit(vol);
     return 0;
 }
 
-static int fat32_stat_unlocked(const char *path, fat32_dirent_t *entry) {
-    if (!path || !entry) return -1;
-    
-    uint8_t drive;
-    char rest[FAT32_MAX_PATH];
-    if (parse_path(path, &drive, rest, sizeof(rest)) != 0) return -1;
-    
-    fat32_volume_t *vol = get_volume(drive);
-    if (!vol) return -1;
-    
+static int fat32_stat_unlocked(fat32_volume_t *vol, const char *rest, fat32_dirent_t *entry) {
     uint32_t dir_cluster;
     char filename[FAT32_MAX_PATH];
     if (navigate_path(vol, rest, &dir_cluster, filename) != 0) return -1;
@@ -457,16 +441,7 @@ static char* fat32_getcwd_unlocked(char *buf, size_t size) {
     return buf;
 }
 
-static int fat32_chdir_unlocked(const char *path) {
-    if (!path) return -1;
-    
-    uint8_t drive;
-    char rest[FAT32_MAX_PATH];
-    if (parse_path(path, &drive, rest, sizeof(rest)) != 0) return -1;
-    
-    fat32_volume_t *vol = get_volume(drive);
-    if (!vol) return -1;
-    
+static int fat32_chdir_unlocked(fat32_volume_t *vol, const char *rest) {
     uint32_t dir_cluster;
     char dirname[FAT32_MAX_PATH];
     if (navigate_path(vol, rest, &dir_cluster, dirname) != 0) return -1;
@@ -477,7 +452,8 @@ static int fat32_chdir_unlocked(const char *path) {
         if (!(entry.attr & FAT_ATTR_DIRECTORY)) return -1;
     }
     
-    current_dir[0] = drive;
+    fat32_acquire();
+    current_dir[0] = vol->drive_letter;
     current_dir[1] = ':';
     current_dir[2] = '/';
     
@@ -493,49 +469,122 @@ static int fat32_chdir_unlocked(const char *path) {
             }
         }
     }
+    fat32_release();
     
     return 0;
 }
 
 int fat32_list_dir(const char *path, fat32_dirent_t *entries, int max_entries) {
+    if (!path) return -1;
+    char rest[FAT32_MAX_PATH];
+    fat32_volume_t *vol = lock_path(path, rest, sizeof(rest));
+    if (!vol) return -1;
+    int ret = fat32_list_dir_unlocked(vol, rest, entries, max_entries);
+    volume_unlock(vol);
+    return ret;
+}
+
+fat32_dir_t* fat32_opendir(const char *path) {
+    if (!path) return NULL;
+
     fat32_acquire();
-    int ret = fat32_list_dir_unlocked(path, entries, max_entries);
+    fat32_dir_t *dir = NULL;
+    for (int i = 0; i < FAT32_MAX_OPEN_DIRS; i++) {
+        if (!open_dirs[i].in_use) {
+            dir = &open_dirs[i];
+            break;
+        }
+    }
+    if (dir) {
+        dir->buf = NULL;
+        dir->done = 1;
+        dir->in_use = 1;
+    }
     fat32_release();
+    if (!dir) return NULL;
+
+    char rest[FAT32_MAX_PATH];
+    fat32_volume_t *vol = lock_path(path, rest, sizeof(rest));
+    int rc = vol ? dir_start(vol, rest, dir) : -1;
+    if (rc != 0) {
+        fat32_acquire();
+        dir->in_use = 0;
+        fat32_release();
+    }
+    if (vol) volume_unlock(vol);
+    return rc == 0 ? dir : NULL;
+}
+
+/* Cursors are only ever touched with their volume locked. */
+int fat32_readdir(fat32_dir_t *dir, fat32_dirent_t *entry) {
+    if (!dir || !dir->in_use || !entry) return -1;
+
+    fat32_volume_t *vol = volume_lock(dir->drive);
+    if (!vol) return -1;
+    int ret = dir->in_use ? dir_next(vol, dir, entry) : -1;
+    volume_unlock(vol);
     return ret;
 }
 
-int fat32_mkdir(const char *path) {
+void fat32_closedir(fat32_dir_t *dir) {
+    if (!dir || !dir->in_use) return;
+
+    fat32_volume_t *vol = volume_lock(dir->drive);
+    if (dir->buf) kfree(dir->buf);
+    dir->buf = NULL;
     fat32_acquire();
-    int ret = fat32_mkdir_unlocked(path);
+    dir->in_use = 0;
     fat32_release();
+    if (vol) volume_unlock(vol);
+}
+
+int fat32_mkdir(const char *path) {
+    if (!path) return -1;
+    char rest[FAT32_MAX_PATH];
+    fat32_volume_t *vol = lock_path(path, rest, sizeof(rest));
+    if (!vol) return -1;
+    int ret = fat32_mkdir_unlocked(vol, rest);
+    volume_unlock(vol);
     return ret;
 }
 
 int fat32_rmdir(const char *path) {
-    fat32_acquire();
-    int ret = fat32_rmdir_unlocked(path);
-    fat32_release();
+    if (!path) return -1;
+    char rest[FAT32_MAX_PATH];
+    fat32_volume_t *vol = lock_path(path, rest, sizeof(rest));
+    if (!vol) return -1;
+    int ret = fat32_rmdir_unlocked(vol, rest);
+    volume_unlock(vol);
     return ret;
 }
 
 int fat32_unlink(const char *path) {
-    fat32_acquire();
-    int ret = fat32_unlink_unlocked(path);
-    fat32_release();
+    if (!path) return -1;
+    char rest[FAT32_MAX_PATH];
+    fat32_volume_t *vol = lock_path(path, rest, sizeof(rest));
+    if (!vol) return -1;
+    int ret = fat32_unlink_unlocked(vol, rest);
+    volume_unlock(vol);
     return ret;
 }
 
 int fat32_rename(const char *oldpath, const char *newpath) {
-    fat32_acquire();
-    int ret = fat32_rename_unlocked(oldpath, newpath);
-    fat32_release();
+    if (!oldpath || !newpath) return -1;
+    char rest[FAT32_MAX_PATH];
+    fat32_volume_t *vol = lock_path(oldpath, rest, sizeof(rest));
+    if (!vol) return -1;
+    int ret = fat32_rename_unlocked(vol, rest, newpath);
+    volume_unlock(vol);
     return ret;
 }
 
 int fat32_stat(const char *path, fat32_dirent_t *entry) {
-    fat32_acquire();
-    int ret = fat32_stat_unlocked(path, entry);
-    fat32_release();
+    if (!path || !entry) return -1;
+    char rest[FAT32_MAX_PATH];
+    fat32_volume_t *vol = lock_path(path, rest, sizeof(rest));
+    if (!vol) return -1;
+    int ret = fat32_stat_unlocked(vol, rest, entry);
+    volume_unlock(vol);
     return ret;
 }
 
@@ -547,8 +596,11 @@ char* fat32_getcwd(char *buf, size_t size) {
 }
 
 int fat32_chdir(const char *path) {
-    fat32_acquire();
-    int ret = fat32_chdir_unlocked(path);
-    fat32_release();
+    if (!path) return -1;
+    char rest[FAT32_MAX_PATH];
+    fat32_volume_t *vol = lock_path(path, rest, sizeof(rest));
+    if (!vol) return -1;
+    int ret = fat32_chdir_unlocked(vol, rest);
+    volume_unlock(vol);
     return ret;
 }
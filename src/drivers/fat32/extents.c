@@ -0,0 +1,114 @@
+#include "private.h"
+
+/* Each open file keeps a map of the runs of physically contiguous clusters
+ * in its chain. The map only ever covers a prefix of the chain: it is
+ * extended on demand from the last mapped cluster, so growing the file
+ * never invalidates it, while freeing clusters anywhere on the volume
+ * throws it away. */
+
+void extent_reset(fat32_file_t *file) {
+    file->extent_count = 0;
+}
+
+void extent_free(fat32_file_t *file) {
+    if (file->extents) kfree(file->extents);
+    file->extents = NULL;
+    file->extent_count = 0;
+    file->extent_cap = 0;
+}
+
+void drop_extent_maps(fat32_volume_t *vol) {
+    for (int i = 0; i < FAT32_MAX_OPEN_FILES; i++) {
+        if (open_files[i].in_use && open_files[i].drive == vol->drive_letter)
+            extent_reset(&open_files[i]);
+    }
+}
+
+static int extent_push(fat32_file_t *file, uint32_t file_cluster, uint32_t disk_cluster) {
+    if (file->extent_count == file->extent_cap) {
+        uint32_t cap = file->extent_cap ? file->extent_cap * 2 : 8;
+        fat32_extent_t *map = kmalloc(cap * sizeof(fat32_extent_t));
+        if (!map) return -1;
+        if (file->extents) {
+            memcpy_s(map, file->extents, file->extent_count * sizeof(fat32_extent_t));
+            kfree(file->extents);
+        }
+        file->extents = map;
+        file->extent_cap = cap;
+    }
+
+    fat32_extent_t *e = &file->extents[file->extent_count++];
+    e->file_cluster = file_cluster;
+    e->disk_cluster = disk_cluster;
+    e->count = 1;
+    return 0;
+}
+
+/* Plain chain walk, used when the map cannot grow. */
+static uint32_t extent_walk(fat32_volume_t *vol, fat32_file_t *file, uint32_t index, uint32_t *chain_len) {
+    uint32_t cluster = file->first_cluster;
+    uint32_t n = 0;
+    while (n < index && cluster >= 2 && cluster < FAT32_EOC) {
+        cluster = get_next_cluster(vol, cluster);
+        n++;
+    }
+    if (cluster < 2 || cluster >= FAT32_EOC) {
+        if (chain_len) *chain_len = n;
+        return FAT32_EOC;
+    }
+    return cluster;
+}
+
+/* Disk cluster holding the index'th cluster of the file. Returns FAT32_EOC
+ * if the chain is shorter, with its length in chain_len. */
+uint32_t extent_lookup(fat32_volume_t *vol, fat32_file_t *file, uint32_t index, uint32_t *chain_len) {
+    if (file->first_cluster < 2 || file->first_cluster >= FAT32_EOC) {
+        if (chain_len) *chain_len = 0;
+        return FAT32_EOC;
+    }
+
+    uint32_t mapped = 0;
+    if (file->extent_count) {
+        fat32_extent_t *last = &file->extents[file->extent_count - 1];
+        mapped = last->file_cluster + last->count;
+    }
+
+    if (index < mapped) {
+        uint32_t lo = 0, hi = file->extent_count - 1;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi + 1) / 2;
+            if (file->extents[mid].file_cluster <= index) lo = mid;
+            else hi = mid - 1;
+        }
+        fat32_extent_t *e = &file->extents[lo];
+        return e->disk_cluster + (index - e->file_cluster);
+    }
+
+    uint32_t cluster;
+    if (file->extent_count) {
+        fat32_extent_t *last = &file->extents[file->extent_count - 1];
+        cluster = get_next_cluster(vol, last->disk_cluster + last->count - 1);
+    } else {
+        cluster = file->first_cluster;
+    }
+
+    uint32_t limit = vol->fat_cache_size / 4;
+    while (mapped <= index) {
+        if (cluster < 2 || cluster >= FAT32_EOC || mapped >= limit) {
+            if (chain_len) *chain_len = mapped;
+            return FAT32_EOC;
+        }
+
+        fat32_extent_t *last = file->extent_count ? &file->extents[file->extent_count - 1] : NULL;
+        if (last && last->disk_cluster + last->count == cluster) {
+            last->count++;
+        } else if (extent_push(file, mapped, cluster) != 0) {
+            return extent_walk(vol, file, index, chain_len);
+        }
+
+        mapped++;
+        if (mapped <= index)
+            cluster = get_next_cluster(vol, cluster);
+    }
+    return cluster;
+}
@@ -1,74 +1,29 @@
 #include "private.h"
 
-fat32_file_t* fat32_open(const char *path, const char *mode) {
-    if (!path || !mode) return NULL;
-
-    fat32_acquire();
-
-    uint8_t drive;
-    char rest[FAT32_MAX_PATH];
-    if (parse_path(path, &drive, rest, sizeof(rest)) != 0) {
-        /* parse_path failed */
-        fat32_release();
-        return NULL;
-    }
-    (void)drive; (void)rest;
-
-    fat32_volume_t *vol = get_volume(drive);
-    if (!vol) {
-        /* volume not found */
-        fat32_release();
-        return NULL;
-    }
-
-    fat32_file_t *file = NULL;
-    for (int i = 0; i < FAT32_MAX_OPEN_FILES; i++) {
-        if (!open_files[i].in_use) {
-            file = &open_files[i];
-            break;
-        }
-    }
-    if (!file) {
-        fat32_release();
-        return NULL;
-    }
-    /* allocated open_files slot */
-
+/* Look up (or create) the file for a claimed slot; volume lock held. */
+static int file_setup(fat32_volume_t *vol, fat32_file_t *file, const char *rest, char mode) {
     uint32_t dir_cluster;
     char filename[FAT32_MAX_PATH];
-    if (navigate_path(vol, rest, &dir_cluster, filename) != 0) {
-        /* navigate_path failed */
-        fat32_release();
-        return NULL;
-    }
-    (void)dir_cluster; (void)filename;
-
-    if (filename[0] == '\0') {
-        fat32_release();
-        return NULL;
-    }
+    if (navigate_path(vol, rest, &dir_cluster, filename) != 0) return -1;
+    if (filename[0] == '\0') return -1;
 
     fat32_direntry_t entry;
-    int found = find_in_dir(vol, dir_cluster, filename, &entry, NULL, NULL);
+    uint32_t dirent_cluster = 0, dirent_offset = 0;
+    int found = find_in_dir(vol, dir_cluster, filename, &entry, &dirent_cluster, &dirent_offset);
 
-    if (mode[0] == 'r' && found != 0) {
-        fat32_release();
-        return NULL;
-    }
+    if (mode == 'r' && found != 0) return -1;
 
-    if (mode[0] == 'w') {
+    if (mode == 'w') {
         if (found != 0) {
             uint32_t new_cluster = alloc_cluster(vol);
-            if (new_cluster == 0) {
-                fat32_release();
-                return NULL;
-            }
+            if (new_cluster == 0) return -1;
             if (add_dir_entry(vol, dir_cluster, filename, new_cluster, 0, FAT_ATTR_ARCHIVE) != 0) {
                 free_cluster_chain(vol, new_cluster);
-                fat32_release();
-                return NULL;
+                return -1;
             }
-            sync_fat(vol);
+            meta_commit(vol);
+            if (find_in_dir(vol, dir_cluster, filename, &entry, &dirent_cluster, &dirent_offset) != 0)
+                dirent_cluster = 0;
             file->first_cluster = new_cluster;
             file->size = 0;
         } else {
@@ -78,7 +33,7 @@ fat32_file_t* fat32_open(const char *path, const char *mode) {
                 free_cluster_chain(vol, next);
                 set_next_cluster(vol, first, FAT32_EOC);
             }
-            sync_fat(vol);
+            meta_commit(vol);
             file->first_cluster = first;
             file->size = 0;
         }
@@ -90,50 +45,231 @@ fat32_file_t* fat32_open(const char *path, const char *mode) {
     file->current_cluster = file->first_cluster;
     file->position = 0;
     file->cluster_offset = 0;
-    file->in_use = 1;
-    file->drive = drive;
-    file->mode = mode[0];
-    strcpy_s(file->path, path, sizeof(file->path));
+    file->cache_cluster = 0;
+    file->cache_cap = 0;
+    file->ra_window = 1;
+    file->ra_next = 0;
+    file->last_cluster = (mode == 'w') ? file->first_cluster : 0;
+    file->dirent_cluster = dirent_cluster;
+    file->dirent_offset = dirent_offset;
+    file->meta_dirty = (mode == 'w');
+    file->reserved = 0;
+    file->mode = mode;
 
+    /* Keep the resolved path so a later chdir cannot change what it means */
+    file->path[0] = vol->drive_letter;
+    file->path[1] = ':';
+    file->path[2] = '/';
+    strcpy_s(file->path + 3, rest[0] == '/' ? rest + 1 : rest, sizeof(file->path) - 3);
+    file->drive = vol->drive_letter;
+    return 0;
+}
+
+fat32_file_t* fat32_open(const char *path, const char *mode) {
+    if (!path || !mode) return NULL;
+
+    /* Claim a slot first; with nothing cached it is ignored by the
+     * coherence walks over open_files until it is filled in. */
+    fat32_acquire();
+    fat32_file_t *file = NULL;
+    for (int i = 0; i < FAT32_MAX_OPEN_FILES; i++) {
+        if (!open_files[i].in_use) {
+            file = &open_files[i];
+            break;
+        }
+    }
+    if (file) {
+        file->drive = 0;
+        file->cache = NULL;
+        file->cache_count = 0;
+        file->dirty_cluster = 0;
+        file->extents = NULL;
+        file->extent_count = 0;
+        file->extent_cap = 0;
+        file->in_use = 1;
+    }
     fat32_release();
-    return file;
+    if (!file) return NULL;
+
+    fat32_lock(&file->lock);
+    char rest[FAT32_MAX_PATH];
+    fat32_volume_t *vol = lock_path(path, rest, sizeof(rest));
+    int rc = vol ? file_setup(vol, file, rest, mode[0]) : -1;
+    if (rc != 0) {
+        fat32_acquire();
+        file->in_use = 0;
+        fat32_release();
+    }
+    if (vol) volume_unlock(vol);
+    fat32_unlock(&file->lock);
+    return rc == 0 ? file : NULL;
+}
+
+/* Pointer to cluster inside the file's cache, or NULL if not cached. */
+static uint8_t *file_cached(fat32_volume_t *vol, fat32_file_t *file, uint32_t cluster) {
+    if (file->cache_count == 0) return NULL;
+    if (cluster < file->cache_cluster || cluster >= file->cache_cluster + file->cache_count)
+        return NULL;
+    return file->cache + (cluster - file->cache_cluster) * vol->sectors_per_cluster * vol->bytes_per_sector;
+}
+
+/* Write the buffered cluster back to disk, if there is one. */
+int file_writeback(fat32_volume_t *vol, fat32_file_t *file) {
+    uint32_t cluster = file->dirty_cluster;
+    if (!cluster) return 0;
+
+    uint8_t *data = file_cached(vol, file, cluster);
+    file->dirty_cluster = 0;
+    if (!data) return 0;
+
+    if (write_cluster(vol, cluster, data) != 0) {
+        file->dirty_cluster = cluster;
+        return -1;
+    }
+    return 0;
+}
+
+/* Make sure the cache buffer can hold at least count clusters. On failure
+ * an existing smaller buffer is kept. */
+static int file_cache_reserve(fat32_volume_t *vol, fat32_file_t *file, uint32_t count) {
+    if (file->cache && file->cache_cap >= count) return 0;
+
+    uint8_t *buf = kmalloc(count * vol->sectors_per_cluster * vol->bytes_per_sector);
+    if (!buf) return file->cache ? 0 : -1;
+
+    if (file->cache) kfree(file->cache);
+    file->cache = buf;
+    file->cache_cap = count;
+    file->cache_count = 0;
+    return 0;
+}
+
+/* Fill the cache starting at cluster. A reader that keeps continuing where
+ * it left off gets a window that doubles on every miss, up to
+ * FAT32_READAHEAD_MAX; any other access pattern drops back to one cluster.
+ * The window is then trimmed to the file size and to the stretch of the
+ * chain that is contiguous on disk, so it always costs a single request. */
+static int file_fill_cache(fat32_volume_t *vol, fat32_file_t *file, uint32_t cluster, int readahead) {
+    uint32_t cluster_size = vol->sectors_per_cluster * vol->bytes_per_sector;
+    uint32_t max = FAT32_READAHEAD_MAX / cluster_size;
+    if (max == 0) max = 1;
+
+    if (file_writeback(vol, file) != 0) return -1;
+
+    uint32_t window = 1;
+    if (readahead) {
+        if (file->position == file->ra_next) {
+            window = file->ra_window * 2;
+            if (window > max) window = max;
+        }
+        file->ra_window = window;
+
+        uint32_t cluster_start = file->position - file->cluster_offset;
+        uint32_t left = file->size > cluster_start ? file->size - cluster_start : 0;
+        uint32_t in_file = (left + cluster_size - 1) / cluster_size;
+        if (window > in_file) window = in_file ? in_file : 1;
+    }
+
+    if (file_cache_reserve(vol, file, window) != 0) return -1;
+    if (window > file->cache_cap) window = file->cache_cap;
+    window = cluster_run(vol, cluster, window);
+
+    file->cache_count = 0;
+    if (read_data_clusters(vol, cluster, window, file->cache) != 0) return -1;
+    file->cache_cluster = cluster;
+    file->cache_count = window;
+    return 0;
+}
+
+/* Copy from the part of the current cluster that is already cached. This
+ * needs no volume lock: only the owner refills or frees its cache, other
+ * handles merely write back or invalidate it. Stops at the cluster end. */
+static size_t read_cached(fat32_volume_t *vol, fat32_file_t *file, uint8_t *dst, size_t to_read) {
+    uint32_t cluster_size = vol->sectors_per_cluster * vol->bytes_per_sector;
+    if (file->current_cluster < 2 || file->current_cluster >= FAT32_EOC) return 0;
+
+    uint8_t *cached = file_cached(vol, file, file->current_cluster);
+    if (!cached || file->cluster_offset >= cluster_size) return 0;
+
+    uint32_t available = cluster_size - file->cluster_offset;
+    uint32_t chunk = (to_read < available) ? (uint32_t)to_read : available;
+    memcpy_s(dst, cached + file->cluster_offset, chunk);
+    file->position += chunk;
+    file->cluster_offset += chunk;
+    return chunk;
 }
 
 int fat32_read(fat32_file_t *file, void *buffer, size_t size) {
-    if (!file || !file->in_use || !buffer) return -1;
-    if (file->position >= file->size) return 0;
-    
-    fat32_acquire();
+    if (!file || !buffer) return -1;
+    if (file_lock(file) != 0) return -1;
     
     fat32_volume_t *vol = get_volume(file->drive);
     if (!vol) {
-        fat32_release();
+        file_unlock(file);
         return -1;
     }
+    if (file->position >= file->size) {
+        file_unlock(file);
+        return 0;
+    }
     
-    size_t bytes_read = 0;
     size_t to_read = size;
     if (file->position + to_read > file->size)
         to_read = file->size - file->position;
     
-    size_t cluster_size = vol->sectors_per_cluster * vol->bytes_per_sector;
-    uint8_t *cluster_buf = kmalloc(cluster_size);
-    if (!cluster_buf) {
-        fat32_release();
-        return -1;
+    uint32_t cluster_size = vol->sectors_per_cluster * vol->bytes_per_sector;
+    uint8_t *dst = (uint8_t*)buffer;
+    size_t bytes_read = read_cached(vol, file, dst, to_read);
+    to_read -= bytes_read;
+    if (to_read == 0) {
+        file->ra_next = file->position;
+        file_unlock(file);
+        return (int)bytes_read;
+    }
+
+    vol = volume_lock(file->drive);
+    if (!vol) {
+        file_unlock(file);
+        return bytes_read ? (int)bytes_read : -1;
+    }
+    if (file->cluster_offset >= cluster_size) {
+        file->current_cluster = get_next_cluster(vol, file->current_cluster);
+        file->cluster_offset = 0;
     }
     
     while (to_read > 0 && file->current_cluster >= 2 && file->current_cluster < FAT32_EOC) {
-        if (read_cluster(vol, file->current_cluster, cluster_buf) != 0) {
-            kfree(cluster_buf);
-            fat32_release();
-            return -1;
+        uint8_t *cached = file_cached(vol, file, file->current_cluster);
+
+        if (!cached && file->cluster_offset == 0 && to_read >= cluster_size) {
+            /* Whole clusters wanted: read the contiguous run straight into
+             * the caller's buffer */
+            uint32_t run = cluster_run(vol, file->current_cluster, to_read / cluster_size);
+            if (read_data_clusters(vol, file->current_cluster, run, dst + bytes_read) != 0) {
+                volume_unlock(vol);
+                file_unlock(file);
+                return bytes_read ? (int)bytes_read : -1;
+            }
+            uint32_t chunk = run * cluster_size;
+            bytes_read += chunk;
+            to_read -= chunk;
+            file->position += chunk;
+            file->current_cluster = get_next_cluster(vol, file->current_cluster + run - 1);
+            continue;
         }
-        
+
+        if (!cached) {
+            if (file_fill_cache(vol, file, file->current_cluster, 1) != 0) {
+                volume_unlock(vol);
+                file_unlock(file);
+                return bytes_read ? (int)bytes_read : -1;
+            }
+            cached = file->cache;
+        }
+
         uint32_t available = cluster_size - file->cluster_offset;
         uint32_t chunk = (to_read < available) ? (uint32_t)to_read : available;
-        
-        memcpy_s((uint8_t*)buffer + bytes_read, cluster_buf + file->cluster_offset, chunk);
+        memcpy_s(dst + bytes_read, cached + file->cluster_offset, chunk);
+
         bytes_read += chunk;
         to_read -= chunk;
         file->position += chunk;
@@ -145,73 +281,116 @@ int fat32_read(fat32_file_t *file, void *buffer, size_t size) {
         }
     }
     
-    kfree(cluster_buf);
-    fat32_release();
+    file->ra_next = file->position;
+    volume_unlock(vol);
+    file_unlock(file);
     return (int)bytes_read;
 }
 
+/* Last cluster of the chain. The cached tail is only a hint: another
+ * handle may have grown the file since. */
+static uint32_t file_tail(fat32_volume_t *vol, fat32_file_t *file) {
+    uint32_t last = file->last_cluster ? file->last_cluster : file->first_cluster;
+    uint32_t next;
+    while ((next = get_next_cluster(vol, last)) >= 2 && next < FAT32_EOC)
+        last = next;
+    return last;
+}
+
+/* Length of the run of contiguous clusters starting at cluster, at most max.
+ * At the end of the chain the run is grown for as long as the clusters
+ * right after it are free. */
+static uint32_t file_grow_run(fat32_volume_t *vol, fat32_file_t *file, uint32_t cluster, uint32_t max) {
+    uint32_t n = cluster_run(vol, cluster, max);
+    while (n < max) {
+        uint32_t last = cluster + n - 1;
+        if (get_next_cluster(vol, last) < FAT32_EOC || !cluster_is_free(vol, last + 1)) break;
+        if (alloc_cluster_near(vol, last, 1) != last + 1) break;
+        set_next_cluster(vol, last, last + 1);
+        file->last_cluster = last + 1;
+        n++;
+    }
+    return n;
+}
+
 int fat32_write(fat32_file_t *file, const void *buffer, size_t size) {
-    if (!file || !file->in_use || !buffer) return -1;
-    if (file->mode != 'w' && file->mode != 'a') return -1;
-    
-    fat32_acquire();
+    if (!file || !buffer) return -1;
+    if (file_lock(file) != 0) return -1;
+    if (file->mode != 'w' && file->mode != 'a') {
+        file_unlock(file);
+        return -1;
+    }
     
-    fat32_volume_t *vol = get_volume(file->drive);
+    fat32_volume_t *vol = volume_lock(file->drive);
     if (!vol) {
-        fat32_release();
+        file_unlock(file);
         return -1;
     }
     
     size_t bytes_written = 0;
-    size_t cluster_size = vol->sectors_per_cluster * vol->bytes_per_sector;
-    uint8_t *cluster_buf = kmalloc(cluster_size);
-    if (!cluster_buf) {
-        fat32_release();
-        return -1;
-    }
+    uint32_t cluster_size = vol->sectors_per_cluster * vol->bytes_per_sector;
+    const uint8_t *src = (const uint8_t*)buffer;
     
     while (size > 0) {
+        int fresh = 0;
+
         if (file->current_cluster >= FAT32_EOC || file->current_cluster < 2) {
-            uint32_t new_cluster = alloc_cluster(vol);
+            /* Ask for room for the rest of this write in one run */
+            uint32_t tail = file->first_cluster ? file_tail(vol, file) : 0;
+            uint32_t want = (file->cluster_offset + size + cluster_size - 1) / cluster_size;
+            uint32_t new_cluster = alloc_cluster_near(vol, tail, want);
             if (new_cluster == 0) break;
             
-            if (file->first_cluster == 0) {
+            if (tail)
+                set_next_cluster(vol, tail, new_cluster);
+            else
                 file->first_cluster = new_cluster;
-                file->current_cluster = new_cluster;
-            } else {
-                uint32_t last = file->first_cluster;
-                uint32_t next;
-                while ((next = get_next_cluster(vol, last)) < FAT32_EOC) {
-                    last = next;
-                }
-                set_next_cluster(vol, last, new_cluster);
-                file->current_cluster = new_cluster;
-            }
-            
-            memset_s(cluster_buf, 0, cluster_size);
-            if (write_cluster(vol, new_cluster, cluster_buf) != 0) {
-                kfree(cluster_buf);
-                return -1;
-            }
-        }
-        
-        if (file->cluster_offset != 0 || size < cluster_size) {
-            if (read_cluster(vol, file->current_cluster, cluster_buf) != 0) {
-                kfree(cluster_buf);
-                fat32_release();
-                return -1;
-            }
+            file->last_cluster = new_cluster;
+            file->current_cluster = new_cluster;
+            fresh = 1;
         }
         
         uint32_t available = cluster_size - file->cluster_offset;
         uint32_t chunk = (size < available) ? (uint32_t)size : available;
-        
-        memcpy_s(cluster_buf + file->cluster_offset, (const uint8_t*)buffer + bytes_written, chunk);
-        
-        if (write_cluster(vol, file->current_cluster, cluster_buf) != 0) {
-            kfree(cluster_buf);
-            fat32_release();
-            return -1;
+
+        if (chunk == cluster_size) {
+            /* Whole clusters supplied: write as long a run as the chain
+             * allows straight from the caller, then treat it as one big
+             * cluster so the step below moves past all of it */
+            uint32_t run = file_grow_run(vol, file, file->current_cluster, size / cluster_size);
+            if (write_clusters(vol, file->current_cluster, run, src + bytes_written) != 0) break;
+            file->current_cluster += run - 1;
+            chunk = run * cluster_size;
+        } else {
+            /* Partial cluster: patch the cached copy and leave it dirty
+             * until the handle moves on to another cluster or is flushed */
+            uint8_t *cached = file_cached(vol, file, file->current_cluster);
+            if (fresh) {
+                if (file_writeback(vol, file) != 0) break;
+                if (file_cache_reserve(vol, file, 1) != 0) break;
+                memset_s(file->cache, 0, cluster_size);
+                file->cache_cluster = file->current_cluster;
+                file->cache_count = 1;
+                cached = file->cache;
+            } else if (!cached && file->reserved && file->position - file->cluster_offset >= file->size) {
+                /* Preallocated cluster past the end: nothing worth reading */
+                if (file_writeback(vol, file) != 0) break;
+                if (file_cache_reserve(vol, file, 1) != 0) break;
+                memset_s(file->cache, 0, cluster_size);
+                file->cache_cluster = file->current_cluster;
+                file->cache_count = 1;
+                cached = file->cache;
+            } else if (!cached) {
+                if (file_fill_cache(vol, file, file->current_cluster, 0) != 0) break;
+                cached = file->cache;
+            } else if (file->dirty_cluster != file->current_cluster) {
+                if (file_writeback(vol, file) != 0) break;
+            }
+            memcpy_s(cached + file->cluster_offset, src + bytes_written, chunk);
+            if (file->dirty_cluster != file->current_cluster) {
+                drop_cached_cluster(vol, file->current_cluster, cached);
+                file->dirty_cluster = file->current_cluster;
+            }
         }
         
         bytes_written += chunk;
@@ -227,35 +406,142 @@ int fat32_write(fat32_file_t *file, const void *buffer, size_t size) {
     
     if (file->position > file->size)
         file->size = file->position;
+    if (bytes_written) file->meta_dirty = 1;
     
-    kfree(cluster_buf);
-    fat32_release();
+    volume_unlock(vol);
+    file_unlock(file);
+    if (bytes_written) writeback_kick();
+    if (bytes_written == 0 && size > 0) return -1;
     return (int)bytes_written;
 }
 
+/* Copy up to size bytes from src's position to dst's. The bounce buffer
+ * is large enough for the read and write paths to move whole runs of
+ * clusters per request. Returns the number of bytes copied, 0 once src is
+ * at its end. */
+int fat32_copy(fat32_file_t *dst, fat32_file_t *src, uint32_t size) {
+    if (!dst || !src || dst == src) return -1;
+
+    uint8_t *buf = kmalloc(FAT32_READAHEAD_MAX);
+    if (!buf) return -1;
+
+    uint32_t copied = 0;
+    int rc = 0;
+    while (copied < size) {
+        uint32_t want = size - copied < FAT32_READAHEAD_MAX ? size - copied : FAT32_READAHEAD_MAX;
+        int n = fat32_read(src, buf, want);
+        if (n <= 0) {
+            rc = n;
+            break;
+        }
+        if (fat32_write(dst, buf, (size_t)n) != n) {
+            rc = -1;
+            break;
+        }
+        copied += (uint32_t)n;
+    }
+
+    kfree(buf);
+    return copied ? (int)copied : rc;
+}
+
+/* Reserve a contiguous run of clusters so the chain covers size bytes.
+ * The size seen by readers does not change; whatever is still unused when
+ * the handle is closed is given back. */
+int fat32_preallocate(fat32_file_t *file, uint32_t size) {
+    if (!file) return -1;
+    if (file_lock(file) != 0) return -1;
+    if (file->mode != 'w' && file->mode != 'a') {
+        file_unlock(file);
+        return -1;
+    }
+
+    fat32_volume_t *vol = volume_lock(file->drive);
+    if (!vol) {
+        file_unlock(file);
+        return -1;
+    }
+
+    uint32_t cluster_size = vol->sectors_per_cluster * vol->bytes_per_sector;
+    uint32_t need = size / cluster_size + (size % cluster_size != 0);
+    uint32_t have = 0;
+    uint32_t tail = 0;
+    if (file->first_cluster >= 2 && file->first_cluster < FAT32_EOC) {
+        tail = file_tail(vol, file);
+        extent_lookup(vol, file, 0xFFFFFFFF, &have);  /* just measures the chain */
+    }
+
+    int rc = 0;
+    if (need > have) {
+        uint32_t first = alloc_cluster_run(vol, tail, need - have);
+        if (first == 0) {
+            rc = -1;
+        } else {
+            if (tail) {
+                set_next_cluster(vol, tail, first);
+            } else {
+                file->first_cluster = first;
+                file->meta_dirty = 1;
+            }
+            file->last_cluster = first + (need - have) - 1;
+            file->reserved = 1;
+
+            /* A handle sitting at the old end of the chain moves on into
+             * the new run */
+            if (file->current_cluster < 2 || file->current_cluster >= FAT32_EOC)
+                file->current_cluster = extent_lookup(vol, file, file->position / cluster_size, NULL);
+            meta_commit(vol);
+        }
+    }
+
+    volume_unlock(vol);
+    file_unlock(file);
+    return rc;
+}
+
+/* Give back preallocated clusters the file did not grow into. An empty
+ * file keeps its first cluster, like one truncated by opening it "w". */
+static void file_trim(fat32_volume_t *vol, fat32_file_t *file) {
+    if (!file->reserved) return;
+    file->reserved = 0;
+    if (file->first_cluster < 2 || file->first_cluster >= FAT32_EOC) return;
+
+    uint32_t cluster_size = vol->sectors_per_cluster * vol->bytes_per_sector;
+    uint32_t keep = (file->size + cluster_size - 1) / cluster_size;
+    if (keep == 0) keep = 1;
+
+    uint32_t last = extent_lookup(vol, file, keep - 1, NULL);
+    if (last < 2 || last >= FAT32_EOC) return;
+    uint32_t next = get_next_cluster(vol, last);
+    if (next >= 2 && next < FAT32_EOC) {
+        free_cluster_chain(vol, next);
+        set_next_cluster(vol, last, FAT32_EOC);
+    }
+    file->last_cluster = last;
+}
+
 int fat32_seek(fat32_file_t *file, uint32_t offset) {
-    if (!file || !file->in_use) return -1;
-    
-    fat32_acquire();
+    if (!file) return -1;
+    if (file_lock(file) != 0) return -1;
     
-    fat32_volume_t *vol = get_volume(file->drive);
+    fat32_volume_t *vol = volume_lock(file->drive);
     if (!vol) {
-        fat32_release();
+        file_unlock(file);
         return -1;
     }
     
-    file->position = offset;
-    file->current_cluster = file->first_cluster;
-    file->cluster_offset = 0;
-    
     uint32_t cluster_size = vol->sectors_per_cluster * vol->bytes_per_sector;
-    while (offset >= cluster_size && file->current_cluster < FAT32_EOC) {
-        file->current_cluster = get_next_cluster(vol, file->current_cluster);
-        offset -= cluster_size;
-    }
+    uint32_t index = offset / cluster_size;
+    uint32_t chain_len = 0;
     
-    file->cluster_offset = offset;
-    fat32_release();
+    file->position = offset;
+    file->current_cluster = extent_lookup(vol, file, index, &chain_len);
+    if (file->current_cluster >= FAT32_EOC)
+        file->cluster_offset = offset - chain_len * cluster_size;
+    else
+        file->cluster_offset = offset % cluster_size;
+    volume_unlock(vol);
+    file_unlock(file);
     return 0;
 }
 
@@ -263,53 +549,118 @@ uint32_t fat32_tell(fat32_file_t *file) {
     return file ? file->position : 0;
 }
 
+/* Rewrite the file's directory entry. The location remembered at open is
+ * checked first; if the entry has moved the path is looked up again. */
+static int file_update_dirent(fat32_volume_t *vol, fat32_file_t *file) {
+    size_t cluster_size = vol->sectors_per_cluster * vol->bytes_per_sector;
+    uint8_t *cluster_buf = kmalloc(cluster_size);
+    if (!cluster_buf) return -1;
+
+    fat32_direntry_t *entry = NULL;
+    if (file->dirent_cluster && read_cluster(vol, file->dirent_cluster, cluster_buf) == 0) {
+        entry = (fat32_direntry_t*)(cluster_buf + file->dirent_offset);
+        uint32_t first = ((uint32_t)entry->first_cluster_high << 16) | entry->first_cluster_low;
+        if (entry->name[0] == 0x00 || (uint8_t)entry->name[0] == 0xE5 ||
+            entry->attr == FAT_ATTR_LFN || (first != 0 && first != file->first_cluster))
+            entry = NULL;
+    }
+
+    if (!entry) {
+        uint8_t drive;
+        char rest[FAT32_MAX_PATH];
+        uint32_t dir_cluster;
+        char filename[FAT32_MAX_PATH];
+        fat32_direntry_t found;
+        uint32_t cluster, offset;
+
+        if (parse_path(file->path, &drive, rest, sizeof(rest)) != 0 || drive != vol->drive_letter ||
+            navigate_path(vol, rest, &dir_cluster, filename) != 0 ||
+            find_in_dir(vol, dir_cluster, filename, &found, &cluster, &offset) != 0 ||
+            read_cluster(vol, cluster, cluster_buf) != 0) {
+            kfree(cluster_buf);
+            return -1;
+        }
+        file->dirent_cluster = cluster;
+        file->dirent_offset = offset;
+        entry = (fat32_direntry_t*)(cluster_buf + offset);
+    }
+
+    dcache_drop_location(vol, file->dirent_cluster, file->dirent_offset);
+    entry->file_size = file->size;
+    entry->first_cluster_high = (uint16_t)(file->first_cluster >> 16);
+    entry->first_cluster_low = (uint16_t)(file->first_cluster & 0xFFFF);
+
+    /* Update modification timestamp */
+    uint16_t fat_time, fat_date;
+    get_fat_timestamp(&fat_time, &fat_date);
+    entry->modified_time = fat_time;
+    entry->modified_date = fat_date;
+    entry->accessed_date = fat_date;
+
+    int rc = write_cluster(vol, file->dirent_cluster, cluster_buf);
+    kfree(cluster_buf);
+    return rc;
+}
+
+/* Write the buffered cluster and the directory entry; the FAT is left to
+ * the caller. */
+int file_flush(fat32_volume_t *vol, fat32_file_t *file) {
+    int rc = 0;
+    if (file_writeback(vol, file) != 0) rc = -1;
+    if (file->meta_dirty) {
+        if (file_update_dirent(vol, file) != 0) {
+            printf("Failed to write directory entry\n");
+            rc = -1;
+        } else {
+            file->meta_dirty = 0;
+        }
+    }
+    return rc;
+}
+
+int fat32_flush(fat32_file_t *file) {
+    if (!file) return -1;
+    if (file_lock(file) != 0) return -1;
+    if (file->mode != 'w' && file->mode != 'a') {
+        file_unlock(file);
+        return 0;
+    }
+
+    int rc = -1;
+    fat32_volume_t *vol = volume_lock(file->drive);
+    if (vol) {
+        rc = sync_fat(vol);
+        if (file_flush(vol, file) != 0) rc = -1;
+        if (blk_flush(vol->dev) != 0) rc = -1;
+        volume_unlock(vol);
+    }
+    file_unlock(file);
+    return rc;
+}
+
 void fat32_close(fat32_file_t *file) {
-    if (!file || !file->in_use) return;
+    if (!file) return;
+    if (file_lock(file) != 0) return;
     
-    fat32_acquire();
-    
-    if (file->mode == 'w' || file->mode == 'a') {
-        fat32_volume_t *vol = get_volume(file->drive);
-        if (vol) {
-            sync_fat(vol);
-            
-            uint8_t drive;
-            char rest[FAT32_MAX_PATH];
-            if (parse_path(file->path, &drive, rest, sizeof(rest)) == 0) {
-                uint32_t dir_cluster;
-                char filename[FAT32_MAX_PATH];
-                if (navigate_path(vol, rest, &dir_cluster, filename) == 0) {
-                    fat32_direntry_t entry;
-                    uint32_t cluster, offset;
-                    
-                    if (find_in_dir(vol, dir_cluster, filename, &entry, &cluster, &offset) == 0) {
-                        size_t cluster_size = vol->sectors_per_cluster * vol->bytes_per_sector;
-                        uint8_t *cluster_buf = kmalloc(cluster_size);
-                        if (cluster_buf) {
-                            if (read_cluster(vol, cluster, cluster_buf) == 0) {
-                                fat32_direntry_t *entries = (fat32_direntry_t*)cluster_buf;
-                                uint32_t idx = offset / 32;
-                                entries[idx].file_size = file->size;
-
-                                /* Update modification timestamp */
-                                uint16_t fat_time, fat_date;
-                                get_fat_timestamp(&fat_time, &fat_date);
-                                entries[idx].modified_time = fat_time;
-                                entries[idx].modified_date = fat_date;
-                                entries[idx].accessed_date = fat_date;
-
-                                if (write_cluster(vol, cluster, cluster_buf) != 0) {
-                                    printf("Failed to write directory entry\n");
-                                }
-                            }
-                            kfree(cluster_buf);
-                        }
-                    }
-                }
-            }
-        }
+    /* Other handles reach into this one's cache under the volume lock */
+    fat32_volume_t *vol = volume_lock(file->drive);
+    if (vol && (file->mode == 'w' || file->mode == 'a')) {
+        file_trim(vol, file);
+        file_flush(vol, file);
+        meta_commit(vol);
     }
     
+    file->cache_count = 0;
+    file->dirty_cluster = 0;
+    if (file->cache) {
+        kfree(file->cache);
+        file->cache = NULL;
+    }
+    file->cache_cap = 0;
+    extent_free(file);
+    fat32_acquire();
     file->in_use = 0;
     fat32_release();
+    if (vol) volume_unlock(vol);
+    file_unlock(file);
 }
@@ -0,0 +1,129 @@
+#include "private.h"
+#include "../../mem/pmm.h"
+
+/* Write-back of metadata and buffered data. Operations only change the
+ * cached FAT and leave it dirty; a flusher task writes out the changed FAT
+ * sectors, the buffered cluster and directory entry of every open file and
+ * then empties the disk's write cache, once per interval. It exits when
+ * there is nothing left to write and is started again by the next change.
+ * An interval of 0 writes every change through as it is made. */
+
+static uint32_t writeback_ms = FAT32_WRITEBACK_MS;
+static int flusher_running = 0;
+static fat32_lock_t flusher_lock;  /* the two above; taken after any volume lock */
+
+static int writeback_all(int shrink);
+
+void writeback_reset(void) {
+    writeback_ms = FAT32_WRITEBACK_MS;
+    flusher_running = 0;
+}
+
+void fat32_set_writeback(uint32_t interval_ms) {
+    fat32_lock(&flusher_lock);
+    writeback_ms = interval_ms;
+    fat32_unlock(&flusher_lock);
+    if (interval_ms == 0) fat32_sync();
+}
+
+/* Anything the flusher still has to write? Only looks, so the answer can
+ * be out of date by the time it is used. */
+static int writeback_pending(void) {
+    for (int i = 0; i < FAT32_MAX_VOLUMES; i++) {
+        if (volumes[i].mounted && (fat_dirty[i] || volumes[i].fsinfo_dirty)) return 1;
+    }
+    for (int i = 0; i < FAT32_MAX_OPEN_FILES; i++) {
+        fat32_file_t *f = &open_files[i];
+        if (f->in_use && (f->dirty_cluster || f->meta_dirty)) return 1;
+    }
+    return 0;
+}
+
+static int memory_low(void) {
+    return pmm_count_free_frames() < FAT32_LOWMEM_FRAMES;
+}
+
+static void flusher(void) {
+    for (;;) {
+        fat32_lock(&flusher_lock);
+        uint32_t ms = writeback_ms;
+        fat32_unlock(&flusher_lock);
+
+        /* Short of memory the interval is cut and handle caches are let go
+         * as well */
+        int low = memory_low();
+        if (ms) task_sleep(low ? ms / 4 : ms);
+
+        fat32_lock(&flusher_lock);
+        int more = writeback_ms && writeback_pending();
+        if (!more) flusher_running = 0;
+        fat32_unlock(&flusher_lock);
+        if (!more) break;
+
+        writeback_all(low);
+    }
+}
+
+/* Called whenever something was left dirty for the flusher. */
+void writeback_kick(void) {
+    fat32_lock(&flusher_lock);
+    if (writeback_ms && !flusher_running) {
+        flusher_running = 1;
+        if (task_create(flusher, "fatflush", PRIORITY_LOW) == 0)
+            flusher_running = 0;
+    }
+    fat32_unlock(&flusher_lock);
+}
+
+/* End of an operation that changed the FAT; volume lock held. */
+void meta_commit(fat32_volume_t *vol) {
+    fat32_lock(&flusher_lock);
+    uint32_t ms = writeback_ms;
+    fat32_unlock(&flusher_lock);
+
+    if (ms) {
+        writeback_kick();
+    } else {
+        sync_fat(vol);
+        blk_flush(vol->dev);
+    }
+}
+
+/* Write back every open file, then every volume's FAT. shrink also frees
+ * the cache buffers of the handles, which are simply refilled on demand. */
+static int writeback_all(int shrink) {
+    int rc = 0;
+
+    for (int i = 0; i < FAT32_MAX_OPEN_FILES; i++) {
+        fat32_file_t *file = &open_files[i];
+        if (!file->in_use || file_lock(file) != 0) continue;
+
+        fat32_volume_t *vol = volume_lock(file->drive);
+        if (vol) {
+            if (file_flush(vol, file) != 0) rc = -1;
+            if (shrink && !file->dirty_cluster && file->cache) {
+                kfree(file->cache);
+                file->cache = NULL;
+                file->cache_count = 0;
+                file->cache_cap = 0;
+            }
+            volume_unlock(vol);
+        }
+        file_unlock(file);
+    }
+
+    for (int i = 0; i < FAT32_MAX_VOLUMES; i++) {
+        if (!volumes[i].mounted) continue;
+        fat32_volume_t *vol = volume_lock(volumes[i].drive_letter);
+        if (!vol) continue;
+        if (sync_fat(vol) != 0) rc = -1;
+        if (blk_flush(vol->dev) != 0) rc = -1;
+        volume_unlock(vol);
+    }
+    return rc;
+}
+
+/* Make everything written so far durable. */
+int fat32_sync(void) {
+    return writeback_all(0);
+}
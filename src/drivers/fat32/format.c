@@ -0,0 +1,130 @@
+#include "private.h"
+#include "../../task/timer.h"
+
+#define FORMAT_RESERVED 32
+#define FORMAT_FATS     2
+
+/* Cluster size for a volume of the given size, after the table Microsoft
+ * uses for FAT32. */
+static uint32_t format_cluster_sectors(uint32_t sectors) {
+    if (sectors <= 532480) return 1;      /* up to 260MB: 512 bytes */
+    if (sectors <= 16777216) return 8;    /* up to 8GB: 4KB */
+    if (sectors <= 33554432) return 16;
+    if (sectors <= 67108864) return 32;
+    return 64;
+}
+
+/* Zero count sectors from lba, a buffer at a time. */
+static int format_zero(blkdev_t *dev, uint32_t lba, uint32_t count, uint8_t *zero, uint32_t zero_sectors) {
+    while (count > 0) {
+        uint32_t n = count < zero_sectors ? count : zero_sectors;
+        if (blk_write(dev, lba, n, zero) != 0) return -1;
+        lba += n;
+        count -= n;
+    }
+    return 0;
+}
+
+/* Lay out an empty FAT32 volume on sectors sectors of dev, starting at
+ * start_lba: boot sector and backup, FSInfo, two FATs and a root directory
+ * of one cluster. spc of 0 picks the cluster size from the volume size.
+ * The device must not be mounted. */
+int fat32_format(struct blkdev *dev, uint32_t start_lba, uint32_t sectors, uint32_t spc,
+                 const char *label) {
+    if (!dev) return -1;
+    if (spc == 0) spc = format_cluster_sectors(sectors);
+    if (spc > 128 || (spc & (spc - 1)) != 0) return -1;
+
+    fat32_acquire();
+    int busy = 0;
+    for (int i = 0; i < FAT32_MAX_VOLUMES; i++) {
+        if (volumes[i].mounted && volumes[i].dev == dev) busy = 1;
+    }
+    fat32_release();
+    if (busy) return -1;
+
+    /* Grow the FAT until it covers every cluster left after it */
+    uint32_t fat_size = 1;
+    uint32_t clusters = 0;
+    for (;;) {
+        if (sectors <= FORMAT_RESERVED + FORMAT_FATS * fat_size + spc) return -1;
+        clusters = (sectors - FORMAT_RESERVED - FORMAT_FATS * fat_size) / spc;
+        uint32_t need = ((clusters + 2) * 4 + BLK_SECTOR_SIZE - 1) / BLK_SECTOR_SIZE;
+        if (need <= fat_size) break;
+        fat_size = need;
+    }
+
+    uint32_t zero_sectors = FAT32_READAHEAD_MAX / BLK_SECTOR_SIZE;
+    uint8_t *zero = kmalloc(FAT32_READAHEAD_MAX);
+    uint8_t *sector = kmalloc(BLK_SECTOR_SIZE);
+    if (!zero || !sector) {
+        if (zero) kfree(zero);
+        if (sector) kfree(sector);
+        return -1;
+    }
+    memset_s(zero, 0, FAT32_READAHEAD_MAX);
+
+    int rc = 0;
+    uint32_t root_lba = start_lba + FORMAT_RESERVED + FORMAT_FATS * fat_size;
+    if (format_zero(dev, start_lba, FORMAT_RESERVED, zero, zero_sectors) != 0 ||
+        format_zero(dev, start_lba + FORMAT_RESERVED, FORMAT_FATS * fat_size, zero, zero_sectors) != 0 ||
+        format_zero(dev, root_lba, spc, zero, zero_sectors) != 0)
+        rc = -1;
+
+    memset_s(sector, 0, BLK_SECTOR_SIZE);
+    fat32_bpb_t *bpb = (fat32_bpb_t*)sector;
+    bpb->jump[0] = 0xEB;
+    bpb->jump[1] = 0x58;
+    bpb->jump[2] = 0x90;
+    memcpy_s(bpb->oem, "OSLET   ", 8);
+    bpb->bytes_per_sector = BLK_SECTOR_SIZE;
+    bpb->sectors_per_cluster = (uint8_t)spc;
+    bpb->reserved_sectors = FORMAT_RESERVED;
+    bpb->num_fats = FORMAT_FATS;
+    bpb->media_type = 0xF8;
+    bpb->sectors_per_track = 32;
+    bpb->num_heads = 64;
+    bpb->hidden_sectors = start_lba;
+    bpb->total_sectors_32 = sectors;
+    bpb->sectors_per_fat_32 = fat_size;
+    bpb->root_cluster = 2;
+    bpb->fsinfo_sector = 1;
+    bpb->backup_boot_sector = 6;
+    bpb->drive_number = 0x80;
+    bpb->boot_signature = 0x29;
+    bpb->volume_id = timer_get_ticks() * 2654435761u;
+    memset_s(bpb->volume_label, ' ', 11);
+    for (int i = 0; label && label[i] && i < 11; i++)
+        bpb->volume_label[i] = toupper_s(label[i]);
+    memcpy_s(bpb->fs_type, "FAT32   ", 8);
+    sector[510] = 0x55;
+    sector[511] = 0xAA;
+    if (blk_write(dev, start_lba, 1, sector) != 0 || blk_write(dev, start_lba + 6, 1, sector) != 0)
+        rc = -1;
+
+    memset_s(sector, 0, BLK_SECTOR_SIZE);
+    fat32_fsinfo_t *info = (fat32_fsinfo_t*)sector;
+    info->lead_sig = FSINFO_LEAD_SIG;
+    info->struct_sig = FSINFO_STRUCT_SIG;
+    info->free_count = clusters - 1;
+    info->next_free = 3;
+    info->trail_sig = 0xAA550000;
+    if (blk_write(dev, start_lba + 1, 1, sector) != 0 || blk_write(dev, start_lba + 7, 1, sector) != 0)
+        rc = -1;
+
+    /* Media descriptor, end-of-chain marker and the root directory */
+    memset_s(sector, 0, BLK_SECTOR_SIZE);
+    uint32_t *fat = (uint32_t*)sector;
+    fat[0] = 0x0FFFFFF8;
+    fat[1] = 0x0FFFFFFF;
+    fat[2] = 0x0FFFFFFF;
+    for (uint32_t i = 0; i < FORMAT_FATS; i++) {
+        if (blk_write(dev, start_lba + FORMAT_RESERVED + i * fat_size, 1, sector) != 0)
+            rc = -1;
+    }
+
+    if (rc == 0) rc = blk_flush(dev);
+    kfree(sector);
+    kfree(zero);
+    return rc;
+}
@@ -3,12 +3,20 @@
 void fat32_init(void) {
     memset_s(volumes, 0, sizeof(volumes));
     memset_s(open_files, 0, sizeof(open_files));
+    memset_s(open_dirs, 0, sizeof(open_dirs));
     memset_s(fat_dirty, 0, sizeof(fat_dirty));
     for (int i = 0; i < FAT32_MAX_VOLUMES; i++) last_alloc[i] = 2;
+    dcache_reset();
+    writeback_reset();
 }
 
 int fat32_mount_drive(uint8_t drive_letter, uint32_t start_lba) {
-    drive_letter = toupper_s(drive_letter);
+    return fat32_mount_device(drive_letter, blk_boot_device(), start_lba);
+}
+
+/* Mounting only holds the table lock: until mounted is set nobody else
+ * looks inside the slot. */
+static int fat32_mount_unlocked(uint8_t drive_letter, blkdev_t *dev, uint32_t start_lba) {
     fat32_volume_t *vol = NULL;
     
     for (int i = 0; i < FAT32_MAX_VOLUMES; i++) {
@@ -22,14 +30,16 @@ int fat32_mount_drive(uint8_t drive_letter, uint32_t start_lba) {
     uint8_t *sector = kmalloc(512);
     if (!sector) return -1;
     
-    if (ata_read_sectors(start_lba, 1, sector) != 0) {
+    if (blk_read(dev, start_lba, 1, sector) != 0) {
         kfree(sector);
         return -1;
     }
     
     fat32_bpb_t *bpb = (fat32_bpb_t*)sector;
     
+    dcache_drop_volume(drive_letter);
     vol->drive_letter = drive_letter;
+    vol->dev = dev;
     vol->bytes_per_sector = bpb->bytes_per_sector;
     vol->sectors_per_cluster = bpb->sectors_per_cluster;
     vol->num_fats = bpb->num_fats;
@@ -40,49 +50,107 @@ int fat32_mount_drive(uint8_t drive_letter, uint32_t start_lba) {
     uint32_t root_dir_sectors = ((bpb->root_entries * 32) + (vol->bytes_per_sector - 1)) / vol->bytes_per_sector;
     vol->first_data_sector = vol->first_fat_sector + (vol->num_fats * vol->sectors_per_fat) + root_dir_sectors;
     
-    kfree(sector);
+    uint32_t total_sectors = bpb->total_sectors_16 ? bpb->total_sectors_16 : bpb->total_sectors_32;
+    uint32_t data_sectors = total_sectors > vol->first_data_sector - start_lba
+                            ? total_sectors - (vol->first_data_sector - start_lba) : 0;
+    vol->cluster_count = vol->sectors_per_cluster ? data_sectors / vol->sectors_per_cluster : 0;
+    uint16_t fsinfo_sector = bpb->fsinfo_sector;
     
-    if (vol->sectors_per_fat == 0 || vol->bytes_per_sector == 0) return -1;
+    if (vol->sectors_per_fat == 0 || vol->bytes_per_sector == 0) {
+        kfree(sector);
+        return -1;
+    }
     
     vol->fat_cache_size = vol->sectors_per_fat * vol->bytes_per_sector;
     vol->fat_cache = kmalloc(vol->fat_cache_size);
-    if (!vol->fat_cache) return -1;
+    if (!vol->fat_cache) {
+        kfree(sector);
+        return -1;
+    }
     
-    for (uint32_t i = 0; i < vol->sectors_per_fat; i++) {
-        if (ata_read_sectors(vol->first_fat_sector + i, 1, vol->fat_cache + i * vol->bytes_per_sector) != 0) {
-            kfree(vol->fat_cache);
-            vol->fat_cache = NULL;
-            return -1;
-        }
+    if (blk_read(dev, vol->first_fat_sector, vol->sectors_per_fat, vol->fat_cache) != 0) {
+        kfree(vol->fat_cache);
+        vol->fat_cache = NULL;
+        kfree(sector);
+        return -1;
     }
     
+    /* Without the map sync_fat falls back to writing the whole FAT */
+    uint32_t map_bytes = (vol->sectors_per_fat + 31) / 32 * 4;
+    vol->fat_dirty_map = kmalloc(map_bytes);
+    if (vol->fat_dirty_map) memset_s(vol->fat_dirty_map, 0, map_bytes);
+    
     int idx = volume_index(vol);
     if (idx >= 0) {
         fat_dirty[idx] = 0;
         last_alloc[idx] = 2;
     }
     
+    /* FSInfo only offers hints; anything implausible is ignored */
+    uint32_t hint_free = FSINFO_UNKNOWN, hint_next = FSINFO_UNKNOWN;
+    vol->fsinfo_lba = 0;
+    if (fsinfo_sector != 0 && fsinfo_sector != 0xFFFF &&
+        blk_read(dev, start_lba + fsinfo_sector, 1, sector) == 0) {
+        fat32_fsinfo_t *info = (fat32_fsinfo_t*)sector;
+        if (info->lead_sig == FSINFO_LEAD_SIG && info->struct_sig == FSINFO_STRUCT_SIG) {
+            vol->fsinfo_lba = start_lba + fsinfo_sector;
+            hint_free = info->free_count;
+            hint_next = info->next_free;
+        }
+    }
+    kfree(sector);
+    
+    if (build_free_map(vol, hint_free, hint_next) != 0) {
+        kfree(vol->fat_cache);
+        vol->fat_cache = NULL;
+        if (vol->fat_dirty_map) kfree(vol->fat_dirty_map);
+        vol->fat_dirty_map = NULL;
+        return -1;
+    }
+    
     vol->mounted = 1;
     return 0;
 }
 
+int fat32_mount_device(uint8_t drive_letter, blkdev_t *dev, uint32_t start_lba) {
+    if (!dev) return -1;
+    fat32_acquire();
+    int ret = fat32_mount_unlocked(toupper_s(drive_letter), dev, start_lba);
+    fat32_release();
+    return ret;
+}
+
 int fat32_unmount_drive(uint8_t drive_letter) {
-    fat32_volume_t *vol = get_volume(toupper_s(drive_letter));
+    fat32_volume_t *vol = volume_lock(toupper_s(drive_letter));
     if (!vol) return -1;
     
     sync_fat(vol);
+    blk_flush(vol->dev);
+    scrub_forget(vol->drive_letter);
+    dcache_drop_volume(vol->drive_letter);
     
     if (vol->fat_cache) {
         kfree(vol->fat_cache);
         vol->fat_cache = NULL;
     }
+    if (vol->fat_dirty_map) {
+        kfree(vol->fat_dirty_map);
+        vol->fat_dirty_map = NULL;
+    }
+    if (vol->free_map) {
+        kfree(vol->free_map);
+        vol->free_map = NULL;
+    }
     
+    fat32_acquire();
     vol->mounted = 0;
+    fat32_release();
     int idx = volume_index(vol);
     if (idx >= 0) {
         fat_dirty[idx] = 0;
         last_alloc[idx] = 2;
     }
+    volume_unlock(vol);
     return 0;
 }
 static int is_valid_fat32_bpb(const uint8_t *sector) {
@@ -111,6 +179,9 @@ static int is_valid_fat32_bpb(const uint8_t *sector) {
 int find_fat32_partition(uint32_t *out_start_lba) {
     if (!out_start_lba) return -1;
 
+    blkdev_t *dev = blk_boot_device();
+    if (!dev) return -1;
+
     uint8_t *sector = kmalloc(512);
     if (!sector) return -1;
 
@@ -123,7 +194,7 @@ int find_fat32_partition(uint32_t *out_start_lba) {
     }
 
     // Try reading the MBR/boot sector
-    if (ata_read_sectors(0, 1, sector) != 0) {
+    if (blk_read(dev, 0, 1, sector) != 0) {
         kfree(sector);
         return -1;
     }
@@ -147,7 +218,7 @@ int find_fat32_partition(uint32_t *out_start_lba) {
         uint32_t p_sectors = parts[idx].sectors_total;
         
         if (p_lba != 0 && p_sectors != 0) {
-            if (ata_read_sectors(p_lba, 1, sector) == 0) {
+            if (blk_read(dev, p_lba, 1, sector) == 0) {
                 if (is_valid_fat32_bpb(sector)) {
                     *out_start_lba = p_lba;
                     kfree(sector);
@@ -164,7 +235,7 @@ int find_fat32_partition(uint32_t *out_start_lba) {
         if (p_lba == 0 || p_sectors == 0)
             continue;
 
-        if (ata_read_sectors(p_lba, 1, sector) != 0)
+        if (blk_read(dev, p_lba, 1, sector) != 0)
             continue;
 
         if (is_valid_fat32_bpb(sector)) {
@@ -178,6 +249,17 @@ int find_fat32_partition(uint32_t *out_start_lba) {
     return -1;
 }
 
+int fat32_statfs(uint8_t drive_letter, uint32_t *total_clusters, uint32_t *free_clusters,
+                 uint32_t *cluster_bytes) {
+    fat32_volume_t *vol = volume_lock(toupper_s(drive_letter));
+    if (!vol) return -1;
+    if (total_clusters) *total_clusters = vol->cluster_count;
+    if (free_clusters) *free_clusters = vol->free_count;
+    if (cluster_bytes) *cluster_bytes = vol->sectors_per_cluster * vol->bytes_per_sector;
+    volume_unlock(vol);
+    return 0;
+}
+
 int fat32_mount_auto(uint8_t drive_letter) {
     uint32_t start_lba;
     if (find_fat32_partition(&start_lba) != 0) {
@@ -3,6 +3,7 @@
 int parse_path(const char *path, uint8_t *drive, char *rest, size_t rest_size) {
     if (!path || !drive || !rest) return -1;
     
+    fat32_acquire();
     *drive = current_dir[0];
     
     if (path[0] && path[1] == ':') {
@@ -34,10 +35,18 @@ int parse_path(const char *path, uint8_t *drive, char *rest, size_t rest_size) {
         if (path[0] == '/') path++;
         strcpy_s(rest, path, rest_size);
     }
+    fat32_release();
     
     return 0;
 }
 
+/* Resolve path and lock the volume it names; NULL if it is not mounted. */
+fat32_volume_t* lock_path(const char *path, char *rest, size_t rest_size) {
+    uint8_t drive;
+    if (parse_path(path, &drive, rest, rest_size) != 0) return NULL;
+    return volume_lock(drive);
+}
+
 int navigate_path(fat32_volume_t *vol, const char *path, uint32_t *out_dir_cluster, char *out_filename) {
     *out_dir_cluster = vol->root_cluster;
 
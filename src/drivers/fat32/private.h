@@ -2,6 +2,7 @@
 
 #include "../fat32.h"
 #include "../ata.h"
+#include "../blkdev.h"
 #include "../../console.h"
 #include "../../mem/heap.h"
 #include "../../rtc.h"
@@ -10,6 +11,15 @@
 #define FAT32_EOC 0x0FFFFFF8
 #define FAT32_BAD 0x0FFFFFF7
 
+#define FSINFO_LEAD_SIG   0x41615252
+#define FSINFO_STRUCT_SIG 0x61417272
+#define FSINFO_UNKNOWN    0xFFFFFFFF
+
+#define FAT32_READAHEAD_MAX 65536  /* bytes; one full block layer transfer */
+#define FAT32_SCRUB_QUEUE   64     /* freed runs waiting for the scrubber */
+#define FAT32_WRITEBACK_MS  5000   /* flusher interval; 0 writes through */
+#define FAT32_LOWMEM_FRAMES 256    /* free pages below which the flusher hurries */
+
 typedef struct {
     uint8_t jump[3];
     char oem[8];
@@ -75,16 +85,33 @@ typedef struct {
     uint32_t sectors_total;
 } __attribute__((packed)) mbr_partition_t;
 
+typedef struct {
+    uint32_t lead_sig;
+    uint8_t reserved1[480];
+    uint32_t struct_sig;
+    uint32_t free_count;
+    uint32_t next_free;
+    uint8_t reserved2[12];
+    uint32_t trail_sig;
+} __attribute__((packed)) fat32_fsinfo_t;
+
 extern fat32_volume_t volumes[FAT32_MAX_VOLUMES];
 extern fat32_file_t open_files[FAT32_MAX_OPEN_FILES];
+extern fat32_dir_t open_dirs[FAT32_MAX_OPEN_DIRS];
 extern char current_dir[FAT32_MAX_PATH];
 extern uint8_t fat_dirty[FAT32_MAX_VOLUMES];
 extern uint32_t last_alloc[FAT32_MAX_VOLUMES];
 extern uint32_t boot_device;
 
+void fat32_lock(fat32_lock_t *lock);
+void fat32_unlock(fat32_lock_t *lock);
 void fat32_acquire(void);
 void fat32_release(void);
 fat32_volume_t* get_volume(uint8_t drive);
+fat32_volume_t* volume_lock(uint8_t drive);
+void volume_unlock(fat32_volume_t *vol);
+int file_lock(fat32_file_t *file);
+void file_unlock(fat32_file_t *file);
 int volume_index(fat32_volume_t *vol);
 
 uint16_t rtc_to_fat_time(const rtc_time_t *rtc);
@@ -95,14 +122,50 @@ void utf16_to_ascii(const uint16_t *src, char *dst, int max_chars);
 void ascii_to_utf16(const char *src, uint16_t *dst, int max_chars);
 int parse_path(const char *path, uint8_t *drive, char *rest, size_t rest_size);
 void parse_filename(const char *name, char *out_name);
+fat32_volume_t* lock_path(const char *path, char *rest, size_t rest_size);
 
+uint32_t cluster_to_lba(fat32_volume_t *vol, uint32_t cluster);
+int cluster_is_free(fat32_volume_t *vol, uint32_t cluster);
 uint32_t get_next_cluster(fat32_volume_t *vol, uint32_t cluster);
 void set_next_cluster(fat32_volume_t *vol, uint32_t cluster, uint32_t value);
 uint32_t alloc_cluster(fat32_volume_t *vol);
+uint32_t alloc_cluster_near(fat32_volume_t *vol, uint32_t prev, uint32_t want);
+uint32_t alloc_cluster_run(fat32_volume_t *vol, uint32_t prev, uint32_t count);
+int build_free_map(fat32_volume_t *vol, uint32_t hint_free, uint32_t hint_next);
 void free_cluster_chain(fat32_volume_t *vol, uint32_t start);
 int sync_fat(fat32_volume_t *vol);
 int read_cluster(fat32_volume_t *vol, uint32_t cluster, void *buffer);
+int read_clusters(fat32_volume_t *vol, uint32_t cluster, uint32_t count, void *buffer);
+int read_data_clusters(fat32_volume_t *vol, uint32_t cluster, uint32_t count, void *buffer);
+uint32_t cluster_run(fat32_volume_t *vol, uint32_t cluster, uint32_t max);
 int write_cluster(fat32_volume_t *vol, uint32_t cluster, const void *buffer);
+int write_clusters(fat32_volume_t *vol, uint32_t cluster, uint32_t count, const void *buffer);
+void drop_cached_cluster(fat32_volume_t *vol, uint32_t cluster, const void *keep);
+int file_writeback(fat32_volume_t *vol, fat32_file_t *file);
+int file_flush(fat32_volume_t *vol, fat32_file_t *file);
+
+void writeback_reset(void);
+void writeback_kick(void);
+void meta_commit(fat32_volume_t *vol);
+
+void scrub_queue(fat32_volume_t *vol, uint32_t start, uint32_t count);
+void scrub_forget(uint8_t drive_letter);
+
+void dcache_reset(void);
+int dcache_lookup(fat32_volume_t *vol, uint32_t parent, const char *name,
+                  fat32_direntry_t *out, uint32_t *out_cluster, uint32_t *out_offset);
+void dcache_insert(fat32_volume_t *vol, uint32_t parent, const char *name,
+                   const fat32_direntry_t *entry, uint32_t cluster, uint32_t offset);
+void dcache_drop_location(fat32_volume_t *vol, uint32_t cluster, uint32_t offset);
+void dcache_drop_negative(fat32_volume_t *vol, uint32_t parent);
+void dcache_drop_dir(fat32_volume_t *vol, uint32_t parent);
+void dcache_drop_volume(uint8_t drive_letter);
+void dcache_lock_stats(fat32_lock_count_t *out);
+
+void extent_reset(fat32_file_t *file);
+void extent_free(fat32_file_t *file);
+void drop_extent_maps(fat32_volume_t *vol);
+uint32_t extent_lookup(fat32_volume_t *vol, fat32_file_t *file, uint32_t index, uint32_t *chain_len);
 
 int find_in_dir(fat32_volume_t *vol, uint32_t dir_cluster, const char *name,
                 fat32_direntry_t *out, uint32_t *out_cluster, uint32_t *out_offset);
@@ -0,0 +1,152 @@
+#include "private.h"
+
+/* Optional zeroing of freed clusters. Deleting a file only updates the FAT;
+ * with scrubbing enabled the freed runs are queued here and an idle
+ * priority task overwrites them when nothing else wants the disk. The queue
+ * is best effort: runs that do not fit are simply left as they are. */
+
+typedef struct {
+    uint8_t drive;
+    uint32_t start;
+    uint32_t count;
+} scrub_run_t;
+
+static scrub_run_t scrub_runs[FAT32_SCRUB_QUEUE];
+static int scrub_len = 0;
+static int scrub_enabled = 0;
+static int scrub_running = 0;
+static fat32_lock_t scrub_lock;  /* the queue; taken after any volume lock */
+
+void fat32_set_scrub(int enable) {
+    fat32_lock(&scrub_lock);
+    scrub_enabled = enable ? 1 : 0;
+    if (!scrub_enabled) scrub_len = 0;
+    fat32_unlock(&scrub_lock);
+}
+
+static void scrub_forget_unlocked(uint8_t drive_letter) {
+    int j = 0;
+    for (int i = 0; i < scrub_len; i++) {
+        if (scrub_runs[i].drive != drive_letter)
+            scrub_runs[j++] = scrub_runs[i];
+    }
+    scrub_len = j;
+}
+
+void scrub_forget(uint8_t drive_letter) {
+    fat32_lock(&scrub_lock);
+    scrub_forget_unlocked(drive_letter);
+    fat32_unlock(&scrub_lock);
+}
+
+/* Take up to max clusters off the front of the queue that are still free,
+ * and hide them from the allocator while they are being written. Only runs
+ * for vol are looked at; its lock and the queue lock are held. */
+static uint32_t scrub_reserve(fat32_volume_t *vol, uint32_t max, uint32_t *out_start) {
+    while (scrub_len > 0 && scrub_runs[0].drive == vol->drive_letter) {
+        scrub_run_t *run = &scrub_runs[0];
+        uint32_t start = run->start;
+        uint32_t n = 0;
+
+        while (start < run->start + run->count && !cluster_is_free(vol, start))
+            start++;
+        while (n < max && start + n < run->start + run->count && cluster_is_free(vol, start + n))
+            n++;
+
+        if (n == 0) {
+            for (int i = 1; i < scrub_len; i++)
+                scrub_runs[i - 1] = scrub_runs[i];
+            scrub_len--;
+            continue;
+        }
+
+        run->count -= (start + n) - run->start;
+        run->start = start + n;
+
+        for (uint32_t c = start; c < start + n; c++)
+            vol->free_map[c >> 5] &= ~(1u << (c & 31));
+        *out_start = start;
+        return n;
+    }
+    return 0;
+}
+
+static void scrub_worker(void) {
+    uint8_t *zero = kmalloc(FAT32_READAHEAD_MAX);
+
+    for (;;) {
+        fat32_lock(&scrub_lock);
+        int more = zero && scrub_enabled && scrub_len > 0;
+        uint8_t drive = more ? scrub_runs[0].drive : 0;
+        if (!more) {
+            scrub_len = 0;
+            scrub_running = 0;
+        }
+        fat32_unlock(&scrub_lock);
+        if (!more) break;
+
+        fat32_volume_t *vol = volume_lock(drive);
+        fat32_lock(&scrub_lock);
+        if (!vol) {
+            scrub_forget_unlocked(drive);
+            fat32_unlock(&scrub_lock);
+            continue;
+        }
+        uint32_t cluster_size = vol->sectors_per_cluster * vol->bytes_per_sector;
+        uint32_t max = FAT32_READAHEAD_MAX / cluster_size;
+        if (max == 0) max = 1;
+        uint32_t start = 0;
+        uint32_t n = scrub_reserve(vol, max, &start);
+        fat32_unlock(&scrub_lock);
+        volume_unlock(vol);
+        if (n == 0) continue;
+
+        /* The clusters are invisible to the allocator, so no lock is
+         * needed while the write is in flight. */
+        memset_s(zero, 0, n * cluster_size);
+        blk_write_prio(vol->dev, cluster_to_lba(vol, start), n * vol->sectors_per_cluster,
+                       zero, BLK_PRIO_IDLE);
+
+        vol = volume_lock(drive);
+        if (vol) {
+            if (vol->free_map) {
+                for (uint32_t c = start; c < start + n; c++) {
+                    if (get_next_cluster(vol, c) == 0)
+                        vol->free_map[c >> 5] |= 1u << (c & 31);
+                }
+            }
+            volume_unlock(vol);
+        }
+    }
+
+    if (zero) kfree(zero);
+}
+
+/* Called with the volume lock held, for each run a chain was freed in. */
+void scrub_queue(fat32_volume_t *vol, uint32_t start, uint32_t count) {
+    fat32_lock(&scrub_lock);
+    if (!scrub_enabled) {
+        fat32_unlock(&scrub_lock);
+        return;
+    }
+
+    scrub_run_t *last = scrub_len > 0 ? &scrub_runs[scrub_len - 1] : NULL;
+    if (last && last->drive == vol->drive_letter && last->start + last->count == start) {
+        last->count += count;
+    } else if (scrub_len < FAT32_SCRUB_QUEUE) {
+        scrub_runs[scrub_len].drive = vol->drive_letter;
+        scrub_runs[scrub_len].start = start;
+        scrub_runs[scrub_len].count = count;
+        scrub_len++;
+    } else {
+        fat32_unlock(&scrub_lock);
+        return;
+    }
+
+    if (!scrub_running) {
+        scrub_running = 1;
+        if (task_create(scrub_worker, "fatscrub", PRIORITY_IDLE) == 0)
+            scrub_running = 0;
+    }
+    fat32_unlock(&scrub_lock);
+}
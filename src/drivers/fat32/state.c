@@ -1,20 +1,43 @@
 #include "private.h"
 
+/* Locking: a handle's lock is taken first, then the lock of the volume it
+ * lives on, then the table lock. The table lock covers the open file and
+ * directory tables, the mount table and the current directory, and is
+ * never held while waiting for another lock; mounting only ever takes the
+ * table lock. The dcache, the scrub queue and the flusher have their own
+ * locks, taken last of all. */
+
 fat32_volume_t volumes[FAT32_MAX_VOLUMES];
 fat32_file_t open_files[FAT32_MAX_OPEN_FILES];
+fat32_dir_t open_dirs[FAT32_MAX_OPEN_DIRS];
 char current_dir[FAT32_MAX_PATH] = "C:/";
-static volatile int fat32_lock = 0;
+static fat32_lock_t table_lock;
 uint8_t fat_dirty[FAT32_MAX_VOLUMES];
 uint32_t last_alloc[FAT32_MAX_VOLUMES];
 
-void fat32_acquire(void) {
-    while (__sync_lock_test_and_set(&fat32_lock, 1)) {
+void fat32_lock(fat32_lock_t *lock) {
+    uint32_t waits = 0;
+    while (__sync_lock_test_and_set(&lock->held, 1)) {
+        waits++;
         task_yield();
     }
+    lock->acquired++;
+    if (waits) {
+        lock->contended++;
+        lock->waits += waits;
+    }
+}
+
+void fat32_unlock(fat32_lock_t *lock) {
+    __sync_lock_release(&lock->held);
+}
+
+void fat32_acquire(void) {
+    fat32_lock(&table_lock);
 }
 
 void fat32_release(void) {
-    __sync_lock_release(&fat32_lock);
+    fat32_unlock(&table_lock);
 }
 
 fat32_volume_t* get_volume(uint8_t drive) {
@@ -25,8 +48,60 @@ fat32_volume_t* get_volume(uint8_t drive) {
     return NULL;
 }
 
+/* Find a mounted volume and lock it. The volume may be unmounted while we
+ * wait, so it is looked at again once the lock is ours. */
+fat32_volume_t* volume_lock(uint8_t drive) {
+    fat32_volume_t *vol = get_volume(drive);
+    if (!vol) return NULL;
+
+    fat32_lock(&vol->lock);
+    if (!vol->mounted || vol->drive_letter != drive) {
+        fat32_unlock(&vol->lock);
+        return NULL;
+    }
+    return vol;
+}
+
+void volume_unlock(fat32_volume_t *vol) {
+    fat32_unlock(&vol->lock);
+}
+
+/* Lock a handle that is still open. */
+int file_lock(fat32_file_t *file) {
+    fat32_lock(&file->lock);
+    if (!file->in_use) {
+        fat32_unlock(&file->lock);
+        return -1;
+    }
+    return 0;
+}
+
+void file_unlock(fat32_file_t *file) {
+    fat32_unlock(&file->lock);
+}
+
 int volume_index(fat32_volume_t *vol) {
     ptrdiff_t idx = vol - volumes;
     if (idx < 0 || idx >= FAT32_MAX_VOLUMES) return -1;
     return (int)idx;
 }
+
+static void lock_count_add(fat32_lock_count_t *out, const fat32_lock_t *lock) {
+    out->acquired += lock->acquired;
+    out->contended += lock->contended;
+    out->waits += lock->waits;
+}
+
+void fat32_lock_stats(fat32_lock_stats_t *out) {
+    if (!out) return;
+    memset_s(out, 0, sizeof(*out));
+
+    lock_count_add(&out->table, &table_lock);
+    dcache_lock_stats(&out->dcache);
+    for (int i = 0; i < FAT32_MAX_OPEN_FILES; i++)
+        lock_count_add(&out->files, &open_files[i].lock);
+    for (int i = 0; i < FAT32_MAX_VOLUMES; i++) {
+        lock_count_add(&out->volume[i], &volumes[i].lock);
+        out->volume_drive[i] = volumes[i].mounted ? volumes[i].drive_letter : 0;
+    }
+}
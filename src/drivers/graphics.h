@@ -7,6 +7,8 @@
 #define GFX_PLANES      4
 #define GFX_BUFFER_SIZE ((GFX_WIDTH * GFX_HEIGHT) / 2)  /* 153600 bytes - 2 pixels per byte */
 #define GFX_VRAM        ((uint8_t*)0xA0000)
+#define GFX_CLIP_DEPTH  16
+#define GFX_BGA_BPP     32  /* Bochs/QEMU linear framebuffer depth: 8, 16 or 32; 0 for planar VGA only */
 
 #define COLOR_BLACK         0x00
 #define COLOR_BLUE          0x01
@@ -75,6 +77,49 @@ uint8_t* gfx_get_backbuffer(void);
 
 void gfx_putpixel(int x, int y, uint8_t color);
 uint8_t gfx_getpixel(int x, int y);
+void gfx_mark_dirty(int x, int y, int w, int h);
+
+/* Clip rectangle honoured by every drawing call. Push intersects it with
+ * the given rectangle (-1 if the stack is full); pop restores the
+ * previous one. */
+int gfx_push_clip(int x, int y, int w, int h);
+void gfx_pop_clip(void);
+void gfx_reset_clip(void);
+void gfx_get_clip(int *x, int *y, int *w, int *h);
+int gfx_clip_visible(int x, int y, int w, int h);
+
+/* Exclusive use of the drawing state across yields; nests per task */
+void gfx_acquire(void);
+void gfx_release(void);
+void gfx_seize(void);
+
+/* Offscreen packed 4bpp surfaces. Between begin and end every drawing
+ * call lands in the surface instead of the backbuffer, at screen
+ * coordinates inside (x, y, w, h); byte 0 holds pixel (x & ~1, y), so
+ * pitch must be at least ((x & 1) + w + 1) / 2. Blit copies the screen
+ * area (x, y, w, h) back from a surface whose byte 0 sits at (ox, oy). */
+int gfx_begin_surface(uint8_t *pixels, int pitch, int x, int y, int w, int h);
+void gfx_end_surface(void);
+void gfx_blit_surface(const uint8_t *pixels, int pitch, int ox, int oy,
+                      int x, int y, int w, int h);
+
+/* The screen area (x, y, w, h) was just redrawn to show what was on
+ * screen at (sx, sy) before, e.g. a moved window. On planar VGA the next
+ * swap can then copy it inside video memory; x - sx must be a multiple
+ * of 8 for that. Only a hint: nothing breaks if it is wrong. */
+void gfx_hint_copy(int x, int y, int w, int h, int sx, int sy);
+
+/* Mouse pointer overlay, merged in at swap time and never drawn into the
+ * backbuffer. The image is one byte per pixel, up to 32x32; 0xFF is
+ * transparent. */
+int gfx_set_cursor_image(const uint8_t *pixels, int w, int h);
+void gfx_show_cursor(int x, int y);
+void gfx_hide_cursor(void);
+
+/* 1bpp mask, MSB first, pitch bytes per row. bg 0xFF leaves clear bits
+ * transparent. Does not mark the area dirty. */
+void gfx_draw_mask(int x, int y, const uint8_t *mask, int width, int height, int pitch,
+                   uint8_t fg, uint8_t bg);
 void gfx_line(int x0, int y0, int x1, int y1, uint8_t color);
 void gfx_rect(int x, int y, int w, int h, uint8_t color);
 void gfx_fillrect(int x, int y, int w, int h, uint8_t color);
@@ -99,6 +144,12 @@ uint8_t* gfx_load_bmp_to_buffer(const char *path, int *out_width, int *out_heigh
 void gfx_draw_cached_bmp(uint8_t *cached_data, int width, int height, int dest_x, int dest_y);
 void gfx_draw_cached_bmp_ex(uint8_t *cached_data, int width, int height, int dest_x, int dest_y, int transparent);
 
+/* Like gfx_draw_cached_bmp_ex, for a bitmap that lives across swaps: VGA
+ * may keep a copy in spare video memory and redraw it from there. Its
+ * owner must call gfx_forget_bmp before freeing it. */
+void gfx_draw_kept_bmp(uint8_t *cached_data, int width, int height, int dest_x, int dest_y, int transparent);
+void gfx_forget_bmp(const uint8_t *data);
+
 /* Draw a portion (src_x,src_y,src_w,src_h) of the cached bitmap to (dest_x,dest_y) */
 void gfx_draw_cached_bmp_region(uint8_t *cached_data, int width, int height,
                                 int dest_x, int dest_y,
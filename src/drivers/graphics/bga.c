@@ -0,0 +1,189 @@
+#include "gpriv.h"
+#include "bga.h"
+#include "../../lib/string.h"
+#include "../../mem/paging.h"
+
+/* Bochs display interface (QEMU -vga std, Bochs, VirtualBox). The screen
+ * keeps its size, but is scanned out of a packed linear framebuffer, so a
+ * present converts dirty spans of the 4bpp backbuffer with a table lookup
+ * instead of splitting them into planes behind sequencer port writes. */
+
+#define PCI_CONFIG_ADDR 0xCF8
+#define PCI_CONFIG_DATA 0xCFC
+
+#define BGA_INDEX 0x01CE
+#define BGA_DATA  0x01CF
+
+#define BGA_REG_ID     0
+#define BGA_REG_XRES   1
+#define BGA_REG_YRES   2
+#define BGA_REG_BPP    3
+#define BGA_REG_ENABLE 4
+
+#define BGA_ID_MIN     0xB0C2  /* first version with a linear framebuffer */
+#define BGA_ID_MAX     0xB0C5
+#define BGA_ENABLED    0x01
+#define BGA_LFB        0x40
+
+static uint8_t *lfb = NULL;
+static uint32_t lfb_pitch;
+static int bga_active = 0;
+
+/* Two pixels for every backbuffer byte, in the framebuffer format. At
+ * 8bpp and 16bpp both fit in pair[b][0]. */
+static uint32_t pair[256][2];
+
+static void bga_write(uint16_t reg, uint16_t value) {
+    outw(BGA_INDEX, reg);
+    outw(BGA_DATA, value);
+}
+
+static uint16_t bga_read(uint16_t reg) {
+    outw(BGA_INDEX, reg);
+    return inw(BGA_DATA);
+}
+
+static uint32_t pci_read32(uint8_t bus, uint8_t dev, uint8_t fn, uint8_t reg) {
+    outl(PCI_CONFIG_ADDR, 0x80000000u | ((uint32_t)bus << 16) | ((uint32_t)dev << 11) |
+                          ((uint32_t)fn << 8) | (reg & 0xFC));
+    return inl(PCI_CONFIG_DATA);
+}
+
+/* The framebuffer is BAR0 of the display adapter. */
+static uint32_t find_lfb(void) {
+    for (uint16_t bus = 0; bus < 256; bus++) {
+        for (uint8_t dev = 0; dev < 32; dev++) {
+            for (uint8_t fn = 0; fn < 8; fn++) {
+                uint32_t id = pci_read32((uint8_t)bus, dev, fn, 0x00);
+                if (id == 0xFFFFFFFFu) {
+                    if (fn == 0) break;
+                    continue;
+                }
+                if (id != 0x11111234u && id != 0xBEEF80EEu) continue;
+                uint32_t bar0 = pci_read32((uint8_t)bus, dev, fn, 0x10);
+                if (bar0 & 0x1) continue;
+                return bar0 & 0xFFFFFFF0u;
+            }
+        }
+    }
+    return 0;
+}
+
+static int map_lfb(uint32_t base, uint32_t bytes) {
+    uint32_t start = base & 0xFFFFF000u;
+    uint32_t end = (base + bytes + 0xFFFu) & 0xFFFFF000u;
+
+    for (uint32_t addr = start; addr < end; addr += PAGE_SIZE) {
+        if (!paging_is_mapped(addr) &&
+            paging_map_page(addr, addr, P_PRESENT | P_RW) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void bga_load_palette(const uint8_t palette[16][3]) {
+    uint32_t color[16];
+
+    for (int i = 0; i < 16; i++) {
+        uint32_t r = palette[i][0], g = palette[i][1], b = palette[i][2];
+        if (GFX_BGA_BPP == 8) color[i] = (uint32_t)i;
+        else if (GFX_BGA_BPP == 16) color[i] = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+        else color[i] = (r << 16) | (g << 8) | b;
+    }
+
+    for (int b = 0; b < 256; b++) {
+        uint32_t left = color[b >> 4], right = color[b & 0x0F];
+        if (GFX_BGA_BPP == 8) {
+            pair[b][0] = left | (right << 8);
+        } else if (GFX_BGA_BPP == 16) {
+            pair[b][0] = left | (right << 16);
+        } else {
+            pair[b][0] = left;
+            pair[b][1] = right;
+        }
+    }
+}
+
+/* Switch to a GFX_WIDTH x GFX_HEIGHT linear mode. Returns -1, with the
+ * adapter untouched, when there is no usable one and planar VGA has to
+ * be used instead. */
+int bga_enter(void) {
+    if (GFX_BGA_BPP != 8 && GFX_BGA_BPP != 16 && GFX_BGA_BPP != 32) return -1;
+
+    uint16_t id = bga_read(BGA_REG_ID);
+    if (id < BGA_ID_MIN || id > BGA_ID_MAX) return -1;
+
+    if (!lfb) {
+        uint32_t base = find_lfb();
+        if (!base || map_lfb(base, GFX_WIDTH * GFX_HEIGHT * (GFX_BGA_BPP / 8)) != 0)
+            return -1;
+        lfb = (uint8_t*)base;
+    }
+
+    bga_write(BGA_REG_ENABLE, 0);
+    bga_write(BGA_REG_XRES, GFX_WIDTH);
+    bga_write(BGA_REG_YRES, GFX_HEIGHT);
+    bga_write(BGA_REG_BPP, GFX_BGA_BPP);
+    bga_write(BGA_REG_ENABLE, BGA_ENABLED | BGA_LFB);
+
+    if (bga_read(BGA_REG_XRES) != GFX_WIDTH || bga_read(BGA_REG_YRES) != GFX_HEIGHT ||
+        bga_read(BGA_REG_BPP) != GFX_BGA_BPP) {
+        bga_write(BGA_REG_ENABLE, 0);
+        return -1;
+    }
+
+    lfb_pitch = GFX_WIDTH * (GFX_BGA_BPP / 8);
+    bga_load_palette(gfx_palette);
+    bga_active = 1;
+    return 0;
+}
+
+void bga_exit(void) {
+    if (!bga_active) return;
+    bga_write(BGA_REG_ENABLE, 0);
+    bga_active = 0;
+}
+
+int bga_is_active(void) {
+    return bga_active;
+}
+
+/* Palette changes only show up after the screen is converted again. */
+int bga_true_color(void) {
+    return bga_active && GFX_BGA_BPP != 8;
+}
+
+/* Copy columns x0..x1-1 (x0 even) of rows y0..y1 to the framebuffer. Outside
+ * a full redraw, each row is first trimmed to the bytes that differ from
+ * the frontbuffer. */
+void bga_present(int x0, int y0, int x1, int y1, int full) {
+    for (int y = y0; y <= y1; y++) {
+        uint32_t row = y * (GFX_WIDTH / 2);
+        int b0 = x0 / 2, b1 = (x1 + 1) / 2;
+        const uint8_t *src = cursor_compose_row(y, b0, b1);
+
+        if (!full && frontbuffer) {
+            while (b0 < b1 && src[b0] == frontbuffer[row + b0]) b0++;
+            while (b1 > b0 && src[b1 - 1] == frontbuffer[row + b1 - 1]) b1--;
+            if (b0 == b1) continue;
+        }
+
+        uint8_t *dst = lfb + y * lfb_pitch;
+        if (GFX_BGA_BPP == 8) {
+            uint16_t *d = (uint16_t*)dst + b0;
+            for (int b = b0; b < b1; b++) *d++ = (uint16_t)pair[src[b]][0];
+        } else if (GFX_BGA_BPP == 16) {
+            uint32_t *d = (uint32_t*)dst + b0;
+            for (int b = b0; b < b1; b++) *d++ = pair[src[b]][0];
+        } else {
+            uint32_t *d = (uint32_t*)dst + b0 * 2;
+            for (int b = b0; b < b1; b++) {
+                *d++ = pair[src[b]][0];
+                *d++ = pair[src[b]][1];
+            }
+        }
+
+        if (frontbuffer) memcpy_s(frontbuffer + row + b0, src + b0, b1 - b0);
+    }
+}
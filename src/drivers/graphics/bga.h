@@ -0,0 +1,9 @@
+#pragma once
+#include <stdint.h>
+
+int bga_enter(void);
+void bga_exit(void);
+int bga_is_active(void);
+int bga_true_color(void);
+void bga_load_palette(const uint8_t palette[16][3]);
+void bga_present(int x0, int y0, int x1, int y1, int full);
@@ -1,5 +1,23 @@
 #include "gpriv.h"
 
+#define BMP_CHUNK   32768
+#define BMP_MAX_DIM 4096
+#define BMP_MAX_BUFFER (1024 * 1024)
+
+#define BI_RGB  0
+#define BI_RLE8 1
+#define BI_RLE4 2
+
+/* Nearest palette index for every RGB colour at 5 bits per channel. It
+ * is rebuilt the first time a load finds gfx_palette changed. */
+#define LUT_BITS 5
+#define LUT_INDEX(r, g, b) ((((r) >> (8 - LUT_BITS)) << (2 * LUT_BITS)) | \
+                            (((g) >> (8 - LUT_BITS)) << LUT_BITS) | ((b) >> (8 - LUT_BITS)))
+
+static uint8_t color_lut[1 << (3 * LUT_BITS)];
+static uint8_t lut_palette[16][3];
+static int lut_valid = 0;
+
 static uint8_t find_closest_color(uint8_t r, uint8_t g, uint8_t b) {
     int best_idx = 0;
     int best_dist = 0x7FFFFFFF;
@@ -19,107 +37,214 @@ static uint8_t find_closest_color(uint8_t r, uint8_t g, uint8_t b) {
     return (uint8_t)best_idx;
 }
 
-uint8_t* gfx_load_bmp_to_buffer(const char *path, int *out_width, int *out_height) {
-    fat32_file_t *f = fat32_open(path, "r");
-    if (!f) return NULL;
-
-    bmp_header_t header;
-    bmp_info_t info;
+static void bmp_update_lut(void) {
+    if (lut_valid && memcmp_s(lut_palette, gfx_palette, sizeof(lut_palette)) == 0) return;
+
+    /* Each cell maps to the colour nearest its centre */
+    int step = 1 << (8 - LUT_BITS);
+    int levels = 1 << LUT_BITS;
+    for (int r = 0; r < levels; r++) {
+        for (int g = 0; g < levels; g++) {
+            for (int b = 0; b < levels; b++) {
+                color_lut[(r << (2 * LUT_BITS)) | (g << LUT_BITS) | b] =
+                    find_closest_color(r * step + step / 2, g * step + step / 2, b * step + step / 2);
+            }
+        }
+    }
+    /* Exact palette colours always map to themselves */
+    for (int i = 15; i >= 0; i--)
+        color_lut[LUT_INDEX(gfx_palette[i][0], gfx_palette[i][1], gfx_palette[i][2])] = (uint8_t)i;
+    memcpy_s(lut_palette, gfx_palette, sizeof(lut_palette));
+    lut_valid = 1;
+}
 
-    if (fat32_read(f, &header, sizeof(header)) != sizeof(header)) {
-        fat32_close(f);
-        return NULL;
+/* Reads the file a chunk at a time and hands out pieces of the buffer */
+typedef struct {
+    fat32_file_t *f;
+    uint8_t *buf;
+    int size;
+    int pos, len;
+    uint32_t base;      /* File offset of buf[0] */
+} bmp_reader_t;
+
+/* The next n bytes of the file, valid until the next call; NULL if the
+ * file ends first. */
+static const uint8_t *bmp_take(bmp_reader_t *r, int n) {
+    if (n > r->size) return NULL;
+    if (r->len - r->pos < n) {
+        int left = r->len - r->pos;
+        memcpy_s(r->buf, r->buf + r->pos, left);
+        r->base += r->pos;
+        r->pos = 0;
+        r->len = left;
+
+        int got = fat32_read(r->f, r->buf + left, r->size - left);
+        if (got > 0) r->len += got;
+        if (r->len < n) return NULL;
     }
 
-    if (header.type != 0x4D42) {
-        fat32_close(f);
-        return NULL;
+    const uint8_t *p = r->buf + r->pos;
+    r->pos += n;
+    return p;
+}
+
+static int bmp_seek(bmp_reader_t *r, uint32_t offset) {
+    if (offset >= r->base && offset <= r->base + r->len) {
+        r->pos = offset - r->base;
+        return 0;
     }
+    if (fat32_seek(r->f, offset) != 0) return -1;
+    r->base = offset;
+    r->pos = r->len = 0;
+    return 0;
+}
 
-    if (fat32_read(f, &info, sizeof(info)) != sizeof(info)) {
-        fat32_close(f);
-        return NULL;
+/* Where an RLE bitmap's decoding stands between rows */
+typedef struct {
+    int x;              /* Column the next row starts at, after a delta */
+    int skip;           /* Rows a delta jumped over, still to hand out */
+    int done;           /* End of bitmap seen */
+} bmp_rle_t;
+
+/* Decode the next row of a BI_RLE8 or BI_RLE4 bitmap into one index byte
+ * per pixel. Pixels the stream skips are left 0, as is everything after
+ * a stream that stops without its end marker. Returns -1 if the file
+ * ends inside an escape. */
+static int bmp_rle_row(bmp_reader_t *r, int rle4, int width, uint8_t *row, bmp_rle_t *s) {
+    memset_s(row, 0, width);
+    if (s->done) return 0;
+    if (s->skip > 0) {
+        s->skip--;
+        return 0;
     }
 
-    if (info.compression != 0) {
-        fat32_close(f);
-        return NULL;
+    int x = s->x;
+    s->x = 0;
+    for (;;) {
+        const uint8_t *p = bmp_take(r, 2);
+        if (!p) {
+            s->done = 1;
+            return 0;
+        }
+        int count = p[0];
+        int value = p[1];
+
+        if (count > 0) {
+            /* Encoded run; RLE4 alternates the two nibbles */
+            for (int i = 0; i < count; i++, x++) {
+                if (x < width) row[x] = rle4 ? ((i & 1) ? value & 0x0F : value >> 4) : value;
+            }
+        } else if (value == 0) {
+            return 0;
+        } else if (value == 1) {
+            s->done = 1;
+            return 0;
+        } else if (value == 2) {
+            p = bmp_take(r, 2);
+            if (!p) return -1;
+            x += p[0];
+            if (p[1] > 0) {
+                s->skip = p[1] - 1;
+                s->x = x;
+                return 0;
+            }
+        } else {
+            /* Literal run of value pixels, padded to a 16-bit boundary */
+            int bytes = rle4 ? (value + 1) / 2 : value;
+            p = bmp_take(r, (bytes + 1) & ~1);
+            if (!p) return -1;
+            for (int i = 0; i < value; i++, x++) {
+                if (x < width) row[x] = rle4 ? ((i & 1) ? p[i / 2] & 0x0F : p[i / 2] >> 4) : p[i];
+            }
+        }
     }
+}
 
-    if (info.bpp != 4 && info.bpp != 8 && info.bpp != 24) {
-        fat32_close(f);
-        return NULL;
+/* Floyd-Steinberg dither one 8 or 24bpp row onto the palette. cur holds
+ * the error carried into this row and next collects it for the row
+ * below, as RGB triples with one pixel of padding at either end. */
+static void bmp_dither_row(const uint8_t *src, int bpp, const uint8_t (*palette)[3], int palette_entries,
+                           int width, int16_t *cur, int16_t *next, uint8_t *out) {
+    for (int x = 0; x < width; x++) {
+        int r, g, b;
+        if (bpp == 24) {
+            r = src[x * 3 + 2];
+            g = src[x * 3 + 1];
+            b = src[x * 3 + 0];
+        } else {
+            uint8_t idx = src[x];
+            if (idx >= palette_entries) idx = 0;
+            r = palette[idx][0];
+            g = palette[idx][1];
+            b = palette[idx][2];
+        }
+
+        int16_t *e = cur + (x + 1) * 3;
+        r += e[0];
+        g += e[1];
+        b += e[2];
+        if (r < 0) r = 0; else if (r > 255) r = 255;
+        if (g < 0) g = 0; else if (g > 255) g = 255;
+        if (b < 0) b = 0; else if (b > 255) b = 255;
+
+        uint8_t color = color_lut[LUT_INDEX(r, g, b)];
+
+        int err[3] = { r - gfx_palette[color][0], g - gfx_palette[color][1], b - gfx_palette[color][2] };
+        int16_t *n = next + (x + 1) * 3;
+        for (int c = 0; c < 3; c++) {
+            e[3 + c] += (err[c] * 7) / 16;
+            n[c - 3] += (err[c] * 3) / 16;
+            n[c] += (err[c] * 5) / 16;
+            n[c + 3] += err[c] / 16;
+        }
+
+        if (x & 1) out[x / 2] |= color;
+        else out[x / 2] = (uint8_t)(color << 4);
     }
+}
 
-    int width = info.width;
-    int height = info.height > 0 ? info.height : -info.height;
-    int bottom_up = info.height > 0;
+uint8_t* gfx_load_bmp_to_buffer(const char *path, int *out_width, int *out_height) {
+    fat32_file_t *f = fat32_open(path, "r");
+    if (!f) return NULL;
 
-    if (width <= 0 || height <= 0) {
+    bmp_reader_t r = { f, NULL, BMP_CHUNK, 0, 0, 0 };
+    r.buf = kmalloc(BMP_CHUNK);
+    if (!r.buf) {
         fat32_close(f);
         return NULL;
     }
 
-    const int MAX_DIM = 4096;
-    if (width > MAX_DIM || height > MAX_DIM) {
+    bmp_header_t header;
+    bmp_info_t info;
+    const uint8_t *p = bmp_take(&r, sizeof(header));
+    if (p) memcpy_s(&header, p, sizeof(header));
+    p = p ? bmp_take(&r, sizeof(info)) : NULL;
+    if (p) memcpy_s(&info, p, sizeof(info));
+
+    int width = p ? info.width : 0;
+    int height = p ? (info.height > 0 ? info.height : -info.height) : 0;
+    int bottom_up = p && info.height > 0;
+
+    /* RLE bitmaps are always stored bottom-up */
+    int rle = p && (info.compression == BI_RLE8 || info.compression == BI_RLE4);
+    int format_ok = p && ((info.compression == BI_RGB && (info.bpp == 4 || info.bpp == 8 || info.bpp == 24)) ||
+                          (info.compression == BI_RLE8 && info.bpp == 8 && bottom_up) ||
+                          (info.compression == BI_RLE4 && info.bpp == 4 && bottom_up));
+
+    if (!p || header.type != 0x4D42 || !format_ok ||
+        width <= 0 || height <= 0 || width > BMP_MAX_DIM || height > BMP_MAX_DIM) {
+        kfree(r.buf);
         fat32_close(f);
         return NULL;
     }
 
     int out_row_bytes = (width + 1) / 2;
     size_t buffer_size = (size_t)out_row_bytes * (size_t)height;
-    const size_t MAX_BUFFER = 1024 * 1024;
-    if (buffer_size == 0 || buffer_size > MAX_BUFFER) {
-        fat32_close(f);
-        return NULL;
-    }
-
-    uint8_t *bitmap = kmalloc((int)buffer_size);
-    if (!bitmap) {
+    if (buffer_size > BMP_MAX_BUFFER) {
+        kfree(r.buf);
         fat32_close(f);
         return NULL;
     }
-    memset_s(bitmap, 0, buffer_size);
-
-    /* The display is 4bpp, so indexed BMP palettes are capped to 16 colors. */
-    uint8_t (*palette)[3] = NULL;
-    int palette_entries = 0;
-
-    if (info.bpp <= 8) {
-        palette_entries = info.colors_used ? (int)info.colors_used : (1 << info.bpp);
-        if (palette_entries > 256) palette_entries = 256;
-        
-        int load_entries = palette_entries < 16 ? palette_entries : 16;
-        palette = kmalloc(16 * 3);
-        if (!palette) {
-            kfree(bitmap);
-            fat32_close(f);
-            return NULL;
-        }
-        memset_s(palette, 0, 16 * 3);
-        
-        for (int i = 0; i < load_entries; i++) {
-            uint8_t bgr[4];
-            if (fat32_read(f, bgr, 4) != 4) {
-                kfree(palette);
-                kfree(bitmap);
-                fat32_close(f);
-                return NULL;
-            }
-            palette[i][0] = bgr[2];
-            palette[i][1] = bgr[1];
-            palette[i][2] = bgr[0];
-        }
-        
-        for (int i = load_entries; i < palette_entries; i++) {
-            uint8_t bgr[4];
-            fat32_read(f, bgr, 4);
-        }
-        
-        palette_entries = load_entries;
-    }
-
-    fat32_seek(f, header.offset);
 
     /* BMP rows are DWORD-aligned on disk. */
     int src_row_size;
@@ -131,186 +256,86 @@ uint8_t* gfx_load_bmp_to_buffer(const char *path, int *out_width, int *out_heigh
         src_row_size = (((width + 1) / 2) + 3) & ~3;
     }
 
-    uint8_t *row_buf = kmalloc(src_row_size);
-    if (!row_buf) {
-        if (palette) kfree(palette);
-        kfree(bitmap);
+    /* The display is 4bpp, so indexed BMP palettes are capped to 16 colors. */
+    uint8_t palette[16][3];
+    int palette_entries = 0;
+    if (info.bpp == 8) {
+        palette_entries = info.colors_used ? (int)info.colors_used : 256;
+        if (palette_entries > 16) palette_entries = 16;
+        memset_s(palette, 0, sizeof(palette));
+
+        /* The colour table follows the info header, whatever its size */
+        p = bmp_seek(&r, sizeof(header) + (info.size > sizeof(info) ? info.size : sizeof(info))) == 0
+            ? bmp_take(&r, palette_entries * 4) : NULL;
+        for (int i = 0; p && i < palette_entries; i++) {
+            palette[i][0] = p[i * 4 + 2];
+            palette[i][1] = p[i * 4 + 1];
+            palette[i][2] = p[i * 4 + 0];
+        }
+    }
+
+    uint8_t *bitmap = kmalloc((int)buffer_size);
+    int16_t *err = NULL;
+    uint8_t *rle_row = NULL;
+    bmp_rle_t rle_state = { 0, 0, 0 };
+    if (info.bpp >= 8) err = kmalloc(6 * (width + 2) * sizeof(int16_t));
+    if (rle) rle_row = kmalloc(width);
+
+    if (!bitmap || (info.bpp >= 8 && (!err || !p)) || (rle && !rle_row) ||
+        (!rle && src_row_size > r.size) || bmp_seek(&r, header.offset) != 0) {
+        if (bitmap) kfree(bitmap);
+        if (err) kfree(err);
+        if (rle_row) kfree(rle_row);
+        kfree(r.buf);
         fat32_close(f);
         return NULL;
     }
 
-    int16_t *err_r_curr = NULL, *err_g_curr = NULL, *err_b_curr = NULL;
-    int16_t *err_r_next = NULL, *err_g_next = NULL, *err_b_next = NULL;
-    
-    if (info.bpp >= 8 && width > 0 && width <= MAX_DIM) {
-        size_t err_buf_size = (size_t)width * sizeof(int16_t);
-        if (err_buf_size > 0 && err_buf_size < MAX_BUFFER) {
-            err_r_curr = kmalloc((int)err_buf_size);
-            err_g_curr = kmalloc((int)err_buf_size);
-            err_b_curr = kmalloc((int)err_buf_size);
-            err_r_next = kmalloc((int)err_buf_size);
-            err_g_next = kmalloc((int)err_buf_size);
-            err_b_next = kmalloc((int)err_buf_size);
-        }
-        
-        if (!err_r_curr || !err_g_curr || !err_b_curr || !err_r_next || !err_g_next || !err_b_next) {
-            if (err_r_curr) kfree(err_r_curr);
-            if (err_g_curr) kfree(err_g_curr);
-            if (err_b_curr) kfree(err_b_curr);
-            if (err_r_next) kfree(err_r_next);
-            if (err_g_next) kfree(err_g_next);
-            if (err_b_next) kfree(err_b_next);
-            kfree(row_buf);
-            if (palette) kfree(palette);
-            kfree(bitmap);
-            fat32_close(f);
-            return NULL;
-        }
-        
-        for (int x = 0; x < width; x++) {
-            err_r_curr[x] = err_g_curr[x] = err_b_curr[x] = 0;
-            err_r_next[x] = err_g_next[x] = err_b_next[x] = 0;
-        }
+    int16_t *err_curr = err;
+    int16_t *err_next = err ? err + 3 * (width + 2) : NULL;
+    if (err) {
+        memset_s(err, 0, 6 * (width + 2) * sizeof(int16_t));
+        bmp_update_lut();
     }
 
     for (int y = 0; y < height; y++) {
-        if (fat32_read(f, row_buf, src_row_size) != src_row_size) {
-            if (err_r_curr) kfree(err_r_curr);
-            if (err_g_curr) kfree(err_g_curr);
-            if (err_b_curr) kfree(err_b_curr);
-            if (err_r_next) kfree(err_r_next);
-            if (err_g_next) kfree(err_g_next);
-            if (err_b_next) kfree(err_b_next);
-            kfree(row_buf);
-            if (palette) kfree(palette);
+        const uint8_t *row;
+        if (rle) row = bmp_rle_row(&r, info.compression == BI_RLE4, width, rle_row, &rle_state) == 0 ? rle_row : NULL;
+        else row = bmp_take(&r, src_row_size);
+        if (!row) {
+            if (err) kfree(err);
+            if (rle_row) kfree(rle_row);
             kfree(bitmap);
+            kfree(r.buf);
             fat32_close(f);
             return NULL;
         }
 
         int dest_y = bottom_up ? (height - 1 - y) : y;
-        int dest_offset = dest_y * out_row_bytes;
-
-        if (info.bpp == 24) {
-            for (int x = 0; x < width; x++) {
-                int16_t r = (int16_t)row_buf[x * 3 + 2] + err_r_curr[x];
-                int16_t g = (int16_t)row_buf[x * 3 + 1] + err_g_curr[x];
-                int16_t b = (int16_t)row_buf[x * 3 + 0] + err_b_curr[x];
-                
-                if (r < 0) r = 0; else if (r > 255) r = 255;
-                if (g < 0) g = 0; else if (g > 255) g = 255;
-                if (b < 0) b = 0; else if (b > 255) b = 255;
-                
-                uint8_t color = find_closest_color((uint8_t)r, (uint8_t)g, (uint8_t)b);
-                
-                int16_t err_r = r - (int16_t)gfx_palette[color][0];
-                int16_t err_g = g - (int16_t)gfx_palette[color][1];
-                int16_t err_b = b - (int16_t)gfx_palette[color][2];
-                
-                if (x + 1 < width) {
-                    err_r_curr[x + 1] += (err_r * 7) / 16;
-                    err_g_curr[x + 1] += (err_g * 7) / 16;
-                    err_b_curr[x + 1] += (err_b * 7) / 16;
-                }
-                if (x > 0) {
-                    err_r_next[x - 1] += (err_r * 3) / 16;
-                    err_g_next[x - 1] += (err_g * 3) / 16;
-                    err_b_next[x - 1] += (err_b * 3) / 16;
-                }
-                err_r_next[x] += (err_r * 5) / 16;
-                err_g_next[x] += (err_g * 5) / 16;
-                err_b_next[x] += (err_b * 5) / 16;
-                if (x + 1 < width) {
-                    err_r_next[x + 1] += err_r / 16;
-                    err_g_next[x + 1] += err_g / 16;
-                    err_b_next[x + 1] += err_b / 16;
-                }
-                
-                int byte_idx = x / 2;
-                if (x & 1) {
-                    bitmap[dest_offset + byte_idx] = (bitmap[dest_offset + byte_idx] & 0xF0) | color;
-                } else {
-                    bitmap[dest_offset + byte_idx] = (color << 4) | (bitmap[dest_offset + byte_idx] & 0x0F);
-                }
-            }
-            
-            int16_t *tmp_r = err_r_curr; err_r_curr = err_r_next; err_r_next = tmp_r;
-            int16_t *tmp_g = err_g_curr; err_g_curr = err_g_next; err_g_next = tmp_g;
-            int16_t *tmp_b = err_b_curr; err_b_curr = err_b_next; err_b_next = tmp_b;
-            for (int x = 0; x < width; x++) {
-                err_r_next[x] = err_g_next[x] = err_b_next[x] = 0;
-            }
-        } else if (info.bpp == 8) {
-            for (int x = 0; x < width; x++) {
-                uint8_t idx = row_buf[x];
-                if (idx >= palette_entries) idx = 0;
-                
-                int16_t r = (int16_t)palette[idx][0] + err_r_curr[x];
-                int16_t g = (int16_t)palette[idx][1] + err_g_curr[x];
-                int16_t b = (int16_t)palette[idx][2] + err_b_curr[x];
-                
-                if (r < 0) r = 0; else if (r > 255) r = 255;
-                if (g < 0) g = 0; else if (g > 255) g = 255;
-                if (b < 0) b = 0; else if (b > 255) b = 255;
-                
-                uint8_t color = find_closest_color((uint8_t)r, (uint8_t)g, (uint8_t)b);
-                
-                int16_t err_r = r - (int16_t)gfx_palette[color][0];
-                int16_t err_g = g - (int16_t)gfx_palette[color][1];
-                int16_t err_b = b - (int16_t)gfx_palette[color][2];
-                
-                if (x + 1 < width) {
-                    err_r_curr[x + 1] += (err_r * 7) / 16;
-                    err_g_curr[x + 1] += (err_g * 7) / 16;
-                    err_b_curr[x + 1] += (err_b * 7) / 16;
-                }
-                if (x > 0) {
-                    err_r_next[x - 1] += (err_r * 3) / 16;
-                    err_g_next[x - 1] += (err_g * 3) / 16;
-                    err_b_next[x - 1] += (err_b * 3) / 16;
-                }
-                err_r_next[x] += (err_r * 5) / 16;
-                err_g_next[x] += (err_g * 5) / 16;
-                err_b_next[x] += (err_b * 5) / 16;
-                if (x + 1 < width) {
-                    err_r_next[x + 1] += err_r / 16;
-                    err_g_next[x + 1] += err_g / 16;
-                    err_b_next[x + 1] += err_b / 16;
-                }
-                
-                int byte_idx = x / 2;
-                if (x & 1) {
-                    bitmap[dest_offset + byte_idx] = (bitmap[dest_offset + byte_idx] & 0xF0) | color;
-                } else {
-                    bitmap[dest_offset + byte_idx] = (color << 4) | (bitmap[dest_offset + byte_idx] & 0x0F);
-                }
-            }
-            
-            int16_t *tmp_r = err_r_curr; err_r_curr = err_r_next; err_r_next = tmp_r;
-            int16_t *tmp_g = err_g_curr; err_g_curr = err_g_next; err_g_next = tmp_g;
-            int16_t *tmp_b = err_b_curr; err_b_curr = err_b_next; err_b_next = tmp_b;
-            for (int x = 0; x < width; x++) {
-                err_r_next[x] = err_g_next[x] = err_b_next[x] = 0;
-            }
+        uint8_t *dest = bitmap + dest_y * out_row_bytes;
+
+        if (info.bpp >= 8) {
+            bmp_dither_row(row, info.bpp, (const uint8_t (*)[3])palette, palette_entries,
+                           width, err_curr, err_next, dest);
+
+            int16_t *tmp = err_curr;
+            err_curr = err_next;
+            err_next = tmp;
+            memset_s(err_next, 0, 3 * (width + 2) * sizeof(int16_t));
+        } else if (rle) {
+            /* Same as below, once the decoded indexes are packed again */
+            for (int x = 0; x < width; x += 2)
+                dest[x / 2] = (uint8_t)(row[x] << 4) | (x + 1 < width ? row[x + 1] : 0);
         } else {
-            for (int x = 0; x < out_row_bytes; x++) {
-                uint8_t byte_val = row_buf[x];
-                /* 4bpp osLET assets already use VGA indexes. Preserve them so
-                   index 5 remains the transparent icon color after palette edits. */
-                bitmap[dest_offset + x] = byte_val;
-            }
+            /* 4bpp osLET assets already use VGA indexes. Preserve them so
+               index 5 remains the transparent icon color after palette edits. */
+            memcpy_s(dest, row, out_row_bytes);
         }
     }
-    
-    if (err_r_curr) kfree(err_r_curr);
-    if (err_g_curr) kfree(err_g_curr);
-    if (err_b_curr) kfree(err_b_curr);
-    if (err_r_next) kfree(err_r_next);
-    if (err_g_next) kfree(err_g_next);
-    if (err_b_next) kfree(err_b_next);
-
-    if (palette) kfree(palette);
-    kfree(row_buf);
+
+    if (err) kfree(err);
+    if (rle_row) kfree(rle_row);
+    kfree(r.buf);
     fat32_close(f);
 
     *out_width = width;
@@ -318,58 +343,68 @@ uint8_t* gfx_load_bmp_to_buffer(const char *path, int *out_width, int *out_heigh
     return bitmap;
 }
 
-void gfx_draw_cached_bmp_ex(uint8_t *cached_data, int width, int height, int dest_x, int dest_y, int transparent) {
+/* keep: the bitmap outlives the next swap, so the latch engine may store
+   it as a sprite */
+static void bmp_draw(uint8_t *cached_data, int width, int height, int dest_x, int dest_y, int transparent,
+                     int keep) {
     if (!backbuffer || !cached_data) return;
 
-    int dirty_x0 = dest_x < 0 ? 0 : dest_x;
-    int dirty_y0 = dest_y < 0 ? 0 : dest_y;
-    int dirty_x1 = dest_x + width - 1;
-    int dirty_y1 = dest_y + height - 1;
-
-    if (dirty_x1 >= GFX_WIDTH) dirty_x1 = GFX_WIDTH - 1;
-    if (dirty_y1 >= GFX_HEIGHT) dirty_y1 = GFX_HEIGHT - 1;
+    /* Columns and rows left after clipping */
+    int c0 = dest_x < clip_x0 ? clip_x0 - dest_x : 0;
+    int c1 = dest_x + width > clip_x1 + 1 ? clip_x1 + 1 - dest_x : width;
+    int r0 = dest_y < clip_y0 ? clip_y0 - dest_y : 0;
+    int r1 = dest_y + height > clip_y1 + 1 ? clip_y1 + 1 - dest_y : height;
+    if (c0 >= c1 || r0 >= r1) return;
 
     int src_row_bytes = (width + 1) / 2;
 
-    /* Fast path: no transparency, aligned coordinates, fully on screen */
-    if (!transparent && (dest_x & 1) == 0 && dest_x >= 0 && dest_x + width <= GFX_WIDTH) {
-        int dest_byte_x = dest_x / 2;
-        for (int y = 0; y < height; y++) {
+    /* Fast path: no transparency and aligned coordinates. Whole bytes are
+       copied; a clip edge can leave one odd pixel at either end. */
+    if (!transparent && (dest_x & 1) == 0) {
+        int b0 = (c0 + 1) / 2;
+        int b1 = c1 / 2;
+        for (int y = r0; y < r1; y++) {
             int screen_y = dest_y + y;
-            if (screen_y < 0 || screen_y >= GFX_HEIGHT) continue;
-
             uint8_t *src = cached_data + y * src_row_bytes;
-            uint8_t *dst = backbuffer + screen_y * (GFX_WIDTH / 2) + dest_byte_x;
-            memcpy_s(dst, src, src_row_bytes);
+            uint8_t *dst = backbuffer + screen_y * bb_pitch + dest_x / 2;
+
+            if (b1 > b0) memcpy_s(dst + b0, src + b0, b1 - b0);
+            if (c0 & 1) putpixel_raw(dest_x + c0, screen_y, src[c0 / 2] & 0x0F);
+            if (c1 & 1) putpixel_raw(dest_x + c1 - 1, screen_y, src[c1 / 2] >> 4);
         }
     } else {
         /* Slow path: pixel-by-pixel for transparency or unaligned */
-        for (int y = 0; y < height; y++) {
+        for (int y = r0; y < r1; y++) {
             int screen_y = dest_y + y;
-            if (screen_y < 0 || screen_y >= GFX_HEIGHT) continue;
-
             int src_offset = y * src_row_bytes;
 
-            for (int x = 0; x < width; x++) {
+            for (int x = c0; x < c1; x++) {
                 int byte_idx = x / 2;
                 uint8_t pixel = (x & 1) ? (cached_data[src_offset + byte_idx] & 0x0F) : (cached_data[src_offset + byte_idx] >> 4);
 
-                int screen_x = dest_x + x;
-
                 /* Skip transparent pixels (color index 5) only if transparency enabled */
-                if (screen_x >= 0 && screen_x < GFX_WIDTH && (!transparent || pixel != 5)) {
-                    putpixel_raw(screen_x, screen_y, pixel);
+                if (!transparent || pixel != 5) {
+                    putpixel_raw(dest_x + x, screen_y, pixel);
                 }
             }
         }
     }
 
-    /* Mark only the actually drawn region as dirty */
-    if (dirty_x1 >= dirty_x0 && dirty_y1 >= dirty_y0) {
-        mark_dirty(dirty_x0, dirty_y0, dirty_x1 - dirty_x0 + 1, dirty_y1 - dirty_y0 + 1);
+    mark_dirty(dest_x + c0, dest_y + r0, c1 - c0, r1 - r0);
+    if (keep) {
+        latch_hint_sprite(cached_data, width, height, dest_x, dest_y,
+                          dest_x + c0, dest_y + r0, c1 - c0, r1 - r0);
     }
 }
 
+void gfx_draw_cached_bmp_ex(uint8_t *cached_data, int width, int height, int dest_x, int dest_y, int transparent) {
+    bmp_draw(cached_data, width, height, dest_x, dest_y, transparent, 0);
+}
+
+void gfx_draw_kept_bmp(uint8_t *cached_data, int width, int height, int dest_x, int dest_y, int transparent) {
+    bmp_draw(cached_data, width, height, dest_x, dest_y, transparent, 1);
+}
+
 void gfx_draw_cached_bmp(uint8_t *cached_data, int width, int height, int dest_x, int dest_y) {
     gfx_draw_cached_bmp_ex(cached_data, width, height, dest_x, dest_y, 1);
 }
@@ -393,7 +428,7 @@ void gfx_draw_cached_bmp_region(uint8_t *cached_data, int width, int height, int
 
     for (int y = 0; y < src_h; y++) {
         int screen_y = dest_y + y;
-        if (screen_y < 0 || screen_y >= GFX_HEIGHT) continue;
+        if (screen_y < clip_y0 || screen_y > clip_y1) continue;
 
         int src_offset = (src_y + y) * src_row_bytes;
 
@@ -404,26 +439,14 @@ void gfx_draw_cached_bmp_region(uint8_t *cached_data, int width, int height, int
 
             int screen_x = dest_x + x;
 
-            if (screen_x >= 0 && screen_x < GFX_WIDTH && (!transparent || pixel != 5)) {
+            if (!transparent || pixel != 5) {
                 putpixel_raw(screen_x, screen_y, pixel);
             }
         }
     }
 
-    /* Mark the actually drawn region as dirty (clip to screen) */
-    int x0 = dest_x;
-    int y0 = dest_y;
-    int x1 = dest_x + src_w - 1;
-    int y1 = dest_y + src_h - 1;
-
-    if (x0 < 0) x0 = 0;
-    if (y0 < 0) y0 = 0;
-    if (x1 >= GFX_WIDTH) x1 = GFX_WIDTH - 1;
-    if (y1 >= GFX_HEIGHT) y1 = GFX_HEIGHT - 1;
-
-    if (x1 >= x0 && y1 >= y0) {
-        mark_dirty(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
-    }
+    /* Mark the drawn region as dirty (clipped by mark_dirty) */
+    mark_dirty(dest_x, dest_y, src_w, src_h);
 }
 
 int gfx_load_bmp_4bit_ex(const char *path, int dest_x, int dest_y, int transparent) {
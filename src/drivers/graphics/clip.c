@@ -0,0 +1,57 @@
+#include "gpriv.h"
+
+/* Every primitive draws inside the current clip rectangle, which starts
+ * out as the whole screen. Pushing intersects it with a new rectangle;
+ * popping goes back to the one before. */
+
+int clip_x0 = 0, clip_y0 = 0;
+int clip_x1 = GFX_WIDTH - 1, clip_y1 = GFX_HEIGHT - 1;
+
+static int clip_stack[GFX_CLIP_DEPTH][4];
+static int clip_depth = 0;
+
+int gfx_push_clip(int x, int y, int w, int h) {
+    if (clip_depth >= GFX_CLIP_DEPTH) return -1;
+
+    clip_stack[clip_depth][0] = clip_x0;
+    clip_stack[clip_depth][1] = clip_y0;
+    clip_stack[clip_depth][2] = clip_x1;
+    clip_stack[clip_depth][3] = clip_y1;
+    clip_depth++;
+
+    /* May come out empty (x0 > x1); then nothing is drawn until the pop */
+    if (x > clip_x0) clip_x0 = x;
+    if (y > clip_y0) clip_y0 = y;
+    if (x + w - 1 < clip_x1) clip_x1 = x + w - 1;
+    if (y + h - 1 < clip_y1) clip_y1 = y + h - 1;
+    return 0;
+}
+
+void gfx_pop_clip(void) {
+    if (clip_depth == 0) return;
+    clip_depth--;
+    clip_x0 = clip_stack[clip_depth][0];
+    clip_y0 = clip_stack[clip_depth][1];
+    clip_x1 = clip_stack[clip_depth][2];
+    clip_y1 = clip_stack[clip_depth][3];
+}
+
+void gfx_reset_clip(void) {
+    clip_depth = 0;
+    clip_x0 = 0;
+    clip_y0 = 0;
+    clip_x1 = GFX_WIDTH - 1;
+    clip_y1 = GFX_HEIGHT - 1;
+}
+
+void gfx_get_clip(int *x, int *y, int *w, int *h) {
+    if (x) *x = clip_x0;
+    if (y) *y = clip_y0;
+    if (w) *w = clip_x1 >= clip_x0 ? clip_x1 - clip_x0 + 1 : 0;
+    if (h) *h = clip_y1 >= clip_y0 ? clip_y1 - clip_y0 + 1 : 0;
+}
+
+int gfx_clip_visible(int x, int y, int w, int h) {
+    if (w <= 0 || h <= 0) return 0;
+    return x <= clip_x1 && y <= clip_y1 && x + w - 1 >= clip_x0 && y + h - 1 >= clip_y0;
+}
@@ -0,0 +1,112 @@
+#include "gpriv.h"
+#include "../../lib/string.h"
+
+/* The mouse pointer is an overlay: it never enters the backbuffer. The
+ * present merges it into the rows it writes, so frontbuffer (and VRAM)
+ * hold the screen with the pointer on top. Moving it only presents the
+ * cells it left and the cells it now covers. */
+
+#define CURSOR_MAX 32
+#define CURSOR_CLEAR 0xFF
+
+static uint8_t cursor_pixels[CURSOR_MAX * CURSOR_MAX];
+static int cursor_w = 0, cursor_h = 0;
+static int cursor_x = 0, cursor_y = 0;
+static int cursor_shown = 0;
+static int cursor_changed = 0;
+static uint8_t cursor_line[GFX_WIDTH / 2];
+
+/* Where the last present put the pointer */
+static int drawn_x, drawn_y, drawn_w, drawn_h;
+static int drawn = 0;
+
+/* One byte per pixel, w x h; CURSOR_CLEAR (0xFF) is transparent */
+int gfx_set_cursor_image(const uint8_t *pixels, int w, int h) {
+    if (!pixels || w <= 0 || h <= 0 || w > CURSOR_MAX || h > CURSOR_MAX) return -1;
+
+    GFX_LOCK();
+    for (int row = 0; row < h; row++)
+        memcpy_s(cursor_pixels + row * CURSOR_MAX, pixels + row * w, w);
+    cursor_w = w;
+    cursor_h = h;
+    cursor_changed = 1;
+    GFX_UNLOCK();
+    return 0;
+}
+
+void gfx_show_cursor(int x, int y) {
+    if (cursor_shown && x == cursor_x && y == cursor_y) return;
+    cursor_x = x;
+    cursor_y = y;
+    cursor_shown = 1;
+    cursor_changed = 1;
+}
+
+void gfx_hide_cursor(void) {
+    if (!cursor_shown) return;
+    cursor_shown = 0;
+    cursor_changed = 1;
+}
+
+/* The screen was cleared under the pointer */
+void cursor_reset(void) {
+    drawn = 0;
+    cursor_changed = 1;
+}
+
+/* Byte range b0..b1-1 of backbuffer row y with the pointer drawn over it.
+ * The result is indexed like a backbuffer row. */
+const uint8_t *cursor_compose_row(int y, int b0, int b1) {
+    const uint8_t *row = backbuffer + y * (GFX_WIDTH / 2);
+    if (!cursor_shown || y < cursor_y || y >= cursor_y + cursor_h) return row;
+
+    int p0 = cursor_x > b0 * 2 ? cursor_x : b0 * 2;
+    int p1 = cursor_x + cursor_w < b1 * 2 ? cursor_x + cursor_w : b1 * 2;
+    if (p1 > GFX_WIDTH) p1 = GFX_WIDTH;
+    if (p0 >= p1) return row;
+
+    memcpy_s(cursor_line + b0, row + b0, b1 - b0);
+    const uint8_t *src = cursor_pixels + (y - cursor_y) * CURSOR_MAX - cursor_x;
+    for (int x = p0; x < p1; x++) {
+        uint8_t px = src[x];
+        if (px == CURSOR_CLEAR) continue;
+        uint8_t *b = &cursor_line[x / 2];
+        *b = (x & 1) ? (*b & 0xF0) | (px & 0x0F) : (*b & 0x0F) | (uint8_t)(px << 4);
+    }
+    return cursor_line;
+}
+
+static int cursor_area(int x, int y, int w, int h, int *area) {
+    int x1 = x + w;
+    int y1 = y + h - 1;
+    if (x < 0) x = 0;
+    if (y < 0) y = 0;
+    if (x1 > GFX_WIDTH) x1 = GFX_WIDTH;
+    if (y1 > GFX_HEIGHT - 1) y1 = GFX_HEIGHT - 1;
+    if (x >= x1 || y > y1) return 0;
+
+    area[0] = x & ~7;
+    area[1] = y;
+    area[2] = (x1 + 7) & ~7;
+    area[3] = y1;
+    return 1;
+}
+
+/* The areas a present must cover because the pointer moved, appeared,
+ * went away or changed shape: where it was and where it is now, as
+ * (x0, y0, x1 exclusive, y1) with x on cell boundaries. Returns how many. */
+int cursor_take_areas(int areas[2][4]) {
+    int count = 0;
+    if (!cursor_changed) return 0;
+
+    if (drawn && cursor_area(drawn_x, drawn_y, drawn_w, drawn_h, areas[count])) count++;
+    if (cursor_shown && cursor_area(cursor_x, cursor_y, cursor_w, cursor_h, areas[count])) count++;
+
+    drawn = cursor_shown;
+    drawn_x = cursor_x;
+    drawn_y = cursor_y;
+    drawn_w = cursor_w;
+    drawn_h = cursor_h;
+    cursor_changed = 0;
+    return count;
+}
@@ -2,7 +2,7 @@
 
 void gfx_floodfill(int x, int y, uint8_t new_color) {
     if (!backbuffer) return;
-    if (x < 0 || x >= GFX_WIDTH || y < 0 || y >= GFX_HEIGHT) return;
+    if (x < clip_x0 || x > clip_x1 || y < clip_y0 || y > clip_y1) return;
 
     uint8_t target = getpixel_raw(x, y);
     if (target == new_color) {
@@ -30,7 +30,7 @@ void gfx_floodfill(int x, int y, uint8_t new_color) {
         int cy = (int)(v >> 16);
         int cx = (int)(int16_t)(v & 0xFFFF);
 
-        if (cx < 0 || cx >= GFX_WIDTH || cy < 0 || cy >= GFX_HEIGHT)
+        if (cx < clip_x0 || cx > clip_x1 || cy < clip_y0 || cy > clip_y1)
             continue;
 
         if (getpixel_raw(cx, cy) != target)
@@ -39,10 +39,10 @@ void gfx_floodfill(int x, int y, uint8_t new_color) {
         int lx = cx;
         int rx = cx;
 
-        while (lx - 1 >= 0 && getpixel_raw(lx - 1, cy) == target) {
+        while (lx - 1 >= clip_x0 && getpixel_raw(lx - 1, cy) == target) {
             lx--;
         }
-        while (rx + 1 < GFX_WIDTH && getpixel_raw(rx + 1, cy) == target) {
+        while (rx + 1 <= clip_x1 && getpixel_raw(rx + 1, cy) == target) {
             rx++;
         }
 
@@ -56,7 +56,7 @@ void gfx_floodfill(int x, int y, uint8_t new_color) {
         if (cy > max_y) max_y = cy;
 
         for (int ny = cy - 1; ny <= cy + 1; ny += 2) {
-            if (ny < 0 || ny >= GFX_HEIGHT)
+            if (ny < clip_y0 || ny > clip_y1)
                 continue;
 
             int nx = lx;
@@ -113,29 +113,27 @@ void gfx_fillrect_gradient(int x, int y, int w, int h,
     int x1 = x + w - 1;
     int y1 = y + h - 1;
 
-    if (x0 >= GFX_WIDTH || y0 >= GFX_HEIGHT) return;
-    if (x1 < 0 || y1 < 0) return;
-
-    if (x0 < 0) x0 = 0;
-    if (y0 < 0) y0 = 0;
-    if (x1 >= GFX_WIDTH)  x1 = GFX_WIDTH - 1;
-    if (y1 >= GFX_HEIGHT) y1 = GFX_HEIGHT - 1;
+    if (x0 < clip_x0) x0 = clip_x0;
+    if (y0 < clip_y0) y0 = clip_y0;
+    if (x1 > clip_x1) x1 = clip_x1;
+    if (y1 > clip_y1) y1 = clip_y1;
 
     int eff_w = x1 - x0 + 1;
     int eff_h = y1 - y0 + 1;
 
     if (eff_w <= 0 || eff_h <= 0) return;
 
+    /* The ramp spans the whole rectangle, so clipped parts line up */
     int denom = (orientation == GRADIENT_V)
-                ? ((eff_h > 1) ? (eff_h - 1) : 1)
-                : ((eff_w > 1) ? (eff_w - 1) : 1);
+                ? ((h > 1) ? (h - 1) : 1)
+                : ((w > 1) ? (w - 1) : 1);
 
     for (int py = 0; py < eff_h; py++) {
         int sy = y0 + py;
         for (int px = 0; px < eff_w; px++) {
             int sx = x0 + px;
 
-            int pos = (orientation == GRADIENT_V) ? py : px;
+            int pos = (orientation == GRADIENT_V) ? sy - y : sx - x;
             int bx = sx & 7;
             int by = sy & 7;
 
@@ -151,7 +149,7 @@ void gfx_floodfill_gradient(int x, int y,
                             uint8_t c_start, uint8_t c_end,
                             int orientation) {
     if (!backbuffer) return;
-    if (x < 0 || x >= GFX_WIDTH || y < 0 || y >= GFX_HEIGHT) return;
+    if (x < clip_x0 || x > clip_x1 || y < clip_y0 || y > clip_y1) return;
 
     uint8_t target = getpixel_raw(x, y);
 
@@ -191,7 +189,7 @@ void gfx_floodfill_gradient(int x, int y,
         int cy = (int)(v >> 16);
         int cx = (int)(int16_t)(v & 0xFFFF);
 
-        if (cx < 0 || cx >= GFX_WIDTH || cy < 0 || cy >= GFX_HEIGHT)
+        if (cx < clip_x0 || cx > clip_x1 || cy < clip_y0 || cy > clip_y1)
             continue;
 
         if (getpixel_raw(cx, cy) != target)
@@ -200,8 +198,8 @@ void gfx_floodfill_gradient(int x, int y,
         int lx = cx;
         int rx = cx;
 
-        while (lx - 1 >= 0 && getpixel_raw(lx - 1, cy) == target) lx--;
-        while (rx + 1 < GFX_WIDTH && getpixel_raw(rx + 1, cy) == target) rx++;
+        while (lx - 1 >= clip_x0 && getpixel_raw(lx - 1, cy) == target) lx--;
+        while (rx + 1 <= clip_x1 && getpixel_raw(rx + 1, cy) == target) rx++;
 
         for (int px = lx; px <= rx; px++)
             putpixel_raw(px, cy, placeholder);
@@ -212,7 +210,7 @@ void gfx_floodfill_gradient(int x, int y,
         if (cy > max_y) max_y = cy;
 
         for (int ny = cy - 1; ny <= cy + 1; ny += 2) {
-            if (ny < 0 || ny >= GFX_HEIGHT) continue;
+            if (ny < clip_y0 || ny > clip_y1) continue;
 
             int nx = lx;
             while (nx <= rx) {
@@ -5,6 +5,7 @@
 #include "../../mem/heap.h"
 #include "../../irq/io.h"
 #include "vga.h"
+#include "bga.h"
 #include "../fat32.h"
 
 #define GFX_LOCK() __asm__ volatile("cli")
@@ -20,6 +21,16 @@ extern volatile int gfx_dirty_y0;
 extern volatile int gfx_dirty_x1;
 extern volatile int gfx_dirty_y1;
 extern volatile int gfx_full_redraw;
+extern int gfx_clip_x0;
+extern int gfx_clip_y0;
+extern int gfx_clip_x1;
+extern int gfx_clip_y1;
+extern int gfx_bb_pitch;
+extern int gfx_surface_active;
+extern int gfx_read_x0;
+extern int gfx_read_y0;
+extern int gfx_read_x1;
+extern int gfx_read_y1;
 
 #define backbuffer gfx_backbuffer
 #define frontbuffer gfx_frontbuffer
@@ -31,22 +42,51 @@ extern volatile int gfx_full_redraw;
 #define dirty_x1 gfx_dirty_x1
 #define dirty_y1 gfx_dirty_y1
 #define full_redraw gfx_full_redraw
+#define clip_x0 gfx_clip_x0
+#define clip_y0 gfx_clip_y0
+#define clip_x1 gfx_clip_x1
+#define clip_y1 gfx_clip_y1
+#define bb_pitch gfx_bb_pitch
+#define surface_active gfx_surface_active
+#define read_x0 gfx_read_x0
+#define read_y0 gfx_read_y0
+#define read_x1 gfx_read_x1
+#define read_y1 gfx_read_y1
 
+/* Only what lies inside the clip rectangle can have changed */
 static inline void mark_dirty(int x, int y, int w, int h) {
     int x1 = x + w - 1;
     int y1 = y + h - 1;
 
+    if (x < clip_x0) x = clip_x0;
+    if (y < clip_y0) y = clip_y0;
+    if (x1 > clip_x1) x1 = clip_x1;
+    if (y1 > clip_y1) y1 = clip_y1;
+    if (x > x1 || y > y1) return;
+
     if (x < dirty_x0) dirty_x0 = x;
     if (y < dirty_y0) dirty_y0 = y;
     if (x1 > dirty_x1) dirty_x1 = x1;
     if (y1 > dirty_y1) dirty_y1 = y1;
 }
 
+/* latch.c */
+void latch_hint_sprite(const uint8_t *data, int width, int height, int bx, int by,
+                       int x, int y, int w, int h);
+void latch_drop_hints(void);
+void latch_reset(void);
+void latch_present(int x0, int y0, int x1, int y1);
+
+/* cursor.c */
+const uint8_t *cursor_compose_row(int y, int b0, int b1);
+int cursor_take_areas(int areas[2][4]);
+void cursor_reset(void);
+
 static inline void putpixel_raw(int x, int y, uint8_t color) {
     if (!backbuffer) return;
-    if (x < 0 || x >= GFX_WIDTH || y < 0 || y >= GFX_HEIGHT) return;
+    if (x < clip_x0 || x > clip_x1 || y < clip_y0 || y > clip_y1) return;
 
-    uint32_t offset = y * (GFX_WIDTH / 2) + (x / 2);
+    uint32_t offset = y * bb_pitch + (x / 2);
 
     if (x & 1) {
         backbuffer[offset] = (backbuffer[offset] & 0xF0) | (color & 0x0F);
@@ -55,11 +95,16 @@ static inline void putpixel_raw(int x, int y, uint8_t color) {
     }
 }
 
+/* What backbuffer can be read at: the screen, or a surface's area */
+static inline int readable(int x, int y) {
+    return x >= read_x0 && x <= read_x1 && y >= read_y0 && y <= read_y1;
+}
+
 static inline uint8_t getpixel_raw(int x, int y) {
     if (!backbuffer) return 0;
-    if (x < 0 || x >= GFX_WIDTH || y < 0 || y >= GFX_HEIGHT) return 0;
+    if (!readable(x, y)) return 0;
 
-    uint32_t offset = y * (GFX_WIDTH / 2) + (x / 2);
+    uint32_t offset = y * bb_pitch + (x / 2);
     uint8_t byte = backbuffer[offset];
 
     if (x & 1) {
@@ -0,0 +1,273 @@
+#include "gpriv.h"
+
+/* VGA latch copies. In write mode 1 a read loads one byte of every plane
+ * into the latches and a write stores all four, so eight pixels move from
+ * VRAM to VRAM for one read and one write, with no plane switching.
+ *
+ * The planar present uses this for cells the backbuffer says now hold
+ * what VRAM already holds somewhere else: on screen, after a window was
+ * dragged, or in the memory past the visible page, where cached bitmaps
+ * are kept as sprites. That memory is treated as rows 480 and up of the
+ * same 80-byte layout. frontbuffer and a RAM shadow of the spare rows
+ * say what every cell holds, so a copy is only made when it gives
+ * exactly the backbuffer's contents; a wrong or stale hint just leaves
+ * the cell to the normal plane writes. */
+
+#define LATCH_ROW_BYTES  (GFX_WIDTH / 8)
+#define LATCH_SPARE_ROWS (65536 / LATCH_ROW_BYTES - GFX_HEIGHT)
+#define LATCH_HINTS      32
+#define LATCH_SPRITES    32
+
+typedef struct {
+    int x, y, w, h;          /* Screen area the hint covers */
+    int sx, sy;              /* Where VRAM holds what (x, y) should show */
+    const uint8_t *sprite;   /* Cached bitmap to find in spare VRAM instead */
+    int sprite_w, sprite_h;
+    int sprite_x, sprite_y;  /* Screen position of the bitmap's pixel (0, 0) */
+} latch_hint_t;
+
+typedef struct {
+    const uint8_t *data;
+    int w, h, shift;         /* shift: bitmap x & 7 it was stored for */
+    int x, y;                /* Position of its pixel (0, 0) in spare rows */
+    int stored;              /* 0 until drawn a second time */
+} latch_sprite_t;
+
+static latch_hint_t hints[LATCH_HINTS];
+static int hint_count = 0;
+
+static latch_sprite_t sprites[LATCH_SPRITES];
+static int sprite_count = 0;
+static int shelf_x = 0, shelf_y = 0, shelf_h = 0;
+static uint8_t *shadow = NULL;
+
+/* The backbuffer area (x, y, w, h) may now show what VRAM holds at
+ * (sx, sy) on screen; x - sx must be a multiple of 8 for it to be used. */
+void gfx_hint_copy(int x, int y, int w, int h, int sx, int sy) {
+    if (hint_count >= LATCH_HINTS || surface_active) return;
+    if (w <= 0 || h <= 0 || ((x - sx) & 7)) return;
+    if (sx < 0 || sy < 0 || sx + w > GFX_WIDTH || sy + h > GFX_HEIGHT) return;
+    if (x < 0 || y < 0 || x + w > GFX_WIDTH || y + h > GFX_HEIGHT) return;
+
+    latch_hint_t *hint = &hints[hint_count++];
+    hint->x = x;
+    hint->y = y;
+    hint->w = w;
+    hint->h = h;
+    hint->sx = sx;
+    hint->sy = sy;
+    hint->sprite = NULL;
+}
+
+/* A packed bitmap of width x height was drawn with its pixel (0, 0) at
+ * (bx, by); (x, y, w, h) is the part that reached the backbuffer. */
+void latch_hint_sprite(const uint8_t *data, int width, int height, int bx, int by,
+                       int x, int y, int w, int h) {
+    if (hint_count >= LATCH_HINTS || surface_active || !data) return;
+    if (w <= 0 || h <= 0 || height > LATCH_SPARE_ROWS) return;
+
+    latch_hint_t *hint = &hints[hint_count++];
+    hint->x = x;
+    hint->y = y;
+    hint->w = w;
+    hint->h = h;
+    hint->sprite = data;
+    hint->sprite_w = width;
+    hint->sprite_h = height;
+    hint->sprite_x = bx;
+    hint->sprite_y = by;
+}
+
+void gfx_forget_bmp(const uint8_t *data) {
+    for (int i = 0; i < hint_count; i++) {
+        if (hints[i].sprite == data) hints[i].w = 0;
+    }
+    for (int i = 0; i < sprite_count; i++) {
+        if (sprites[i].data == data) sprites[i].data = NULL;
+    }
+}
+
+void latch_drop_hints(void) {
+    hint_count = 0;
+}
+
+/* Spare VRAM holds nothing known after a mode switch */
+void latch_reset(void) {
+    hint_count = 0;
+    sprite_count = 0;
+    shelf_x = shelf_y = shelf_h = 0;
+}
+
+static inline int cell_equal(const uint8_t *a, const uint8_t *b) {
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2] && a[3] == b[3];
+}
+
+/* Write a sprite, shifted right by shift pixels, into the spare rows at
+ * (x, y) with normal plane writes, and keep the shadow in step. */
+static void latch_upload(const latch_sprite_t *s) {
+    volatile uint8_t *vram = GFX_VRAM;
+    int row_bytes = (s->w + 1) / 2;
+    int cells = (s->shift + s->w + 7) / 8;
+
+    for (int row = 0; row < s->h; row++) {
+        const uint8_t *src = s->data + row * row_bytes;
+        uint8_t *dst = shadow + (s->y + row) * (GFX_WIDTH / 2) + (s->x - s->shift) / 2;
+        uint32_t vram_row = (GFX_HEIGHT + s->y + row) * LATCH_ROW_BYTES + (s->x - s->shift) / 8;
+
+        for (int c = 0; c < cells; c++) {
+            uint8_t cell[4] = { 0, 0, 0, 0 };
+            for (int p = 0; p < 8; p++) {
+                int bx = c * 8 + p - s->shift;
+                if (bx < 0 || bx >= s->w) continue;
+                uint8_t pix = (bx & 1) ? (src[bx / 2] & 0x0F) : (src[bx / 2] >> 4);
+                cell[p / 2] |= (p & 1) ? pix : (uint8_t)(pix << 4);
+            }
+            for (uint8_t plane = 0; plane < 4; plane++) {
+                outb(0x3C4, 0x02);
+                outb(0x3C5, 1 << plane);
+                vram[vram_row + c] = (uint8_t)(plane_pair_table[plane][cell[0]] << 6)
+                                   | (uint8_t)(plane_pair_table[plane][cell[1]] << 4)
+                                   | (uint8_t)(plane_pair_table[plane][cell[2]] << 2)
+                                   | (uint8_t)(plane_pair_table[plane][cell[3]] << 0);
+            }
+            dst[c * 4 + 0] = cell[0];
+            dst[c * 4 + 1] = cell[1];
+            dst[c * 4 + 2] = cell[2];
+            dst[c * 4 + 3] = cell[3];
+        }
+    }
+}
+
+/* Find the sprite stored for this bitmap at this alignment. A bitmap is
+ * only stored the second time it is drawn, so one drawn once costs
+ * nothing extra. When the slots or the spare rows run out everything is
+ * dropped and filling starts over. */
+static latch_sprite_t *latch_find_sprite(const latch_hint_t *hint) {
+    int shift = hint->sprite_x & 7;
+    latch_sprite_t *seen = NULL;
+    for (int i = 0; i < sprite_count; i++) {
+        latch_sprite_t *s = &sprites[i];
+        if (s->data == hint->sprite && s->w == hint->sprite_w &&
+            s->h == hint->sprite_h && s->shift == shift) {
+            if (s->stored) return s;
+            seen = s;
+            break;
+        }
+    }
+    if (!seen) {
+        if (sprite_count >= LATCH_SPRITES) {
+            sprite_count = 0;
+            shelf_x = shelf_y = shelf_h = 0;
+        }
+        seen = &sprites[sprite_count++];
+        seen->data = hint->sprite;
+        seen->w = hint->sprite_w;
+        seen->h = hint->sprite_h;
+        seen->shift = shift;
+        seen->stored = 0;
+        return NULL;
+    }
+
+    int span = (shift + hint->sprite_w + 7) & ~7;
+    if (span > GFX_WIDTH || hint->sprite_h > LATCH_SPARE_ROWS) return NULL;
+
+    if (shelf_x + span > GFX_WIDTH) {
+        shelf_y += shelf_h;
+        shelf_x = 0;
+        shelf_h = 0;
+    }
+    if (shelf_y + hint->sprite_h > LATCH_SPARE_ROWS) {
+        for (int i = 0; i < sprite_count; i++) sprites[i].stored = 0;
+        shelf_x = shelf_y = shelf_h = 0;
+    }
+
+    latch_sprite_t *s = seen;
+    s->stored = 1;
+    s->x = shelf_x + shift;
+    s->y = shelf_y;
+    shelf_x += span;
+    if (s->h > shelf_h) shelf_h = s->h;
+
+    latch_upload(s);
+    return s;
+}
+
+/* Copy every cell of (x0, y0)-(x1, y1) a hint can supply, before the
+ * normal plane writes. x0 and x1 (exclusive) are multiples of 8. Cells
+ * are visited so that a drag never overwrites a source it still needs. */
+void latch_present(int x0, int y0, int x1, int y1) {
+    if (hint_count == 0) return;
+    if (!frontbuffer || !plane_table_init) {
+        hint_count = 0;
+        return;
+    }
+    if (!shadow) {
+        shadow = kmalloc(LATCH_SPARE_ROWS * (GFX_WIDTH / 2));
+        if (!shadow) {
+            hint_count = 0;
+            return;
+        }
+    }
+
+    /* Sprites are stored with normal writes, so before switching modes */
+    for (int i = 0; i < hint_count; i++) {
+        latch_hint_t *hint = &hints[i];
+        if (!hint->sprite || hint->w <= 0) continue;
+        latch_sprite_t *s = latch_find_sprite(hint);
+        if (!s) {
+            hint->w = 0;
+            continue;
+        }
+        hint->sx = s->x + (hint->x - hint->sprite_x);
+        hint->sy = GFX_HEIGHT + s->y + (hint->y - hint->sprite_y);
+    }
+
+    volatile uint8_t *vram = GFX_VRAM;
+    outb(0x3CE, 0x05);
+    uint8_t mode = inb(0x3CF);
+    outb(0x3C4, 0x02);
+    outb(0x3C5, 0x0F);
+    outb(0x3CE, 0x05);
+    outb(0x3CF, (mode & ~3) | 1);
+
+    for (int i = 0; i < hint_count; i++) {
+        latch_hint_t *hint = &hints[i];
+        int dx = hint->x - hint->sx;
+        int dy = hint->y - hint->sy;
+
+        /* Whole cells inside both the hint and the area being presented */
+        int cx0 = hint->x > x0 ? (hint->x + 7) & ~7 : x0;
+        int cx1 = hint->x + hint->w < x1 ? (hint->x + hint->w) & ~7 : x1;
+        int ry0 = hint->y > y0 ? hint->y : y0;
+        int ry1 = hint->y + hint->h - 1 < y1 ? hint->y + hint->h - 1 : y1;
+        if (hint->w <= 0 || cx0 >= cx1 || ry0 > ry1) continue;
+
+        int ystep = dy > 0 ? -1 : 1;
+        int xstep = (dy == 0 && dx > 0) ? -8 : 8;
+        for (int n = 0, y = ystep > 0 ? ry0 : ry1; n <= ry1 - ry0; n++, y += ystep) {
+            int sy = y - dy;
+            const uint8_t *src_row = sy < GFX_HEIGHT
+                                   ? frontbuffer + sy * (GFX_WIDTH / 2)
+                                   : shadow + (sy - GFX_HEIGHT) * (GFX_WIDTH / 2);
+            uint32_t row = y * (GFX_WIDTH / 2);
+
+            for (int x = xstep > 0 ? cx0 : cx1 - 8; x >= cx0 && x < cx1; x += xstep) {
+                const uint8_t *want = backbuffer + row + x / 2;
+                uint8_t *have = frontbuffer + row + x / 2;
+                const uint8_t *src = src_row + (x - dx) / 2;
+                if (cell_equal(have, want) || !cell_equal(src, want)) continue;
+
+                (void)vram[sy * LATCH_ROW_BYTES + (x - dx) / 8];
+                vram[y * LATCH_ROW_BYTES + x / 8] = 0;
+                have[0] = want[0];
+                have[1] = want[1];
+                have[2] = want[2];
+                have[3] = want[3];
+            }
+        }
+    }
+
+    outb(0x3CE, 0x05);
+    outb(0x3CF, mode);
+    hint_count = 0;
+}
@@ -2,6 +2,9 @@
 #include "../../lib/string.h"
 
 uint8_t *backbuffer = NULL;
+int bb_pitch = GFX_WIDTH / 2;
+int read_x0 = 0, read_y0 = 0;
+int read_x1 = GFX_WIDTH - 1, read_y1 = GFX_HEIGHT - 1;
 int graphics_active = 0;
 uint8_t *frontbuffer = NULL;
 uint8_t plane_pair_table[4][256];
@@ -68,6 +71,12 @@ uint8_t gfx_palette[16][3] = { // osLET custom
 void gfx_set_palette_data(const uint8_t palette[16][3]) {
     memcpy_s(gfx_palette, palette, sizeof(gfx_palette));
     gfx_load_palette();
+    /* The DAC recolours the screen by itself; a true colour framebuffer
+       has to be converted again */
+    if (bga_true_color()) {
+        full_redraw = 1;
+        gfx_swap_buffers();
+    }
 }
 
 static void wait_vretrace(void) {
@@ -76,6 +85,7 @@ static void wait_vretrace(void) {
 }
 
 void gfx_load_palette(void) {
+    if (bga_is_active()) bga_load_palette(gfx_palette);
     for (int i = 0; i < 16; i++) {
         outb(0x3C8, i);
         outb(0x3C9, gfx_palette[i][0] >> 2);
@@ -115,6 +125,17 @@ void gfx_init(void) {
 }
 
 void gfx_enter_mode(void) {
+    latch_reset();
+    cursor_reset();
+    if (bga_enter() == 0) {
+        gfx_load_palette();
+        graphics_active = 1;
+        if (!backbuffer) gfx_init();
+        if (frontbuffer) memset_s(frontbuffer, 0, GFX_BUFFER_SIZE);
+        full_redraw = 1;
+        return;
+    }
+
     vga_write_regs(mode_640x480x16);
     gfx_load_palette();
     /* Clear VGA video memory so BIOS artifacts disappear immediately. Write
@@ -134,6 +155,8 @@ void gfx_enter_mode(void) {
 
 void gfx_exit_mode(void) {
     graphics_active = 0;
+    gfx_hide_cursor();
+    bga_exit();
     vga_write_regs(mode_80x25_text);
     vga_reset_textmode();
 }
@@ -145,6 +168,12 @@ int gfx_is_active(void) {
 void gfx_clear(uint8_t color) {
     if (!backbuffer) return;
     
+    if (clip_x0 != 0 || clip_y0 != 0 || clip_x1 != GFX_WIDTH - 1 || clip_y1 != GFX_HEIGHT - 1 ||
+        bb_pitch != GFX_WIDTH / 2) {
+        gfx_fillrect(clip_x0, clip_y0, clip_x1 - clip_x0 + 1, clip_y1 - clip_y0 + 1, color);
+        return;
+    }
+
     GFX_LOCK();
     uint8_t pattern = (color & 0x0F) | ((color & 0x0F) << 4);
     memset_s(backbuffer, pattern, GFX_BUFFER_SIZE);
@@ -152,49 +181,31 @@ void gfx_clear(uint8_t color) {
     GFX_UNLOCK();
 }
 
-void gfx_swap_buffers(void) {
-    if (!backbuffer) return;
-    
-    GFX_LOCK();
-    wait_vretrace();
-    
-    volatile uint8_t* vram = GFX_VRAM;
-    
-    int y0, y1, x0_aligned, x1_aligned;
-    
-    if (full_redraw) {
-        y0 = 0;
-        y1 = GFX_HEIGHT - 1;
-        x0_aligned = 0;
-        x1_aligned = GFX_WIDTH - 1;
-    } else {
-        if (dirty_x1 < dirty_x0 || dirty_y1 < dirty_y0) {
-            GFX_UNLOCK();
-            return;
-        }
-        
-        y0 = dirty_y0;
-        y1 = dirty_y1;
-        x0_aligned = dirty_x0 & ~7;
-        x1_aligned = (dirty_x1 + 7) & ~7;
-        
-        if (x1_aligned > GFX_WIDTH) x1_aligned = GFX_WIDTH;
+/* Write (x0, y0)-(x1, y1) to the screen, with the pointer merged in.
+ * x0 and x1 (exclusive) are multiples of 8. */
+static void present_area(int x0, int y0, int x1, int y1, int full) {
+    if (bga_is_active()) {
+        bga_present(x0, y0, x1, y1, full);
+        return;
     }
-    
+
+    volatile uint8_t* vram = GFX_VRAM;
+
     /* Write per-scanline and finish all planes for that scanline before moving to the next one. */
     for (int y = y0; y <= y1; y++) {
         uint32_t bb_row = y * (GFX_WIDTH / 2);
         uint32_t vram_row = y * 80;
+        const uint8_t *src = cursor_compose_row(y, x0 / 2, x1 / 2);
 
-        for (int x = x0_aligned; x < x1_aligned; x += 8) {
+        for (int x = x0; x < x1; x += 8) {
             uint32_t bb_offset = bb_row + (x / 2);
-            uint8_t b0 = backbuffer[bb_offset];
-            uint8_t b1 = backbuffer[bb_offset + 1];
-            uint8_t b2 = backbuffer[bb_offset + 2];
-            uint8_t b3 = backbuffer[bb_offset + 3];
+            uint8_t b0 = src[x / 2];
+            uint8_t b1 = src[x / 2 + 1];
+            uint8_t b2 = src[x / 2 + 2];
+            uint8_t b3 = src[x / 2 + 3];
 
             /* Skip writing if frontbuffer already matches (and not full redraw) */
-            if (!full_redraw && frontbuffer) {
+            if (!full && frontbuffer) {
                 if (frontbuffer[bb_offset] == b0 && frontbuffer[bb_offset + 1] == b1
                     && frontbuffer[bb_offset + 2] == b2 && frontbuffer[bb_offset + 3] == b3) {
                     continue;
@@ -222,13 +233,54 @@ void gfx_swap_buffers(void) {
             }
         }
     }
-    
+
     outb(0x3C4, 0x02);
     outb(0x3C5, 0x0F);
-    
+}
+
+void gfx_swap_buffers(void) {
+    if (!backbuffer) return;
+
+    /* Never present while another task has a surface as the target */
+    gfx_acquire();
+    if (surface_active) {
+        gfx_release();
+        return;
+    }
+
+    GFX_LOCK();
+    wait_vretrace();
+
+    /* A pointer that only moved costs just the cells it left and entered */
+    int cursor_areas[2][4];
+    int cursor_count = cursor_take_areas(cursor_areas);
+
+    if (full_redraw) {
+        latch_drop_hints();
+        present_area(0, 0, GFX_WIDTH, GFX_HEIGHT - 1, 1);
+        cursor_count = 0;
+    } else if (dirty_x1 >= dirty_x0 && dirty_y1 >= dirty_y0) {
+        int x0_aligned = dirty_x0 & ~7;
+        int x1_aligned = (dirty_x1 + 7) & ~7;
+        if (x1_aligned > GFX_WIDTH) x1_aligned = GFX_WIDTH;
+
+        if (bga_is_active()) latch_drop_hints();
+        else latch_present(x0_aligned, dirty_y0, x1_aligned, dirty_y1);
+        present_area(x0_aligned, dirty_y0, x1_aligned, dirty_y1, 0);
+    } else if (cursor_count == 0) {
+        GFX_UNLOCK();
+        gfx_release();
+        return;
+    }
+
+    for (int i = 0; i < cursor_count; i++)
+        present_area(cursor_areas[i][0], cursor_areas[i][1], cursor_areas[i][2], cursor_areas[i][3], 0);
+
     reset_dirty();
     GFX_UNLOCK();
+    gfx_release();
 }
+
 uint8_t* gfx_get_backbuffer(void) {
     return backbuffer;
 }
@@ -2,9 +2,9 @@
 
 void gfx_putpixel(int x, int y, uint8_t color) {
     if (!backbuffer) return;
-    if (x < 0 || x >= GFX_WIDTH || y < 0 || y >= GFX_HEIGHT) return;
+    if (x < clip_x0 || x > clip_x1 || y < clip_y0 || y > clip_y1) return;
     
-    uint32_t offset = y * (GFX_WIDTH / 2) + (x / 2);
+    uint32_t offset = y * bb_pitch + (x / 2);
     
     if (x & 1) {
         backbuffer[offset] = (backbuffer[offset] & 0xF0) | (color & 0x0F);
@@ -17,11 +17,68 @@ void gfx_putpixel(int x, int y, uint8_t color) {
 
 uint8_t gfx_getpixel(int x, int y) {
     if (!backbuffer) return 0;
-    if (x < 0 || x >= GFX_WIDTH || y < 0 || y >= GFX_HEIGHT) return 0;
-    uint32_t offset = y * (GFX_WIDTH / 2) + (x / 2);
+    if (!readable(x, y)) return 0;
+    uint32_t offset = y * bb_pitch + (x / 2);
     if (x & 1) {
         return backbuffer[offset] & 0x0F;
     } else {
         return (backbuffer[offset] >> 4) & 0x0F;
     }
 }
+
+/* Mark a rectangle for the next swap, clipped like drawing is. */
+void gfx_mark_dirty(int x, int y, int w, int h) {
+    mark_dirty(x, y, w, h);
+}
+
+/* Two mask bits, for pixels col and col + 1, as bit 1 and bit 0. */
+static inline uint8_t mask_pair(const uint8_t *bits, int col) {
+    if ((col & 7) != 7) return (bits[col >> 3] >> (6 - (col & 7))) & 3;
+    return (uint8_t)(((bits[col >> 3] & 1) << 1) | (bits[(col >> 3) + 1] >> 7));
+}
+
+/* Expand a 1bpp mask (MSB first) into the backbuffer a byte, i.e. two
+ * pixels, at a time. Set bits are drawn in fg and clear ones in bg, or
+ * left alone when bg is 0xFF. Nothing is marked dirty; the caller does
+ * that once for everything it drew. */
+void gfx_draw_mask(int x, int y, const uint8_t *mask, int width, int height, int pitch,
+                   uint8_t fg, uint8_t bg) {
+    if (!backbuffer || !mask) return;
+
+    int c0 = x < clip_x0 ? clip_x0 - x : 0;
+    int c1 = x + width > clip_x1 + 1 ? clip_x1 + 1 - x : width;
+    int r0 = y < clip_y0 ? clip_y0 - y : 0;
+    int r1 = y + height > clip_y1 + 1 ? clip_y1 + 1 - y : height;
+    if (c0 >= c1 || r0 >= r1) return;
+
+    int opaque = bg != 0xFF;
+    uint8_t f = fg & 0x0F, b = bg & 0x0F;
+    /* Indexed by mask_pair: the byte to store, or the nibbles to keep */
+    const uint8_t pattern[4] = {
+        (uint8_t)(b << 4 | b), (uint8_t)(b << 4 | f), (uint8_t)(f << 4 | b), (uint8_t)(f << 4 | f)
+    };
+    const uint8_t keep[4] = { 0xFF, 0xF0, 0x0F, 0x00 };
+    uint8_t ink = (uint8_t)(f << 4 | f);
+
+    for (int row = r0; row < r1; row++) {
+        const uint8_t *bits = mask + row * pitch;
+        uint8_t *dst = backbuffer + (y + row) * bb_pitch + (x + c0) / 2;
+        int col = c0;
+
+        if ((x + col) & 1) {
+            uint8_t on = (bits[col >> 3] >> (7 - (col & 7))) & 1;
+            if (on || opaque) *dst = (*dst & 0xF0) | (on ? f : b);
+            dst++;
+            col++;
+        }
+        for (; col + 1 < c1; col += 2, dst++) {
+            uint8_t pair = mask_pair(bits, col);
+            if (opaque) *dst = pattern[pair];
+            else if (pair) *dst = (*dst & keep[pair]) | (ink & ~keep[pair]);
+        }
+        if (col < c1) {
+            uint8_t on = (bits[col >> 3] >> (7 - (col & 7))) & 1;
+            if (on || opaque) *dst = (*dst & 0x0F) | ((on ? f : b) << 4);
+        }
+    }
+}
@@ -17,8 +17,8 @@ void gfx_line(int x0, int y0, int x1, int y1, uint8_t color) {
     int max_y = y0 > y1 ? y0 : y1;
     
     while (1) {
-        if (x0 >= 0 && x0 < GFX_WIDTH && y0 >= 0 && y0 < GFX_HEIGHT) {
-            uint32_t offset = y0 * (GFX_WIDTH / 2) + (x0 / 2);
+        if (x0 >= clip_x0 && x0 <= clip_x1 && y0 >= clip_y0 && y0 <= clip_y1) {
+            uint32_t offset = y0 * bb_pitch + (x0 / 2);
             if (x0 & 1) {
                 backbuffer[offset] = (backbuffer[offset] & 0xF0) | (color & 0x0F);
             } else {
@@ -44,17 +44,17 @@ void gfx_line(int x0, int y0, int x1, int y1, uint8_t color) {
 
 void gfx_hline(int x, int y, int w, uint8_t color) {
     if (!backbuffer) return;
-    if (y < 0 || y >= GFX_HEIGHT || w <= 0) return;
+    if (y < clip_y0 || y > clip_y1 || w <= 0) return;
 
     int x0 = x;
     int x1 = x + w - 1;
 
-    if (x0 < 0) x0 = 0;
-    if (x1 >= GFX_WIDTH) x1 = GFX_WIDTH - 1;
+    if (x0 < clip_x0) x0 = clip_x0;
+    if (x1 > clip_x1) x1 = clip_x1;
     
     if (x0 > x1) return;
 
-    uint32_t row_offset = y * (GFX_WIDTH / 2);
+    uint32_t row_offset = y * bb_pitch;
 
     /* Fast path: write two pixels at a time using full byte writes where possible */
     uint8_t pattern = (color & 0x0F) | ((color & 0x0F) << 4);
@@ -84,18 +84,18 @@ void gfx_hline(int x, int y, int w, uint8_t color) {
 
 void gfx_vline(int x, int y, int h, uint8_t color) {
     if (!backbuffer) return;
-    if (x < 0 || x >= GFX_WIDTH || h <= 0) return;
+    if (x < clip_x0 || x > clip_x1 || h <= 0) return;
 
     int y0 = y;
     int y1 = y + h - 1;
 
-    if (y0 < 0) y0 = 0;
-    if (y1 >= GFX_HEIGHT) y1 = GFX_HEIGHT - 1;
+    if (y0 < clip_y0) y0 = clip_y0;
+    if (y1 > clip_y1) y1 = clip_y1;
     
     if (y0 > y1) return;
 
     for (int py = y0; py <= y1; py++) {
-        uint32_t offset = py * (GFX_WIDTH / 2) + (x / 2);
+        uint32_t offset = py * bb_pitch + (x / 2);
         if (x & 1) {
             backbuffer[offset] = (backbuffer[offset] & 0xF0) | (color & 0x0F);
         } else {
@@ -115,10 +115,10 @@ void gfx_filltriangle(int x1, int y1, int x2, int y2, int x3, int y3, uint8_t co
     int min_y = y1 < y2 ? (y1 < y3 ? y1 : y3) : (y2 < y3 ? y2 : y3);
     int max_y = y1 > y2 ? (y1 > y3 ? y1 : y3) : (y2 > y3 ? y2 : y3);
 
-    if (min_x < 0) min_x = 0;
-    if (max_x >= GFX_WIDTH) max_x = GFX_WIDTH - 1;
-    if (min_y < 0) min_y = 0;
-    if (max_y >= GFX_HEIGHT) max_y = GFX_HEIGHT - 1;
+    if (min_x < clip_x0) min_x = clip_x0;
+    if (max_x > clip_x1) max_x = clip_x1;
+    if (min_y < clip_y0) min_y = clip_y0;
+    if (max_y > clip_y1) max_y = clip_y1;
 
     for (int y = min_y; y <= max_y; y++) {
         int x_min = GFX_WIDTH;
@@ -148,8 +148,8 @@ void gfx_filltriangle(int x1, int y1, int x2, int y2, int x3, int y3, uint8_t co
             if (x_at > x_max) x_max = x_at;
         }
 
-        if (x_min < 0) x_min = 0;
-        if (x_max > GFX_WIDTH) x_max = GFX_WIDTH;
+        if (x_min < clip_x0) x_min = clip_x0;
+        if (x_max > clip_x1) x_max = clip_x1;
 
         for (int x = x_min; x <= x_max; x++) {
             putpixel_raw(x, y, color);
@@ -177,13 +177,11 @@ void gfx_fillrect(int x, int y, int w, int h, uint8_t color) {
     int x1 = x + w - 1;
     int y1 = y + h - 1;
 
-    if (x0 >= GFX_WIDTH || y0 >= GFX_HEIGHT) return;
-    if (x1 < 0 || y1 < 0) return;
-
-    if (x0 < 0) x0 = 0;
-    if (y0 < 0) y0 = 0;
-    if (x1 >= GFX_WIDTH)  x1 = GFX_WIDTH - 1;
-    if (y1 >= GFX_HEIGHT) y1 = GFX_HEIGHT - 1;
+    if (x0 < clip_x0) x0 = clip_x0;
+    if (y0 < clip_y0) y0 = clip_y0;
+    if (x1 > clip_x1) x1 = clip_x1;
+    if (y1 > clip_y1) y1 = clip_y1;
+    if (x0 > x1 || y0 > y1) return;
 
     /* Use optimized horizontal line writer per row */
     for (int py = y0; py <= y1; py++) {
@@ -207,53 +205,14 @@ void gfx_circle(int cx, int cy, int r, uint8_t color) {
     int max_y = cy + r;
     
     while (x >= y) {
-        if (cx + x >= 0 && cx + x < GFX_WIDTH && cy + y >= 0 && cy + y < GFX_HEIGHT) {
-            uint32_t offset = (cy + y) * (GFX_WIDTH / 2) + ((cx + x) / 2);
-            if ((cx + x) & 1) backbuffer[offset] = (backbuffer[offset] & 0xF0) | (color & 0x0F);
-            else backbuffer[offset] = (backbuffer[offset] & 0x0F) | ((color & 0x0F) << 4);
-        }
-        
-        if (cx - x >= 0 && cx - x < GFX_WIDTH && cy + y >= 0 && cy + y < GFX_HEIGHT) {
-            uint32_t offset = (cy + y) * (GFX_WIDTH / 2) + ((cx - x) / 2);
-            if ((cx - x) & 1) backbuffer[offset] = (backbuffer[offset] & 0xF0) | (color & 0x0F);
-            else backbuffer[offset] = (backbuffer[offset] & 0x0F) | ((color & 0x0F) << 4);
-        }
-        
-        if (cx + x >= 0 && cx + x < GFX_WIDTH && cy - y >= 0 && cy - y < GFX_HEIGHT) {
-            uint32_t offset = (cy - y) * (GFX_WIDTH / 2) + ((cx + x) / 2);
-            if ((cx + x) & 1) backbuffer[offset] = (backbuffer[offset] & 0xF0) | (color & 0x0F);
-            else backbuffer[offset] = (backbuffer[offset] & 0x0F) | ((color & 0x0F) << 4);
-        }
-        
-        if (cx - x >= 0 && cx - x < GFX_WIDTH && cy - y >= 0 && cy - y < GFX_HEIGHT) {
-            uint32_t offset = (cy - y) * (GFX_WIDTH / 2) + ((cx - x) / 2);
-            if ((cx - x) & 1) backbuffer[offset] = (backbuffer[offset] & 0xF0) | (color & 0x0F);
-            else backbuffer[offset] = (backbuffer[offset] & 0x0F) | ((color & 0x0F) << 4);
-        }
-        
-        if (cx + y >= 0 && cx + y < GFX_WIDTH && cy + x >= 0 && cy + x < GFX_HEIGHT) {
-            uint32_t offset = (cy + x) * (GFX_WIDTH / 2) + ((cx + y) / 2);
-            if ((cx + y) & 1) backbuffer[offset] = (backbuffer[offset] & 0xF0) | (color & 0x0F);
-            else backbuffer[offset] = (backbuffer[offset] & 0x0F) | ((color & 0x0F) << 4);
-        }
-        
-        if (cx - y >= 0 && cx - y < GFX_WIDTH && cy + x >= 0 && cy + x < GFX_HEIGHT) {
-            uint32_t offset = (cy + x) * (GFX_WIDTH / 2) + ((cx - y) / 2);
-            if ((cx - y) & 1) backbuffer[offset] = (backbuffer[offset] & 0xF0) | (color & 0x0F);
-            else backbuffer[offset] = (backbuffer[offset] & 0x0F) | ((color & 0x0F) << 4);
-        }
-        
-        if (cx + y >= 0 && cx + y < GFX_WIDTH && cy - x >= 0 && cy - x < GFX_HEIGHT) {
-            uint32_t offset = (cy - x) * (GFX_WIDTH / 2) + ((cx + y) / 2);
-            if ((cx + y) & 1) backbuffer[offset] = (backbuffer[offset] & 0xF0) | (color & 0x0F);
-            else backbuffer[offset] = (backbuffer[offset] & 0x0F) | ((color & 0x0F) << 4);
-        }
-        
-        if (cx - y >= 0 && cx - y < GFX_WIDTH && cy - x >= 0 && cy - x < GFX_HEIGHT) {
-            uint32_t offset = (cy - x) * (GFX_WIDTH / 2) + ((cx - y) / 2);
-            if ((cx - y) & 1) backbuffer[offset] = (backbuffer[offset] & 0xF0) | (color & 0x0F);
-            else backbuffer[offset] = (backbuffer[offset] & 0x0F) | ((color & 0x0F) << 4);
-        }
+        putpixel_raw(cx + x, cy + y, color);
+        putpixel_raw(cx - x, cy + y, color);
+        putpixel_raw(cx + x, cy - y, color);
+        putpixel_raw(cx - x, cy - y, color);
+        putpixel_raw(cx + y, cy + x, color);
+        putpixel_raw(cx - y, cy + x, color);
+        putpixel_raw(cx + y, cy - x, color);
+        putpixel_raw(cx - y, cy - x, color);
         
         if (err <= 0) {
             y += 1;
@@ -278,10 +237,10 @@ void gfx_fillcircle(int cx, int cy, int r, uint8_t color) {
     int min_y = cy - r;
     int max_y = cy + r;
 
-    if (min_x < 0) min_x = 0;
-    if (max_x >= GFX_WIDTH) max_x = GFX_WIDTH - 1;
-    if (min_y < 0) min_y = 0;
-    if (max_y >= GFX_HEIGHT) max_y = GFX_HEIGHT - 1;
+    if (min_x < clip_x0) min_x = clip_x0;
+    if (max_x > clip_x1) max_x = clip_x1;
+    if (min_y < clip_y0) min_y = clip_y0;
+    if (max_y > clip_y1) max_y = clip_y1;
 
     int r2 = r * r;
     for (int y = min_y; y <= max_y; y++) {
@@ -6,10 +6,10 @@ void gfx_read_screen_region_packed(uint8_t *dst, int width, int height, int dest
     int row_bytes = (width + 1) / 2;
 
     /* Byte-copy only exact whole-byte regions. Odd widths include one extra pixel. */
-    if (dest_x >= 0 && dest_y >= 0 && dest_x + width <= GFX_WIDTH &&
-        dest_y + height <= GFX_HEIGHT && (dest_x & 1) == 0 && (width & 1) == 0) {
+    if (width > 0 && height > 0 && readable(dest_x, dest_y) &&
+        readable(dest_x + width - 1, dest_y + height - 1) && (dest_x & 1) == 0 && (width & 1) == 0) {
         int src_byte_x = dest_x / 2;
-        int screen_row_bytes = GFX_WIDTH / 2;
+        int screen_row_bytes = bb_pitch;
         for (int y = 0; y < height; y++) {
             uint8_t *src = backbuffer + (dest_y + y) * screen_row_bytes + src_byte_x;
             uint8_t *dst_row = dst + y * row_bytes;
@@ -26,7 +26,7 @@ void gfx_read_screen_region_packed(uint8_t *dst, int width, int height, int dest
         for (int x = 0; x < width; x++) {
             int sx = dest_x + x;
             uint8_t pix = 0;
-            if (sx >= 0 && sx < GFX_WIDTH && dy >= 0 && dy < GFX_HEIGHT) {
+            if (readable(sx, dy)) {
                 pix = gfx_getpixel(sx, dy);
             }
             int byte_idx = x / 2;
@@ -44,11 +44,11 @@ void gfx_write_screen_region_packed(uint8_t *src, int width, int height, int des
 
     int row_bytes = (width + 1) / 2;
 
-    /* Byte-copy only exact whole-byte regions. Odd widths include one extra pixel. */
-    if (dest_x >= 0 && dest_y >= 0 && dest_x + width <= GFX_WIDTH &&
-        dest_y + height <= GFX_HEIGHT && (dest_x & 1) == 0 && (width & 1) == 0) {
+    /* Byte-copy only exact whole-byte regions inside the clip. Odd widths include one extra pixel. */
+    if (dest_x >= clip_x0 && dest_y >= clip_y0 && dest_x + width <= clip_x1 + 1 &&
+        dest_y + height <= clip_y1 + 1 && (dest_x & 1) == 0 && (width & 1) == 0) {
         int dest_byte_x = dest_x / 2;
-        int screen_row_bytes = GFX_WIDTH / 2;
+        int screen_row_bytes = bb_pitch;
         for (int y = 0; y < height; y++) {
             uint8_t *dst_row = backbuffer + (dest_y + y) * screen_row_bytes + dest_byte_x;
             uint8_t *src_row = src + y * row_bytes;
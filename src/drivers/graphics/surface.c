@@ -0,0 +1,158 @@
+#include "gpriv.h"
+#include "../../task/task.h"
+
+/* A surface is an offscreen packed 4bpp image, pitch bytes per row.
+ * While one is the target, backbuffer points into it so that screen
+ * coordinates land in it, pitch is the surface's, and the clip is the
+ * area it covers. Every primitive then draws into the surface unchanged.
+ * Byte 0 of the surface holds screen pixels (x & ~1, y) and (x | 1, y). */
+
+static uint8_t *saved_backbuffer;
+static int saved_pitch;
+static int saved_clip[4];
+static int saved_dirty[4];
+int surface_active = 0;
+
+/* The drawing target, pitch, clip stack and dirty rect are shared by
+ * every task. Drawing can yield halfway, e.g. when a control loads its
+ * bitmap from disk on first draw, so a task keeps the others out of
+ * graphics for as long as it has that state set up. The lock is taken
+ * again freely by the task that holds it. */
+static volatile int gfx_lock_held = 0;
+static task_t *gfx_owner = NULL;
+static int gfx_depth = 0;
+
+void gfx_acquire(void) {
+    task_t *self = task_get_current();
+    if (gfx_lock_held && gfx_owner == self) {
+        gfx_depth++;
+        return;
+    }
+    while (__sync_lock_test_and_set(&gfx_lock_held, 1))
+        task_yield();
+    gfx_owner = self;
+    gfx_depth = 1;
+}
+
+void gfx_release(void) {
+    if (!gfx_lock_held || gfx_owner != task_get_current()) return;
+    if (--gfx_depth > 0) return;
+    gfx_owner = NULL;
+    __sync_lock_release(&gfx_lock_held);
+}
+
+/* The exception screen takes graphics from whichever task held it;
+   that task never runs again */
+void gfx_seize(void) {
+    gfx_lock_held = 1;
+    gfx_owner = task_get_current();
+    gfx_depth = 1;
+}
+
+int gfx_begin_surface(uint8_t *pixels, int pitch, int x, int y, int w, int h) {
+    if (!backbuffer || !pixels) return -1;
+    if (w <= 0 || h <= 0 || pitch < ((x & 1) + w + 1) / 2) return -1;
+    if (x < 0 || y < 0 || x + w > GFX_WIDTH || y + h > GFX_HEIGHT) return -1;
+
+    /* Held until gfx_end_surface, so no other task sees the surface as
+       the target; another task's surface is waited out */
+    gfx_acquire();
+    if (surface_active) {
+        gfx_release();
+        return -1;
+    }
+
+    saved_backbuffer = backbuffer;
+    saved_pitch = bb_pitch;
+    saved_clip[0] = clip_x0;
+    saved_clip[1] = clip_y0;
+    saved_clip[2] = clip_x1;
+    saved_clip[3] = clip_y1;
+    saved_dirty[0] = dirty_x0;
+    saved_dirty[1] = dirty_y0;
+    saved_dirty[2] = dirty_x1;
+    saved_dirty[3] = dirty_y1;
+    surface_active = 1;
+
+    backbuffer = pixels - y * pitch - x / 2;
+    bb_pitch = pitch;
+    clip_x0 = read_x0 = x;
+    clip_y0 = read_y0 = y;
+    clip_x1 = read_x1 = x + w - 1;
+    clip_y1 = read_y1 = y + h - 1;
+    return 0;
+}
+
+/* Back to the backbuffer. Nothing drawn into the surface counts as dirty. */
+void gfx_end_surface(void) {
+    if (!surface_active) return;
+    backbuffer = saved_backbuffer;
+    bb_pitch = saved_pitch;
+    clip_x0 = saved_clip[0];
+    clip_y0 = saved_clip[1];
+    clip_x1 = saved_clip[2];
+    clip_y1 = saved_clip[3];
+    dirty_x0 = saved_dirty[0];
+    dirty_y0 = saved_dirty[1];
+    dirty_x1 = saved_dirty[2];
+    dirty_y1 = saved_dirty[3];
+    read_x0 = 0;
+    read_y0 = 0;
+    read_x1 = GFX_WIDTH - 1;
+    read_y1 = GFX_HEIGHT - 1;
+    surface_active = 0;
+    gfx_release();
+}
+
+/* Copy (x, y, w, h) of the screen from a surface whose byte 0 now sits at
+ * screen pixel (ox, oy). ox may be odd, e.g. after the window it belongs
+ * to moved by an odd distance; rows are then shifted a nibble at a time.
+ * Honours the clip. */
+void gfx_blit_surface(const uint8_t *pixels, int pitch, int ox, int oy,
+                      int x, int y, int w, int h) {
+    if (!backbuffer || !pixels || surface_active) return;
+
+    int x1 = x + w - 1;
+    int y1 = y + h - 1;
+    if (x < clip_x0) x = clip_x0;
+    if (y < clip_y0) y = clip_y0;
+    if (x1 > clip_x1) x1 = clip_x1;
+    if (y1 > clip_y1) y1 = clip_y1;
+    if (x < ox) x = ox;
+    if (y < oy) y = oy;
+    if (x1 > ox + pitch * 2 - 1) x1 = ox + pitch * 2 - 1;
+    if (x > x1 || y > y1) return;
+
+    int shift = ox & 1;
+    for (int py = y; py <= y1; py++) {
+        const uint8_t *src = pixels + (py - oy) * pitch;
+        uint8_t *dst = backbuffer + py * bb_pitch;
+        int px = x;
+
+        /* Leading odd pixel, then whole bytes, then a trailing even pixel */
+        if (px & 1) {
+            int s = px - ox;
+            uint8_t c = (s & 1) ? (src[s / 2] & 0x0F) : (src[s / 2] >> 4);
+            dst[px / 2] = (dst[px / 2] & 0xF0) | c;
+            px++;
+        }
+        int bytes = (x1 + 1 - px) / 2;
+        if (bytes > 0) {
+            const uint8_t *s = src + (px - ox) / 2;
+            uint8_t *d = dst + px / 2;
+            if (!shift) {
+                memcpy_s(d, s, (size_t)bytes);
+            } else {
+                for (int i = 0; i < bytes; i++)
+                    d[i] = (uint8_t)((s[i] << 4) | (s[i + 1] >> 4));
+            }
+            px += bytes * 2;
+        }
+        if (px <= x1) {
+            int s = px - ox;
+            uint8_t c = (s & 1) ? (src[s / 2] & 0x0F) : (src[s / 2] >> 4);
+            dst[px / 2] = (dst[px / 2] & 0x0F) | (uint8_t)(c << 4);
+        }
+    }
+    mark_dirty(x, y, x1 - x + 1, y1 - y + 1);
+}
@@ -5,9 +5,6 @@
 
 #define CURSOR_MAX_W 32
 #define CURSOR_MAX_H 32
-#define CURSOR_CLEAN_PAD 2
-#define CURSOR_SAVE_W (CURSOR_MAX_W + CURSOR_CLEAN_PAD)
-#define CURSOR_SAVE_H (CURSOR_MAX_H + CURSOR_CLEAN_PAD)
 #define CURSOR_DEFAULT_PATH "C:/ICONS/default.cur"
 #define CURSOR_MOVE_PATH "C:/ICONS/move.cur"
 #define CURSOR_BUSY_PATH "C:/ICONS/hrglass.cur"
@@ -18,7 +15,6 @@ static int mouse_y = 240;
 static uint8_t mouse_buttons = 0;
 static uint8_t mouse_cycle = 0;
 static int8_t mouse_byte[3];
-static uint8_t cursor_buffer[CURSOR_SAVE_W * CURSOR_SAVE_H];
 static uint8_t *cursor_bitmap = NULL;
 static int cursor_w = 11;
 static int cursor_h = 19;
@@ -35,8 +31,9 @@ static int busy_saved_h = 19;
 static char busy_saved_path[CURSOR_PATH_MAX] = CURSOR_DEFAULT_PATH;
 static int default_cursor_checked = 0;
 static int default_cursor_missing = 0;
-static int saved_x = -1, saved_y = -1;
-static int saved_w = 0, saved_h = 0;
+static const uint8_t *shown_bitmap = NULL;
+static int shown_w = 0, shown_h = 0;
+static int shown_valid = 0;
 static int saving_cursor_background = 0;
 int buffer_valid = 0;
 
@@ -184,8 +181,10 @@ static void mouse_copy_path(char *dest, const char *src) {
 }
 
 static void mouse_free_current_bitmap(void) {
-    if (cursor_bitmap && !cursor_is_busy_cache)
+    if (cursor_bitmap && !cursor_is_busy_cache) {
         kfree(cursor_bitmap);
+        shown_valid = 0;
+    }
 
     cursor_bitmap = NULL;
     cursor_is_busy_cache = 0;
@@ -455,72 +454,58 @@ void mouse_busy_end(void) {
     mouse_show_current_cursor(1);
 }
 
-void mouse_draw_cursor(int x, int y) {
-    mouse_check_default_cursor();
+/* Hand the current shape to the graphics overlay if it is not the one
+ * already there. */
+static void mouse_update_overlay(void) {
+    uint8_t image[CURSOR_MAX_W * CURSOR_MAX_H];
 
-    if (cursor_bitmap) {
-        for (int row = 0; row < cursor_h; row++) {
-            for (int col = 0; col < cursor_w; col++) {
-                uint8_t px = mouse_cursor_pixel(col, row);
-                if (px != 5)
-                    gfx_putpixel(x + col, y + row, px);
-            }
-        }
+    if (shown_valid && shown_bitmap == cursor_bitmap && shown_w == cursor_w && shown_h == cursor_h)
         return;
-    }
 
     for (int row = 0; row < cursor_h; row++) {
         for (int col = 0; col < cursor_w; col++) {
-            uint8_t px = cursor[row][col];
-
-            if (px == 0)
-                continue;
-
-            if (px == 1)
-                gfx_putpixel(x + col, y + row, 15);
-
-            if (px == 2)
-                gfx_putpixel(x + col, y + row, 0);
+            uint8_t px;
+
+            if (cursor_bitmap) {
+                px = mouse_cursor_pixel(col, row);
+                if (px == 5)
+                    px = 0xFF;
+            } else {
+                px = cursor[row][col];
+                px = px == 1 ? 15 : px == 2 ? 0 : 0xFF;
+            }
+            image[row * cursor_w + col] = px;
         }
     }
+
+    if (gfx_set_cursor_image(image, cursor_w, cursor_h) != 0)
+        return;
+    shown_bitmap = cursor_bitmap;
+    shown_w = cursor_w;
+    shown_h = cursor_h;
+    shown_valid = 1;
+}
+
+/* The pointer is an overlay merged in by gfx_swap_buffers, so drawing it
+ * only moves it and the backbuffer never holds it. */
+void mouse_draw_cursor(int x, int y) {
+    mouse_check_default_cursor();
+    mouse_update_overlay();
+    gfx_show_cursor(x, y);
 }
 
+/* Nothing under the pointer needs saving any more; these only keep track
+ * of whether the caller has drawn it. */
 void mouse_save(int x, int y) {
+    (void)x;
+    (void)y;
     saving_cursor_background = 1;
     mouse_check_default_cursor();
     saving_cursor_background = 0;
-
-    saved_w = cursor_w + CURSOR_CLEAN_PAD;
-    saved_h = cursor_h + CURSOR_CLEAN_PAD;
-    if (saved_w > CURSOR_SAVE_W) saved_w = CURSOR_SAVE_W;
-    if (saved_h > CURSOR_SAVE_H) saved_h = CURSOR_SAVE_H;
-
-    for (int row = 0; row < saved_h; row++) {
-        for (int col = 0; col < saved_w; col++) {
-            int sx = x + col;
-            int sy = y + row;
-            if (sx >= 0 && sx < GFX_WIDTH && sy >= 0 && sy < GFX_HEIGHT)
-                cursor_buffer[row * CURSOR_SAVE_W + col] = gfx_getpixel(sx, sy);
-            else
-                cursor_buffer[row * CURSOR_SAVE_W + col] = 0;
-        }
-    }
-    saved_x = x;
-    saved_y = y;
     buffer_valid = 1;
 }
 
 void mouse_restore(void) {
-    if (!buffer_valid) return;
-
-    for (int row = 0; row < saved_h; row++) {
-        for (int col = 0; col < saved_w; col++) {
-            int sx = saved_x + col;
-            int sy = saved_y + row;
-            if (sx >= 0 && sx < GFX_WIDTH && sy >= 0 && sy < GFX_HEIGHT)
-                gfx_putpixel(sx, sy, cursor_buffer[row * CURSOR_SAVE_W + col]);
-        }
-    }
 }
 
 void mouse_invalidate_buffer(void) {
@@ -0,0 +1,41 @@
+#include "ramdisk.h"
+#include "../console.h"
+#include "../mem/heap.h"
+#include "../mem/pmm.h"
+
+/* Block device backed by kernel memory, for scratch files. Transfers are
+ * plain copies, which also makes it a zero-latency device for measuring
+ * the filesystem on its own. Its contents are lost on reboot. */
+
+static int ram_read(blkdev_t *dev, uint32_t lba, uint32_t count, void *buf) {
+    memcpy_s(buf, (uint8_t*)dev->priv + lba * BLK_SECTOR_SIZE, count * BLK_SECTOR_SIZE);
+    return 0;
+}
+
+static int ram_write(blkdev_t *dev, uint32_t lba, uint32_t count, const void *buf) {
+    memcpy_s((uint8_t*)dev->priv + lba * BLK_SECTOR_SIZE, buf, count * BLK_SECTOR_SIZE);
+    return 0;
+}
+
+/* The block layer checks every request against sector_count, so the
+ * callbacks never see one past the end. */
+blkdev_t *ramdisk_create(const char *name, uint32_t sectors) {
+    if (sectors == 0) return NULL;
+
+    uint8_t *mem = kmalloc(sectors * BLK_SECTOR_SIZE);
+    if (!mem) return NULL;
+    memset_s(mem, 0, sectors * BLK_SECTOR_SIZE);
+
+    blkdev_t *dev = blk_register(name, sectors, BLK_MAX_TRANSFER, ram_read, ram_write, mem);
+    if (!dev) kfree(mem);
+    return dev;
+}
+
+/* An eighth of free memory, capped at RAMDISK_MAX_MB. 0 if that comes to
+ * less than RAMDISK_MIN_MB. */
+uint32_t ramdisk_default_sectors(void) {
+    uint32_t mb = (uint32_t)(pmm_count_free_frames() / 8 / 256);
+    if (mb > RAMDISK_MAX_MB) mb = RAMDISK_MAX_MB;
+    if (mb < RAMDISK_MIN_MB) return 0;
+    return mb * 2048;
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <stdint.h>
+#include "blkdev.h"
+
+#define RAMDISK_DRIVE   'R'
+#define RAMDISK_MIN_MB  1
+#define RAMDISK_MAX_MB  16
+
+blkdev_t *ramdisk_create(const char *name, uint32_t sectors);
+uint32_t ramdisk_default_sectors(void);
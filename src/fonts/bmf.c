@@ -17,11 +17,7 @@ static inline uint16_t read_u16(const uint8_t **p) {
 
 static int bmf_find_sequence_for_size(bmf_font_t *font, uint8_t point_size) {
     if (!font) return -1;
-    for (int i = 0; i < font->size_count; i++) {
-        if (font->sequences[i].point_size == point_size)
-            return i;
-    }
-    return -1;
+    return (int)font->size_index[point_size] - 1;
 }
 
 static int bmf_load_from_memory(bmf_font_t *font, const uint8_t *data, size_t size) {
@@ -53,6 +49,17 @@ static int bmf_load_from_memory(bmf_font_t *font, const uint8_t *data, size_t si
     font->data = kmalloc(size);
     if (!font->data) return -1;
     memcpy_s(font->data, data, size);
+
+    /* Glyph tables, one per size, indexed by code */
+    size_t table_size = (size_t)font->size_count * BMF_MAX_GLYPHS * sizeof(bmf_glyph_t);
+    font->glyphs = kmalloc(table_size ? table_size : 1);
+    if (!font->glyphs) {
+        kfree(font->data);
+        font->data = NULL;
+        return -1;
+    }
+    memset_s(font->glyphs, 0, table_size);
+    memset_s(font->size_index, 0, sizeof(font->size_index));
     
     /* Parse all sequences */
     p = font->data + 36;
@@ -64,27 +71,33 @@ static int bmf_load_from_memory(bmf_font_t *font, const uint8_t *data, size_t si
         seq->point_size = read_u8(&p);
         seq->glyph_count = read_u16(&p);
         seq->glyph_data = (uint8_t*)p;
+        seq->glyphs = font->glyphs + s * BMF_MAX_GLYPHS;
+        if (!font->size_index[seq->point_size])
+            font->size_index[seq->point_size] = (uint8_t)(s + 1);
         
-        /* Skip glyph data for this sequence */
+        /* Index the glyphs; the first one with a code wins */
         for (uint16_t g = 0; g < seq->glyph_count; g++) {
             if ((size_t)(p - font->data) + 3 > size) break;
             
-            read_u8(&p);  // ascii
+            uint8_t code = read_u8(&p);
             uint8_t width = read_u8(&p);
             uint8_t pitch = read_u8(&p);
-            (void)width;
             
             size_t bitmap_size = pitch * seq->height;
             
             if ((size_t)(p - font->data) + bitmap_size > size) break;
+
+            bmf_glyph_t *glyph = &seq->glyphs[code];
+            if (!glyph->bitmap) {
+                glyph->ascii = code;
+                glyph->width = width;
+                glyph->pitch = pitch;
+                glyph->bitmap = p;
+            }
             p += bitmap_size;
         }
     }
     
-    /* Clear cache */
-    memset_s(font->cache, 0, sizeof(font->cache));
-    font->cache_height = 0xFF;
-    
     return 0;
 }
 
@@ -125,6 +138,10 @@ void bmf_free(bmf_font_t *font) {
         kfree(font->data);
         font->data = NULL;
     }
+    if (font && font->glyphs) {
+        kfree(font->glyphs);
+        font->glyphs = NULL;
+    }
 }
 
 const bmf_glyph_t* bmf_get_glyph(bmf_font_t *font, uint8_t point_size, uint8_t ascii) {
@@ -133,72 +150,25 @@ const bmf_glyph_t* bmf_get_glyph(bmf_font_t *font, uint8_t point_size, uint8_t a
     int seq_idx = bmf_find_sequence_for_size(font, point_size);
     if (seq_idx < 0) return NULL;
 
-    bmf_sequence_t *seq = &font->sequences[seq_idx];
-
-    /* Check cache */
-    if (font->cache_height == seq->height && ascii < BMF_CACHE_SIZE) {
-        bmf_glyph_t *cached = &font->cache[ascii];
-        if (cached->bitmap) return cached;
-    } else if (font->cache_height != seq->height) {
-        memset_s(font->cache, 0, sizeof(font->cache));
-        font->cache_height = seq->height;
-    }
-
-    const uint8_t *p = seq->glyph_data;
-    for (uint16_t i = 0; i < seq->glyph_count; i++) {
-        uint8_t code = *p++;
-        uint8_t width = *p++;
-        uint8_t pitch = *p++;
-
-        size_t bitmap_size = pitch * seq->height;
-
-        if (code == ascii) {
-            if (ascii < BMF_CACHE_SIZE) {
-                font->cache[ascii].ascii = code;
-                font->cache[ascii].width = width;
-                font->cache[ascii].pitch = pitch;
-                font->cache[ascii].bitmap = p;
-                return &font->cache[ascii];
-            }
-
-            static bmf_glyph_t temp;
-            temp.ascii = code;
-            temp.width = width;
-            temp.pitch = pitch;
-            temp.bitmap = p;
-            return &temp;
-        }
+    const bmf_glyph_t *glyph = &font->sequences[seq_idx].glyphs[ascii];
+    return glyph->bitmap ? glyph : NULL;
+}
 
-        p += bitmap_size;
-    }
+/* Blit the glyph rows without marking anything; returns the width drawn. */
+static int bmf_blit_glyph(int x, int y, const bmf_glyph_t *glyph, uint8_t height, uint8_t baseline,
+                          uint8_t fg, uint8_t bg) {
+    if (!glyph || !glyph->bitmap) return 0;
+    if (glyph->width > 100 || height > 100) return 0;
 
-    return NULL;
+    int width = glyph->width;
+    if (width > glyph->pitch * 8) width = glyph->pitch * 8;
+    gfx_draw_mask(x, y - (height - baseline), glyph->bitmap, width, height, glyph->pitch, fg, bg);
+    return width;
 }
 
 void bmf_draw_glyph(int x, int y, const bmf_glyph_t *glyph, uint8_t height, uint8_t baseline, uint8_t fg, uint8_t bg) {
-    if (!glyph || !glyph->bitmap) return;
-    if (glyph->width > 100 || height > 100) return;
-
-    const uint8_t *bitmap = glyph->bitmap;
-    int y_base = y - (height - baseline);
-
-    for (uint8_t row = 0; row < height; row++) {
-        for (uint8_t col = 0; col < glyph->width; col++) {
-            uint8_t byte_idx = col / 8;
-            uint8_t bit_idx = 7 - (col % 8);
-
-            if (row * glyph->pitch + byte_idx >= height * glyph->pitch) continue;
-
-            uint8_t byte = bitmap[row * glyph->pitch + byte_idx];
-            uint8_t pixel = (byte >> bit_idx) & 1;
-
-            if (pixel) {
-                gfx_putpixel(x + col, y_base + row, fg);
-            } else if (bg != BMF_TRANSPARENT) {
-                gfx_putpixel(x + col, y_base + row, bg);
-            }
-        }
-    }
+    int width = bmf_blit_glyph(x, y, glyph, height, baseline, fg, bg);
+    if (width > 0) gfx_mark_dirty(x, y - (height - baseline), width, height);
 }
 
 /* Draw single character at position */
@@ -244,6 +214,7 @@ typedef struct {
     uint8_t fg;
     uint8_t bg;
     int written;
+    int x0, y0, x1, y1;     /* area drawn, marked dirty once at the end */
 } bmf_ctx_t;
 
 static void bmf_emit(char ch, void *user) {
@@ -264,7 +235,14 @@ static void bmf_emit(char ch, void *user) {
 
     const bmf_glyph_t *glyph = bmf_get_glyph(ctx->font, ctx->point_size, (uint8_t)ch);
     if (glyph) {
-        bmf_draw_glyph(ctx->x, ctx->y, glyph, ctx->height, ctx->baseline, ctx->fg, ctx->bg);
+        int width = bmf_blit_glyph(ctx->x, ctx->y, glyph, ctx->height, ctx->baseline, ctx->fg, ctx->bg);
+        if (width > 0) {
+            int top = ctx->y - (ctx->height - ctx->baseline);
+            if (ctx->x < ctx->x0) ctx->x0 = ctx->x;
+            if (top < ctx->y0) ctx->y0 = top;
+            if (ctx->x + width > ctx->x1) ctx->x1 = ctx->x + width;
+            if (top + ctx->height > ctx->y1) ctx->y1 = top + ctx->height;
+        }
         ctx->x += glyph->width;
         ctx->written++;
     }
@@ -290,7 +268,11 @@ int bmf_vprintf_bg(int x, int y, bmf_font_t *font, uint8_t point_size,
         .y = y,
         .fg = fg,
         .bg = bg,
-        .written = 0
+        .written = 0,
+        .x0 = 0x7FFFFFFF,
+        .y0 = 0x7FFFFFFF,
+        .x1 = -0x7FFFFFFF,
+        .y1 = -0x7FFFFFFF
     };
 
     extern int kvprintf(const char *fmt, va_list ap, void (*emit)(char, void*), void *user);
@@ -300,6 +282,8 @@ int bmf_vprintf_bg(int x, int y, bmf_font_t *font, uint8_t point_size,
     kvprintf(fmt, cp, bmf_emit, &ctx);
     va_end(cp);
 
+    if (ctx.x1 > ctx.x0) gfx_mark_dirty(ctx.x0, ctx.y0, ctx.x1 - ctx.x0, ctx.y1 - ctx.y0);
+
     return ctx.written;
 }
 
@@ -6,24 +6,25 @@
 #define BMF_VERSION 1
 #define BMF_MAX_NAME 28
 #define BMF_MAX_SIZES 8
-#define BMF_CACHE_SIZE 128
+#define BMF_MAX_GLYPHS 256
 #define BMF_TRANSPARENT 0xFF
 
+typedef struct {
+    uint8_t ascii;
+    uint8_t width;
+    uint8_t pitch;
+    const uint8_t *bitmap;
+} bmf_glyph_t;
+
 typedef struct {
     uint8_t height;
     uint8_t baseline;
     uint8_t point_size;
     uint16_t glyph_count;
     uint8_t *glyph_data;
+    bmf_glyph_t *glyphs;    /* BMF_MAX_GLYPHS, by code; bitmap NULL if missing */
 } bmf_sequence_t;
 
-typedef struct {
-    uint8_t ascii;
-    uint8_t width;
-    uint8_t pitch;
-    const uint8_t *bitmap;
-} bmf_glyph_t;
-
 typedef struct {
     char name[BMF_MAX_NAME];
     uint8_t version;
@@ -31,8 +32,8 @@ typedef struct {
     uint16_t size_count;
     bmf_sequence_t sequences[BMF_MAX_SIZES];
     uint8_t *data;
-    bmf_glyph_t cache[BMF_CACHE_SIZE];
-    uint8_t cache_height;
+    bmf_glyph_t *glyphs;            /* tables of all sequences */
+    uint8_t size_index[256];        /* point size -> sequence + 1, 0 if none */
 } bmf_font_t;
 
 /* Core API */
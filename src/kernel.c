@@ -16,6 +16,8 @@
 #include "drivers/ata.h"
 #include "drivers/ahci.h"
 #include "drivers/usb.h"
+#include "drivers/blkdev.h"
+#include "drivers/ramdisk.h"
 #include "drivers/fat32.h"
 #include "arch/gdt.h"
 #include "win/window.h"
@@ -181,6 +183,13 @@ static void boot_sequence(void) {
     }
     printf("\n");
 
+    blk_init();
+    printf("[ ");
+    vga_set_color(0, 10);
+    printf("OK");
+    vga_set_color(0, 7);
+    printf(" ] Block devices\n");
+
     fat32_init();
        
     tasking_init();
@@ -283,6 +292,24 @@ static void boot_sequence(void) {
         for (;;) __asm__ volatile ("hlt");
     }
 
+    /* Scratch drive in memory, formatted fresh on every boot */
+    uint32_t ram_sectors = ramdisk_default_sectors();
+    blkdev_t *ram = ram_sectors ? ramdisk_create("ram0", ram_sectors) : NULL;
+    if (ram && fat32_format(ram, 0, ram_sectors, 0, "RAMDISK") == 0 &&
+        fat32_mount_device(RAMDISK_DRIVE, ram, 0) == 0) {
+        printf("[ ");
+        vga_set_color(0, 10);
+        printf("OK");
+        vga_set_color(0, 7);
+        printf(" ] RAM disk %c: (%u MB)\n", RAMDISK_DRIVE, ram_sectors / 2048);
+    } else {
+        printf("[");
+        vga_set_color(0, 8);
+        printf("SKIP");
+        vga_set_color(0, 7);
+        printf("] RAM disk\n");
+    }
+
     win_init_fonts();
     printf("[ ");
     vga_set_color(0, 10);
@@ -16,11 +16,7 @@ static inline uint16_t read_u16(const uint8_t **p) {
 
 static int usr_bmf_find_sequence_for_size(usr_bmf_font_t *font, uint8_t point_size) {
     if (!font) return -1;
-    for (int i = 0; i < font->size_count; i++) {
-        if (font->sequences[i].point_size == point_size)
-            return i;
-    }
-    return -1;
+    return (int)font->size_index[point_size] - 1;
 }
 
 static int usr_bmf_load_from_memory(usr_bmf_font_t *font, const uint8_t *data, size_t size) {
@@ -44,6 +40,16 @@ static int usr_bmf_load_from_memory(usr_bmf_font_t *font, const uint8_t *data, s
     font->data = malloc(size);
     if (!font->data) return -1;
     memcpy(font->data, data, size);
+
+    size_t table_size = (size_t)font->size_count * USR_BMF_MAX_GLYPHS * sizeof(usr_bmf_glyph_t);
+    font->glyphs = malloc(table_size ? table_size : 1);
+    if (!font->glyphs) {
+        free(font->data);
+        font->data = NULL;
+        return -1;
+    }
+    memset(font->glyphs, 0, table_size);
+    memset(font->size_index, 0, sizeof(font->size_index));
     
     p = font->data + 36;
     for (uint16_t s = 0; s < font->size_count; s++) {
@@ -54,24 +60,31 @@ static int usr_bmf_load_from_memory(usr_bmf_font_t *font, const uint8_t *data, s
         seq->point_size = read_u8(&p);
         seq->glyph_count = read_u16(&p);
         seq->glyph_data = (uint8_t*)p;
+        seq->glyphs = font->glyphs + s * USR_BMF_MAX_GLYPHS;
+        if (!font->size_index[seq->point_size])
+            font->size_index[seq->point_size] = (uint8_t)(s + 1);
         
         for (uint16_t g = 0; g < seq->glyph_count; g++) {
             if ((size_t)(p - font->data) + 3 > size) break;
             
-            read_u8(&p);
+            uint8_t code = read_u8(&p);
             uint8_t width = read_u8(&p);
             uint8_t pitch = read_u8(&p);
-            (void)width;
             
             size_t bitmap_size = pitch * seq->height;
             if ((size_t)(p - font->data) + bitmap_size > size) break;
+
+            usr_bmf_glyph_t *glyph = &seq->glyphs[code];
+            if (!glyph->bitmap) {
+                glyph->ascii = code;
+                glyph->width = width;
+                glyph->pitch = pitch;
+                glyph->bitmap = p;
+            }
             p += bitmap_size;
         }
     }
     
-    memset(font->cache, 0, sizeof(font->cache));
-    font->cache_height = 0xFF;
-    
     return 0;
 }
 
@@ -130,6 +143,10 @@ void usr_bmf_free(usr_bmf_font_t *font) {
         free(font->data);
         font->data = NULL;
     }
+    if (font && font->glyphs) {
+        free(font->glyphs);
+        font->glyphs = NULL;
+    }
 }
 
 const usr_bmf_glyph_t* usr_bmf_get_glyph(usr_bmf_font_t *font, uint8_t point_size, uint8_t ascii) {
@@ -138,45 +155,8 @@ const usr_bmf_glyph_t* usr_bmf_get_glyph(usr_bmf_font_t *font, uint8_t point_siz
     int seq_idx = usr_bmf_find_sequence_for_size(font, point_size);
     if (seq_idx < 0) return NULL;
 
-    usr_bmf_sequence_t *seq = &font->sequences[seq_idx];
-
-    if (font->cache_height == seq->height && ascii < USR_BMF_CACHE_SIZE) {
-        usr_bmf_glyph_t *cached = &font->cache[ascii];
-        if (cached->bitmap) return cached;
-    } else if (font->cache_height != seq->height) {
-        memset(font->cache, 0, sizeof(font->cache));
-        font->cache_height = seq->height;
-    }
-
-    const uint8_t *p = seq->glyph_data;
-    for (uint16_t i = 0; i < seq->glyph_count; i++) {
-        uint8_t code = *p++;
-        uint8_t width = *p++;
-        uint8_t pitch = *p++;
-
-        size_t bitmap_size = pitch * seq->height;
-
-        if (code == ascii) {
-            if (ascii < USR_BMF_CACHE_SIZE) {
-                font->cache[ascii].ascii = code;
-                font->cache[ascii].width = width;
-                font->cache[ascii].pitch = pitch;
-                font->cache[ascii].bitmap = p;
-                return &font->cache[ascii];
-            }
-
-            static usr_bmf_glyph_t temp;
-            temp.ascii = code;
-            temp.width = width;
-            temp.pitch = pitch;
-            temp.bitmap = p;
-            return &temp;
-        }
-
-        p += bitmap_size;
-    }
-
-    return NULL;
+    const usr_bmf_glyph_t *glyph = &font->sequences[seq_idx].glyphs[ascii];
+    return glyph->bitmap ? glyph : NULL;
 }
 
 static void usr_bmf_draw_glyph(int x, int y, const usr_bmf_glyph_t *glyph, 
@@ -5,24 +5,25 @@
 #define USR_BMF_VERSION 1
 #define USR_BMF_MAX_NAME 28
 #define USR_BMF_MAX_SIZES 8
-#define USR_BMF_CACHE_SIZE 128
+#define USR_BMF_MAX_GLYPHS 256
 #define USR_BMF_TRANSPARENT 0xFF
 
+typedef struct usr_bmf_glyph {
+    uint8_t ascii;
+    uint8_t width;
+    uint8_t pitch;
+    const uint8_t *bitmap;
+} usr_bmf_glyph_t;
+
 typedef struct usr_bmf_sequence {
     uint8_t height;
     uint8_t baseline;
     uint8_t point_size;
     uint16_t glyph_count;
     uint8_t *glyph_data;
+    usr_bmf_glyph_t *glyphs;    /* USR_BMF_MAX_GLYPHS, by code; bitmap NULL if missing */
 } usr_bmf_sequence_t;
 
-typedef struct usr_bmf_glyph {
-    uint8_t ascii;
-    uint8_t width;
-    uint8_t pitch;
-    const uint8_t *bitmap;
-} usr_bmf_glyph_t;
-
 typedef struct usr_bmf_font {
     char name[USR_BMF_MAX_NAME];
     uint8_t version;
@@ -30,8 +31,8 @@ typedef struct usr_bmf_font {
     uint16_t size_count;
     usr_bmf_sequence_t sequences[USR_BMF_MAX_SIZES];
     uint8_t *data;
-    usr_bmf_glyph_t cache[USR_BMF_CACHE_SIZE];
-    uint8_t cache_height;
+    usr_bmf_glyph_t *glyphs;        /* tables of all sequences */
+    uint8_t size_index[256];        /* point size -> sequence + 1, 0 if none */
 } usr_bmf_font_t;
 
 int usr_bmf_import(usr_bmf_font_t *font, const char *path);
@@ -17,6 +17,7 @@ OSLET_APP("Shell", OSLET_KIND_AGIX, "C:/ICONS/AGIX.ICO", OSLET_APP_FLAG_NONE);
 #define COLOR_DIR_FG       COLOR_YELLOW 
 
 #define MAX_ARGS 8
+#define COPY_CHUNK (256 * 1024)  /* bytes per sys_copy_range call */
 #define FAT32_MAX_PATH 256
 #define PAGE_LINES 25
 
@@ -69,8 +70,19 @@ static int paged_printf(const char *fmt, ...) {
     return len;
 }
 
+static void dirrec_to_dirent(const sys_dirrec_t *rec, sys_dirent_t *entry) {
+    strncpy(entry->name, rec->name, sizeof(entry->name) - 1);
+    entry->name[sizeof(entry->name) - 1] = '\0';
+    entry->size = rec->size;
+    entry->first_cluster = rec->first_cluster;
+    entry->mtime = rec->mtime;
+    entry->mdate = rec->mdate;
+    entry->is_directory = rec->is_directory;
+    entry->attr = rec->attr;
+}
+
 static int sys_stat(const char *path, sys_dirent_t *entry) {
-    sys_dirent_t entries[64];
+    uint32_t recs[256];
     char *last_slash = strrchr(path, '/');
     char dir_path[FAT32_MAX_PATH];
     const char *filename;
@@ -86,17 +98,24 @@ static int sys_stat(const char *path, sys_dirent_t *entry) {
         filename = path;
     }
     
-    int count = sys_readdir(dir_path, entries, 64);
-    if (count < 0) return -1;
+    int dh = sys_opendir(dir_path);
+    if (dh < 0) return -1;
     
-    for (int i = 0; i < count; i++) {
-        if (!strcasecmp(entries[i].name, filename)) {
-            if (entry) *entry = entries[i];
-            return 0;
+    int found = -1;
+    int n;
+    while (found != 0 && (n = sys_dir_read(dh, recs, sizeof(recs))) > 0) {
+        sys_dirrec_t *rec = (sys_dirrec_t*)recs;
+        for (; (uint8_t*)rec < (uint8_t*)recs + n; rec = SYS_DIRREC_NEXT(rec)) {
+            if (!strcasecmp(rec->name, filename)) {
+                if (entry) dirrec_to_dirent(rec, entry);
+                found = 0;
+                break;
+            }
         }
     }
     
-    return -1;
+    sys_closedir(dh);
+    return found;
 }
 
 static int compare_entries(const void *a, const void *b) {
@@ -123,6 +142,7 @@ static void cmd_exit(int argc, char *argv[]);
 static void cmd_mem(int argc, char *argv[]);
 static void cmd_rtc(int argc, char *argv[]);
 static void cmd_heap(int argc, char *argv[]);
+static void cmd_locks(int argc, char *argv[]);
 static void cmd_cat(int argc, char *argv[]);
 static void cmd_cd(int argc, char *argv[]);
 static void cmd_echo(int argc, char *argv[]);
@@ -141,6 +161,7 @@ static void cmd_mv(int argc, char *argv[]);
 static void cmd_ren(int argc, char *argv[]);
 static void cmd_find(int argc, char *argv[]);
 static void cmd_ver(int argc, char *argv[]);
+static void cmd_sync(int argc, char *argv[]);
 
 static const Command commands[] = {
     { "cat",    "cat <file>",          "Display file contents",      cmd_cat },
@@ -153,6 +174,7 @@ static const Command commands[] = {
     { "help",   "help",                "Show this command list",     cmd_help },
     { "dir",    "dir <path>",          "List directory",             cmd_ls },
     { "ls",     "ls <path>",           "Alias of 'dir'",             cmd_ls },
+    { "locks",  "locks",               "Show filesystem lock statistics", cmd_locks },
     { "mem",    "mem",                 "Show memory statistics",     cmd_mem },
     { "mkdir",  "mkdir <dir>",         "Create directory",           cmd_mkdir },
     { "mv",     "mv <src> <dst>",      "Alias of 'move'",            cmd_mv },
@@ -164,6 +186,7 @@ static const Command commands[] = {
     { "del",    "del <file>",          "Delete file",                cmd_rm },
     { "find",   "find <pattern>",      "Find files corresponding to pattern", cmd_find },
     { "rmdir",  "rmdir <dir>",         "Remove directory",           cmd_rmdir },
+    { "sync",   "sync",                "Write cached changes to disk", cmd_sync },
     { "ver",    "ver",                 "Display system version",     cmd_ver },
     { "time",   "time",                "Show current time and date", cmd_rtc },
     { "uptime", "uptime",              "Show system uptime",         cmd_uptime },
@@ -569,6 +592,33 @@ static void cmd_heap(int argc, char *argv[]) {
     sys_setcolor(COLOR_NORMAL_BG,COLOR_NORMAL_FG); printf("\n");
 }
 
+static void print_lockcount(const char *label, const sys_lockcount_t *c) {
+    printf("  %s", label);
+    sys_setcolor(COLOR_INFO_BG,COLOR_INFO_FG);
+                        printf("%u taken, %u contended, %u waits\n", c->acquired, c->contended, c->waits);
+    sys_setcolor(COLOR_NORMAL_BG,COLOR_NORMAL_FG);
+}
+
+static void cmd_locks(int argc, char *argv[]) {
+    (void)argc; (void)argv;
+    sys_fslockinfo_t info;
+    if (sys_get_fslockinfo(&info) != 0) {
+        printf("Error getting lock info\n");
+        return;
+    }
+    printf("\nFilesystem lock statistics:\n\n");
+    print_lockcount("Tables: ", &info.table);
+    print_lockcount("Directory cache: ", &info.dcache);
+    print_lockcount("Open files: ", &info.files);
+    for (int i = 0; i < SYS_FS_MAX_VOLUMES; i++) {
+        if (!info.volume_drive[i]) continue;
+        char label[16];
+        snprintf(label, sizeof(label), "Volume %c: ", info.volume_drive[i]);
+        print_lockcount(label, &info.volume[i]);
+    }
+    printf("\n");
+}
+
 static void cmd_cls(int argc, char *argv[]) {
     (void)argc; (void)argv;
     sys_clear();
@@ -584,18 +634,21 @@ static int copy_file(const char *src, const char *dst) {
         return -2;
     }
 
-    char buf[512];
+    /* Keep the copy in one piece on disk */
+    sys_dirent_t st;
+    if (sys_stat(src, &st) == 0 && st.size > 0)
+        sys_preallocate(fd_dst, st.size);
+
     int n;
     int total = 0;
 
-    while ((n = sys_read(fd_src, buf, sizeof(buf))) > 0) {
-        if (sys_write_file(fd_dst, buf, n) != n) {
-            sys_close(fd_src);
-            sys_close(fd_dst);
-            sys_unlink(dst);
-            return -3;
-        }
+    while ((n = sys_copy_range(fd_src, fd_dst, COPY_CHUNK)) > 0)
         total += n;
+    if (n < 0) {
+        sys_close(fd_src);
+        sys_close(fd_dst);
+        sys_unlink(dst);
+        return -3;
     }
 
     sys_close(fd_src);
@@ -629,18 +682,23 @@ static int expand_pattern(const char *pattern, char matches[][FAT32_MAX_PATH], i
     const char *pat;
     split_path_pattern(pattern, dir, sizeof(dir), &pat);
 
-    sys_dirent_t entries[128];
-    int count = sys_readdir(dir, entries, 128);
-    if (count < 0) return -1;
+    int dh = sys_opendir(dir);
+    if (dh < 0) return -1;
 
+    uint32_t recs[256];
     int found = 0;
-    for (int i = 0; i < count && found < max_matches; i++) {
-        if (entries[i].is_directory) continue;
-        if (str_match_wildcard(pat, entries[i].name)) {
-            snprintf(matches[found], FAT32_MAX_PATH, "%s%s", dir, entries[i].name);
-            found++;
+    int n;
+    while (found < max_matches && (n = sys_dir_read(dh, recs, sizeof(recs))) > 0) {
+        sys_dirrec_t *rec = (sys_dirrec_t*)recs;
+        for (; (uint8_t*)rec < (uint8_t*)recs + n && found < max_matches; rec = SYS_DIRREC_NEXT(rec)) {
+            if (rec->is_directory) continue;
+            if (str_match_wildcard(pat, rec->name)) {
+                snprintf(matches[found], FAT32_MAX_PATH, "%s%s", dir, rec->name);
+                found++;
+            }
         }
     }
+    sys_closedir(dh);
     return found;
 }
 
@@ -1306,6 +1364,16 @@ static void cmd_mkdir(int argc, char *argv[]) {
     }
 }
 
+static void cmd_sync(int argc, char *argv[]) {
+    (void)argc; (void)argv;
+
+    if (sys_sync() != 0) {
+        sys_setcolor(COLOR_ERROR_BG, COLOR_ERROR_FG);
+        printf("Error: some changes could not be written\n");
+        sys_setcolor(COLOR_NORMAL_BG, COLOR_NORMAL_FG);
+    }
+}
+
 static void cmd_rm(int argc, char *argv[]) {
     if (argc < 2) {
         sys_setcolor(COLOR_ERROR_BG, COLOR_ERROR_FG);
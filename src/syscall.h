@@ -45,6 +45,10 @@ static inline int sys_proc_set_icon(int tid, const char *icon_path) {
 #define SYS_FILE_SEEK       0x0304
 #define SYS_FILE_DELETE     0x0305
 #define SYS_FILE_RENAME     0x0306
+#define SYS_FILE_COPY       0x0307
+#define SYS_FILE_PREALLOC   0x0308
+#define SYS_FILE_FSYNC      0x0309
+#define SYS_FILE_SYNC       0x030A
 
 /* AH = 04h - Directory Operations */
 #define SYS_DIR_CHDIR       0x0400
@@ -52,6 +56,9 @@ static inline int sys_proc_set_icon(int tid, const char *icon_path) {
 #define SYS_DIR_MKDIR       0x0402
 #define SYS_DIR_RMDIR       0x0403
 #define SYS_DIR_LIST        0x0404
+#define SYS_DIR_OPEN        0x0405
+#define SYS_DIR_READ        0x0406
+#define SYS_DIR_CLOSE       0x0407
 
 /* AH = 05h - IPC */
 #define SYS_IPC_SEND        0x0500
@@ -76,6 +83,7 @@ static inline int sys_proc_set_icon(int tid, const char *icon_path) {
 #define SYS_INFO_CPU        0x0806  /* Returns vendor, model and MHz */
 #define SYS_INFO_REQUEST_TEXTMODE 0x0807
 #define SYS_INFO_TAKE_TEXTMODE_REQUEST 0x0808
+#define SYS_INFO_FSLOCKS    0x0809  /* FAT32 lock contention counters */
 
 /* AH = 09h - Graphics */
 #define SYS_GFX_ENTER       0x0900
@@ -498,6 +506,22 @@ typedef struct {
     uint8_t attr;
 } sys_dirent_t;
 
+/* Record filled in by SYS_DIR_READ. Records are packed back to back in
+ * the caller's buffer, each padded to 4 bytes; reclen is the distance to
+ * the next one. */
+typedef struct {
+    uint32_t size;
+    uint32_t first_cluster;
+    uint16_t reclen;
+    uint16_t mtime;
+    uint16_t mdate;
+    uint8_t is_directory;
+    uint8_t attr;
+    char name[];     /* NUL terminated */
+} sys_dirrec_t;
+
+#define SYS_DIRREC_NEXT(rec) ((sys_dirrec_t*)((uint8_t*)(rec) + (rec)->reclen))
+
 typedef struct {
     uint32_t total_kb;
     uint32_t free_kb;
@@ -528,6 +552,22 @@ typedef struct {
     uint32_t mhz; /* MHz */
 } sys_cpuinfo_t;
 
+#define SYS_FS_MAX_VOLUMES 4
+
+typedef struct {
+    uint32_t acquired;
+    uint32_t contended;  /* acquisitions that had to wait */
+    uint32_t waits;      /* yields spent waiting */
+} sys_lockcount_t;
+
+typedef struct {
+    sys_lockcount_t table;
+    sys_lockcount_t dcache;
+    sys_lockcount_t files;
+    sys_lockcount_t volume[SYS_FS_MAX_VOLUMES];
+    uint8_t volume_drive[SYS_FS_MAX_VOLUMES];  /* 0 if unmounted */
+} sys_fslockinfo_t;
+
 typedef struct {
     int x0, y0, x1, y1;
 } gfx_line_params_t;
@@ -706,6 +746,40 @@ static inline int sys_rename(const char *oldpath, const char *newpath) {
     return ret;
 }
 
+/* Copies up to max bytes from src_fd's position to dst_fd's without leaving
+ * the kernel. Returns the number of bytes copied, 0 once the source is at
+ * its end, -1 on error. Call it in a loop with a bounded max to report
+ * progress between calls. */
+static inline int sys_copy_range(int src_fd, int dst_fd, uint32_t max) {
+    int ret;
+    __asm__ volatile("int $0x80" : "=a"(ret) : "a"(SYS_FILE_COPY), "b"(src_fd), "c"(dst_fd), "d"(max));
+    return ret;
+}
+
+/* Reserves contiguous space for the first size bytes of a file opened for
+ * writing, so it does not fragment while it grows. The file size is left
+ * alone and unused space is released on close. */
+static inline int sys_preallocate(int fd, uint32_t size) {
+    int ret;
+    __asm__ volatile("int $0x80" : "=a"(ret) : "a"(SYS_FILE_PREALLOC), "b"(fd), "c"(size));
+    return ret;
+}
+
+/* File data and metadata are written back in the background a few
+ * seconds after they change. sys_fsync returns once everything written
+ * through fd is on the disk; sys_sync does the same for all files. */
+static inline int sys_fsync(int fd) {
+    int ret;
+    __asm__ volatile("int $0x80" : "=a"(ret) : "a"(SYS_FILE_FSYNC), "b"(fd));
+    return ret;
+}
+
+static inline int sys_sync(void) {
+    int ret;
+    __asm__ volatile("int $0x80" : "=a"(ret) : "a"(SYS_FILE_SYNC));
+    return ret;
+}
+
 static inline int sys_chdir(const char *path) {
     int ret;
     __asm__ volatile("int $0x80" : "=a"(ret) : "a"(SYS_DIR_CHDIR), "b"(path));
@@ -736,6 +810,28 @@ static inline int sys_readdir(const char *path, sys_dirent_t *entries, int max)
     return ret;
 }
 
+/* Returns a directory handle, or -1 */
+static inline int sys_opendir(const char *path) {
+    int ret;
+    __asm__ volatile("int $0x80" : "=a"(ret) : "a"(SYS_DIR_OPEN), "b"(path));
+    return ret;
+}
+
+/* Fills buf with as many sys_dirrec_t records as fit and returns the number
+ * of bytes used: 0 at the end of the directory, -1 on error or if not even
+ * one record fits */
+static inline int sys_dir_read(int dh, void *buf, int size) {
+    int ret;
+    __asm__ volatile("int $0x80" : "=a"(ret) : "a"(SYS_DIR_READ), "b"(dh), "c"(buf), "d"(size) : "memory");
+    return ret;
+}
+
+static inline int sys_closedir(int dh) {
+    int ret;
+    __asm__ volatile("int $0x80" : "=a"(ret) : "a"(SYS_DIR_CLOSE), "b"(dh));
+    return ret;
+}
+
 static inline int sys_send_msg(uint32_t to_tid, const void *data, uint32_t size) {
     int ret;
     __asm__ volatile("int $0x80" : "=a"(ret) : "a"(SYS_IPC_SEND), "b"(to_tid), "c"(data), "d"(size));
@@ -772,6 +868,12 @@ static inline int sys_get_heapinfo(sys_heapinfo_t *info) {
     return ret;
 }
 
+static inline int sys_get_fslockinfo(sys_fslockinfo_t *info) {
+    int ret;
+    __asm__ volatile("int $0x80" : "=a"(ret) : "a"(SYS_INFO_FSLOCKS), "b"(info) : "memory");
+    return ret;
+}
+
 static inline int sys_get_tasks(sys_taskinfo_t *tasks, int max) {
     int ret;
     __asm__ volatile("int $0x80" : "=a"(ret) : "a"(SYS_INFO_TASKS), "b"(tasks), "c"(max) : "memory");
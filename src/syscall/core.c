@@ -157,6 +157,47 @@ static void fd_free(int fd) {
     FD_CRITICAL_END;
 }
 
+typedef struct {
+    fat32_dir_t *dir;
+    int in_use;
+    uint32_t owner_tid;
+    int has_pending;
+    fat32_dirent_t pending;  /* read from the cursor but not yet delivered */
+} dir_handle_t;
+
+static dir_handle_t dir_table[FAT32_MAX_OPEN_DIRS];
+
+static int dh_alloc(fat32_dir_t *dir) {
+    task_t *current = task_get_current();
+    uint32_t tid = current ? current->tid : 0;
+
+    FD_CRITICAL_BEGIN;
+    for (int i = 0; i < FAT32_MAX_OPEN_DIRS; i++) {
+        if (!dir_table[i].in_use) {
+            dir_table[i].dir = dir;
+            dir_table[i].in_use = 1;
+            dir_table[i].owner_tid = tid;
+            dir_table[i].has_pending = 0;
+            FD_CRITICAL_END;
+            return i;
+        }
+    }
+    FD_CRITICAL_END;
+    return -1;
+}
+
+static dir_handle_t* dh_get(int dh) {
+    if (dh < 0 || dh >= FAT32_MAX_OPEN_DIRS) return NULL;
+    FD_CRITICAL_BEGIN;
+    task_t *current = task_get_current();
+    if (!dir_table[dh].in_use || (current && dir_table[dh].owner_tid != current->tid)) {
+        FD_CRITICAL_END;
+        return NULL;
+    }
+    FD_CRITICAL_END;
+    return &dir_table[dh];
+}
+
 /* Cleanup all file descriptors owned by a task (called on task exit) */
 void fd_cleanup_task(uint32_t tid) {
     fat32_file_t *to_close[MAX_OPEN_FILES];
@@ -178,6 +219,23 @@ void fd_cleanup_task(uint32_t tid) {
     for (int i = 0; i < close_count; i++) {
         fat32_close(to_close[i]);
     }
+
+    fat32_dir_t *dirs_to_close[FAT32_MAX_OPEN_DIRS];
+    int dir_count = 0;
+
+    eflags = sys_irq_save();
+    for (int i = 0; i < FAT32_MAX_OPEN_DIRS; i++) {
+        if (dir_table[i].in_use && dir_table[i].owner_tid == tid) {
+            dirs_to_close[dir_count++] = dir_table[i].dir;
+            dir_table[i].in_use = 0;
+            dir_table[i].dir = NULL;
+        }
+    }
+    sys_irq_restore(eflags);
+
+    for (int i = 0; i < dir_count; i++) {
+        fat32_closedir(dirs_to_close[i]);
+    }
 }
 
 static uint32_t handle_console(uint32_t al, uint32_t ebx, uint32_t ecx, uint32_t edx) {
@@ -439,6 +497,34 @@ static uint32_t handle_file(uint32_t al, uint32_t ebx, uint32_t ecx, uint32_t ed
             int result = fat32_rename(path, path2);
             return (uint32_t)result;
         }
+
+        case 0x07: {
+            fat32_file_t *src = fd_get((int)ebx);
+            fat32_file_t *dst = fd_get((int)ecx);
+            if (!src || !dst) return (uint32_t)-1;
+
+            int result = fat32_copy(dst, src, edx);
+            return (uint32_t)result;
+        }
+
+        case 0x08: {
+            fat32_file_t *file = fd_get((int)ebx);
+            if (!file) return (uint32_t)-1;
+
+            int result = fat32_preallocate(file, ecx);
+            return (uint32_t)result;
+        }
+
+        case 0x09: {
+            fat32_file_t *file = fd_get((int)ebx);
+            if (!file) return (uint32_t)-1;
+
+            int result = fat32_flush(file);
+            return (uint32_t)result;
+        }
+
+        case 0x0A:
+            return (uint32_t)fat32_sync();
             
         default:
             return (uint32_t)-1;
@@ -475,30 +561,84 @@ static uint32_t handle_dir(uint32_t al, uint32_t ebx, uint32_t ecx, uint32_t edx
         
         case 0x04: {
             if (sys_copy_string(path, ebx, sizeof(path)) != 0) return -1;
-            if (edx > 256) edx = 256;
-            if (edx == 0 || !sys_range_mapped(ecx, sizeof(sys_dirent_t) * edx)) return -1;
-            fat32_dirent_t *fat_entries = (fat32_dirent_t*)kmalloc(sizeof(fat32_dirent_t) * edx);
-            if (!fat_entries) return -1;
-            
-            int count = fat32_list_dir(path, fat_entries, (int)edx);
+            if (edx == 0 || edx > 0xFFFF || !sys_range_mapped(ecx, sizeof(sys_dirent_t) * edx)) return -1;
+            fat32_dir_t *dir = fat32_opendir(path);
+            if (!dir) return -1;
             
-            if (count > 0) {
-                sys_dirent_t *sys_entries = (sys_dirent_t*)ecx;
-                int max_copy = (count < (int)edx) ? count : (int)edx;
-                for (int i = 0; i < max_copy; i++) {
-                    memcpy_s(sys_entries[i].name, fat_entries[i].name, sizeof(sys_entries[i].name));
-                    sys_entries[i].size = fat_entries[i].size;
-                    sys_entries[i].first_cluster = fat_entries[i].first_cluster;
-                    sys_entries[i].mtime = fat_entries[i].mtime;
-                    sys_entries[i].mdate = fat_entries[i].mdate;
-                    sys_entries[i].is_directory = fat_entries[i].is_directory;
-                    sys_entries[i].attr = fat_entries[i].attr;
-                }
+            /* Stream straight into the caller's array */
+            sys_dirent_t *sys_entries = (sys_dirent_t*)ecx;
+            fat32_dirent_t e;
+            int count = 0;
+            while (count < (int)edx && fat32_readdir(dir, &e) == 1) {
+                memcpy_s(sys_entries[count].name, e.name, sizeof(sys_entries[count].name));
+                sys_entries[count].size = e.size;
+                sys_entries[count].first_cluster = e.first_cluster;
+                sys_entries[count].mtime = e.mtime;
+                sys_entries[count].mdate = e.mdate;
+                sys_entries[count].is_directory = e.is_directory;
+                sys_entries[count].attr = e.attr;
+                count++;
             }
             
-            kfree(fat_entries);
+            fat32_closedir(dir);
             return count;
         }
+        
+        case 0x05: {
+            if (sys_copy_string(path, ebx, sizeof(path)) != 0) return -1;
+            fat32_dir_t *dir = fat32_opendir(path);
+            if (!dir) return -1;
+            int dh = dh_alloc(dir);
+            if (dh < 0) fat32_closedir(dir);
+            return dh;
+        }
+        
+        case 0x06: {
+            if (edx == 0 || !sys_range_mapped(ecx, edx)) return -1;
+            dir_handle_t *h = dh_get((int)ebx);
+            if (!h) return -1;
+            
+            uint8_t *out = (uint8_t*)ecx;
+            uint32_t used = 0;
+            for (;;) {
+                if (!h->has_pending) {
+                    int rc = fat32_readdir(h->dir, &h->pending);
+                    if (rc < 0) return used ? used : (uint32_t)-1;
+                    if (rc == 0) break;
+                    h->has_pending = 1;
+                }
+                
+                uint32_t namelen = strlen_s(h->pending.name);
+                uint32_t reclen = (offsetof(sys_dirrec_t, name) + namelen + 1 + 3) & ~3u;
+                if (reclen > edx - used) {
+                    if (used == 0) return -1;
+                    break;
+                }
+                
+                sys_dirrec_t *rec = (sys_dirrec_t*)(out + used);
+                rec->size = h->pending.size;
+                rec->first_cluster = h->pending.first_cluster;
+                rec->reclen = (uint16_t)reclen;
+                rec->mtime = h->pending.mtime;
+                rec->mdate = h->pending.mdate;
+                rec->is_directory = h->pending.is_directory;
+                rec->attr = h->pending.attr;
+                memcpy_s(rec->name, h->pending.name, namelen + 1);
+                used += reclen;
+                h->has_pending = 0;
+            }
+            return used;
+        }
+        
+        case 0x07: {
+            dir_handle_t *h = dh_get((int)ebx);
+            if (!h) return -1;
+            fat32_dir_t *dir = h->dir;
+            h->in_use = 0;
+            h->dir = NULL;
+            fat32_closedir(dir);
+            return 0;
+        }
             
         default:
             return -1;
@@ -1066,6 +1206,30 @@ static __attribute__((noinline, noclone)) uint32_t handle_info(uint32_t al, uint
             return pending;
         }
 
+        case 0x09: { /* SYS_INFO_FSLOCKS */
+            if (!sys_range_mapped(ebx, sizeof(sys_fslockinfo_t))) return -1;
+            sys_fslockinfo_t *out = (sys_fslockinfo_t*)ebx;
+            fat32_lock_stats_t st;
+            fat32_lock_stats(&st);
+
+            out->table.acquired = st.table.acquired;
+            out->table.contended = st.table.contended;
+            out->table.waits = st.table.waits;
+            out->dcache.acquired = st.dcache.acquired;
+            out->dcache.contended = st.dcache.contended;
+            out->dcache.waits = st.dcache.waits;
+            out->files.acquired = st.files.acquired;
+            out->files.contended = st.files.contended;
+            out->files.waits = st.files.waits;
+            for (int i = 0; i < SYS_FS_MAX_VOLUMES && i < FAT32_MAX_VOLUMES; i++) {
+                out->volume[i].acquired = st.volume[i].acquired;
+                out->volume[i].contended = st.volume[i].contended;
+                out->volume[i].waits = st.volume[i].waits;
+                out->volume_drive[i] = st.volume_drive[i];
+            }
+            return 0;
+        }
+
         default:
             return -1;
     }
@@ -1213,7 +1377,7 @@ static uint32_t handle_graphics(uint32_t al, uint32_t ebx,
             int x = (int)(ecx >> 16);
             int y = (int)(ecx & 0xFFFF);
             graphics_begin_draw();
-            gfx_draw_cached_bmp_ex(bmp.data, bmp.width, bmp.height, x, y, (int)edx);
+            gfx_draw_kept_bmp(bmp.data, bmp.width, bmp.height, x, y, (int)edx);
             return 0;
         }
 
@@ -1221,6 +1385,7 @@ static uint32_t handle_graphics(uint32_t al, uint32_t ebx,
             if (!sys_range_mapped(ebx, sizeof(cached_bmp_t))) return (uint32_t)-1;
             cached_bmp_t *bmp = (cached_bmp_t*)ebx;
             if (bmp->data) {
+                gfx_forget_bmp(bmp->data);
                 kfree(bmp->data);
                 bmp->data = 0;
                 bmp->width = 0;
@@ -1470,6 +1635,8 @@ static uint32_t handle_power(uint32_t al, uint32_t ebx, uint32_t ecx, uint32_t e
 
     switch (al) {
         case 0x00: { /* SYS_POWER_SHUTDOWN */
+            /* Metadata may still be waiting for the flusher */
+            fat32_sync();
             __asm__ volatile("cli");
 
             /* Try ACPI shutdown (QEMU, modern hardware) */
@@ -1494,6 +1661,7 @@ static uint32_t handle_power(uint32_t al, uint32_t ebx, uint32_t ecx, uint32_t e
         }
 
         case 0x01: { /* SYS_POWER_REBOOT */
+            fat32_sync();
             __asm__ volatile("cli");
 
             /* The keyboard controller reset works on many old PC targets. */
@@ -1595,9 +1763,18 @@ uint32_t syscall_handler(uint32_t eax, uint32_t ebx, uint32_t ecx, uint32_t edx)
         case 0x06: return handle_memory(al, ebx, ecx, edx);
         case 0x07: return handle_time(al, ebx, ecx, edx);
         case 0x08: return handle_info(al, ebx, ecx, edx);
-        case 0x09: return handle_graphics(al, ebx, ecx, edx);
-        case 0x0A: return handle_mouse(al, ebx, ecx, edx);
-        case 0x0B: return handle_window(al, ebx, ecx, edx);
+        case 0x09:
+        case 0x0A:
+        case 0x0B: {
+            /* Graphics state is shared; see gfx_acquire */
+            uint32_t ret;
+            gfx_acquire();
+            if (ah == 0x09) ret = handle_graphics(al, ebx, ecx, edx);
+            else if (ah == 0x0A) ret = handle_mouse(al, ebx, ecx, edx);
+            else ret = handle_window(al, ebx, ecx, edx);
+            gfx_release();
+            return ret;
+        }
         case 0x0C: return handle_power(al, ebx, ecx, edx);
         case 0x0E: return handle_sound(al, ebx, ecx);
         case 0x0F: return handle_vconsole(al, ebx, ecx, edx);
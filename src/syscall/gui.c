@@ -36,6 +36,7 @@ void gui_invalidate_saved_backgrounds(window_manager_t *wm) {
             f->win.saved_bg = NULL;
         }
         f->win.dirty = 1;
+        compositor_invalidate_form(f);
 
         if (f->controls) {
             for (int j = 0; j < f->ctrl_count; j++) {
@@ -270,6 +271,7 @@ uint32_t handle_window(uint32_t al, uint32_t ebx,
             gui_control_t *ctrl = (gui_control_t*)ecx;
 
             if (!form || !ctrl) return 0;
+            compositor_invalidate_form(form);
 
             /* Allocate or expand controls array */
             if (!form->controls) {
@@ -549,6 +551,7 @@ uint32_t handle_window(uint32_t al, uint32_t ebx,
             const char *icon_path = (const char*)ecx;
 
             if (!form || !icon_path) return 0;
+            compositor_invalidate_form(form);
 
             /* Store icon path for later use when minimizing */
             strcpy_s(form->icon_path, icon_path, 64);
@@ -595,6 +598,7 @@ uint32_t handle_window(uint32_t al, uint32_t ebx,
         }
 
         case 0x0C: { /* SYS_WIN_REDRAW_ALL */
+            compositor_invalidate_all(&global_wm);
             if (global_wm.backgrounds_invalid) {
                 gui_invalidate_saved_backgrounds(&global_wm);
                 if (!global_wm.needs_full_redraw) {
@@ -626,6 +630,7 @@ uint32_t handle_window(uint32_t al, uint32_t ebx,
             uint32_t value = edx;
 
             if (!form) return 0;
+            compositor_invalidate_form(form);
 
             /* Find control */
             gui_control_t *ctrl = NULL;
@@ -1184,6 +1189,7 @@ uint32_t handle_window(uint32_t al, uint32_t ebx,
         case 0x1A: { /* SYS_WIN_MARK_DIRTY - mark window region as dirty and trigger compositor redraw with z-order */
             gui_form_t *form = (gui_form_t*)ebx;
             if (!form || !form->win.is_visible || form->win.is_minimized) return 0;
+            compositor_invalidate_form(form);
 
             int wx = form->win.x - WM_BG_MARGIN;
             int wy = form->win.y - WM_BG_MARGIN;
@@ -1208,6 +1214,17 @@ uint32_t handle_window(uint32_t al, uint32_t ebx,
             if (rw <= 0 || rh <= 0) return 0;
             if (rx + rw > WM_SCREEN_WIDTH) rw = WM_SCREEN_WIDTH - rx;
             if (ry + rh > WM_SCREEN_HEIGHT) rh = WM_SCREEN_HEIGHT - ry;
+
+            /* The caller's own windows under the rect may have changed (a
+               clock ticking, say); anyone else's are only being uncovered */
+            task_t *caller = task_get_current();
+            for (int i = 0; caller && i < global_wm.count; i++) {
+                gui_form_t *f = global_wm.windows[i];
+                if (f && f->owner_tid == caller->tid &&
+                    rx < f->win.x + f->win.w && f->win.x < rx + rw &&
+                    ry < f->win.y + f->win.h && f->win.y < ry + rh)
+                    compositor_invalidate_form(f);
+            }
             compositor_set_dirty_rect(&global_wm, rx, ry, rw, rh);
             compositor_draw_all(&global_wm);
             return 0;
@@ -1218,6 +1235,7 @@ uint32_t handle_window(uint32_t al, uint32_t ebx,
             if (!form) return 0;
             menubar_init(&form->menubar);
             form->menubar_enabled = 1;
+            compositor_invalidate_form(form);
             return 0;
         }
 
@@ -1226,6 +1244,7 @@ uint32_t handle_window(uint32_t al, uint32_t ebx,
             const char *title = (const char*)ecx;
             if (!form || !title) return (uint32_t)-1;
             if (!form->menubar_enabled) return (uint32_t)-1;
+            compositor_invalidate_form(form);
             return (uint32_t)menubar_add_menu(&form->menubar, title);
         }
 
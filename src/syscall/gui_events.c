@@ -636,6 +636,8 @@ uint32_t sys_win_pump_events_kernel(gui_form_t *form) {
 
         if (dx != 0 || dy != 0) {
             int had_saved_bg = form->win.saved_bg != NULL;
+            int old_x = form->win.x;
+            int old_y = form->win.y;
             win_move(&form->win, dx, dy);
             form->drag_start_x = mx;
             form->drag_start_y = my;
@@ -644,6 +646,7 @@ uint32_t sys_win_pump_events_kernel(gui_form_t *form) {
             }
             mouse_restore();
             compositor_draw_all(&global_wm);
+            gfx_hint_copy(form->win.x, form->win.y, form->win.w, form->win.h, old_x, old_y);
             needs_redraw = 0;  /* Already drawn */
         }
     }
@@ -81,20 +81,21 @@ void bitmap_draw(bitmap_t *bmp, int x, int y) {
     if (!bmp || !bmp->data) return;
 
     /* Draw with transparency (default) */
-    gfx_draw_cached_bmp(bmp->data, bmp->width, bmp->height, x, y);
+    gfx_draw_kept_bmp(bmp->data, bmp->width, bmp->height, x, y, 1);
 }
 
 void bitmap_draw_opaque(bitmap_t *bmp, int x, int y) {
     if (!bmp || !bmp->data) return;
 
     /* Draw without transparency (force all pixels drawn) */
-    gfx_draw_cached_bmp_ex(bmp->data, bmp->width, bmp->height, x, y, 0);
+    gfx_draw_kept_bmp(bmp->data, bmp->width, bmp->height, x, y, 0);
 }
 
 void bitmap_free(bitmap_t *bmp) {
     if (!bmp) return;
 
     if (bmp->data) {
+        gfx_forget_bmp(bmp->data);
         kfree(bmp->data);
         bmp->data = NULL;
     }
@@ -8,6 +8,7 @@
 #include "wm_config.h"
 #include "wm.h"
 #include "../drivers/mouse.h"
+#include "../drivers/graphics.h"
 #include "../mem/heap.h"
 
 static void compositor_draw_controls(gui_form_t *form) {
@@ -60,8 +61,139 @@ static int rects_intersect(int ax, int ay, int aw, int ah,
     return 1;
 }
 
+static void compositor_render_form(gui_form_t *form, int is_focused) {
+    win_draw_focused(&form->win, is_focused);
+    if (form->menubar_enabled) {
+        menubar_draw(&form->menubar, form->win.x, form->win.y, form->win.w);
+    }
+    compositor_draw_controls(form);
+}
+
+/* Every window keeps what it last rendered in its own packed 4bpp
+   surface. Moving, raising or uncovering a window only copies from it;
+   the frame and controls are rendered again only when the surface is
+   stale, the window was resized, or its focus changed. One spare column
+   lets the surface follow the window to an odd x. */
+#define SURFACE_PITCH(w) (((w) + 2) / 2)
+
+static int compositor_update_surface(gui_form_t *form, int is_focused) {
+    window_t *win = &form->win;
+    if (win->x < 0 || win->y < 0 || win->x + win->w > WM_SCREEN_WIDTH ||
+        win->y + win->h > WM_SCREEN_HEIGHT || win->w <= 0 || win->h <= 0)
+        return -1;
+
+    if (win->surface && (win->surface_w != win->w || win->surface_h != win->h)) {
+        kfree(win->surface);
+        win->surface = NULL;
+    }
+    if (!win->surface) {
+        win->surface = kmalloc(SURFACE_PITCH(win->w) * win->h);
+        if (!win->surface) return -1;
+        win->surface_w = win->w;
+        win->surface_h = win->h;
+        win->surface_stale = 1;
+    }
+
+    if (!win->surface_stale && win->surface_focused == is_focused)
+        return 0;
+
+    /* The saved background must come from the screen, not the surface */
+    if (!win->saved_bg) win_save_background(win);
+
+    if (gfx_begin_surface(win->surface, SURFACE_PITCH(win->w), win->x, win->y, win->w, win->h) != 0)
+        return -1;
+    compositor_render_form(form, is_focused);
+    gfx_end_surface();
+
+    win->surface_x = win->x;
+    win->surface_focused = is_focused;
+    /* Controls are left out while resizing, so that state is never kept */
+    win->surface_stale = form->resizing ? 1 : 0;
+    return 0;
+}
+
+/* Paint a window, or its icon when minimized, inside the current clip */
+static void compositor_paint_form(window_manager_t *wm, int index) {
+    gui_form_t *form = wm->windows[index];
+
+    if (form->win.is_minimized) {
+        if (form->win.minimized_icon_id == -1 || !form->controls) return;
+        for (int j = 0; j < form->ctrl_count; j++) {
+            gui_control_t *ctrl = &form->controls[j];
+            if (ctrl->type == CTRL_ICON && ctrl->id == form->win.minimized_icon_id) {
+                ctrl_draw_icon(ctrl, ctrl->x, ctrl->y, 0);
+                break;
+            }
+        }
+        return;
+    }
+
+    int is_focused = (index == wm->focused_index);
+    if (compositor_update_surface(form, is_focused) == 0) {
+        window_t *win = &form->win;
+        gfx_blit_surface(win->surface, SURFACE_PITCH(win->w), win->x - (win->surface_x & 1), win->y,
+                         win->x, win->y, win->w, win->h);
+        return;
+    }
+    compositor_render_form(form, is_focused);
+}
+
+/* Paint a window one visible rect at a time, so every pixel it owns is
+   drawn once and nothing covering it is touched. Rects outside the
+   current clip are skipped, so a fully occluded window costs nothing. */
+static void compositor_paint_visible(window_manager_t *wm, int index) {
+    wm_region_t *rgn = &wm->visible[index];
+    for (int k = 0; k < rgn->count; k++) {
+        wm_rect_t *r = &rgn->rects[k];
+        if (!gfx_clip_visible(r->x, r->y, r->w, r->h)) continue;
+        if (gfx_push_clip(r->x, r->y, r->w, r->h) != 0) return;
+        compositor_paint_form(wm, index);
+        gfx_pop_clip();
+    }
+}
+
+/* Paint one window on its own. If its region could not be split finely
+   enough it also covers windows above it, so those are painted again,
+   back to front, over its area. */
+static void compositor_paint_alone(window_manager_t *wm, int index) {
+    /* Control renders can yield; keep our clips to ourselves meanwhile */
+    gfx_acquire();
+    compositor_paint_visible(wm, index);
+
+    wm_rect_t *a = &wm->vis_area[index];
+    int first = wm->windows[index]->win.is_minimized ? 0 : index + 1;
+    if (wm->visible[index].inexact && gfx_push_clip(a->x, a->y, a->w, a->h) == 0) {
+        for (int j = first; j < wm->count; j++) {
+            gui_form_t *above = wm->windows[j];
+            if (j == index || !above || !above->win.is_visible || above->win.is_minimized) continue;
+            compositor_paint_visible(wm, j);
+        }
+        gfx_pop_clip();
+    }
+    gfx_release();
+}
+
+/* Minimized icons first so they appear underneath windows, then windows
+   back to front. Visible regions do not overlap, so the order only
+   matters when a region could not be split finely enough. */
+static void compositor_draw_windows(window_manager_t *wm) {
+    for (int i = 0; i < wm->count; i++) {
+        gui_form_t *form = wm->windows[i];
+        if (form && form->win.is_visible && form->win.is_minimized)
+            compositor_paint_visible(wm, i);
+    }
+    for (int i = 0; i < wm->count; i++) {
+        gui_form_t *form = wm->windows[i];
+        if (form && form->win.is_visible && !form->win.is_minimized)
+            compositor_paint_visible(wm, i);
+    }
+}
+
 void compositor_draw_all(window_manager_t *wm) {
+    /* The damage clip stays pushed while control renders yield */
+    gfx_acquire();
     mouse_restore();
+    wm_update_visibility(wm);
 
     /* A pending full redraw belongs to the desktop, which repaints the
        wallpaper/taskbar before asking the compositor to layer windows. */
@@ -72,84 +204,12 @@ void compositor_draw_all(window_manager_t *wm) {
         int dw = wm->dirty_w;
         int dh = wm->dirty_h;
 
-        /* Determine lowest z-index that must be updated.
-           If any window intersects the dirty rect, we must redraw that
-           window and every window above it to preserve z-order (so
-           higher windows redraw over lower ones). Compute the minimal
-           index and draw from there up to the top. */
-        int min_index_to_draw = wm->count; /* if unchanged, nothing to draw */
-        for (int i = 0; i < wm->count; i++) {
-            gui_form_t *form = wm->windows[i];
-            if (!form || !form->win.is_visible) continue;
-
-            if (form->win.is_minimized) {
-                int ix = 0, iy = 0, iw = 0, ih = 0;
-                int has_icon = 0;
-                if (form->win.minimized_icon_id != -1 && form->controls) {
-                    for (int j = 0; j < form->ctrl_count; j++) {
-                        gui_control_t *ctrl = &form->controls[j];
-                        if (ctrl->type == CTRL_ICON && ctrl->id == form->win.minimized_icon_id) {
-                            ix = ctrl->x;
-                            iy = ctrl->y;
-                            iw = ctrl->w > 0 ? ctrl->w : WM_ICON_TOTAL_WIDTH;
-                            int label_lines = icon_count_label_lines(ctrl->text, 49);
-                            ih = icon_calc_total_height(32, label_lines);
-                            has_icon = 1;
-                            break;
-                        }
-                    }
-                }
-                if (has_icon && rects_intersect(dx, dy, dw, dh, ix, iy, iw, ih)) {
-                    if (i < min_index_to_draw) min_index_to_draw = i;
-                }
-            } else {
-                if (rects_intersect(dx, dy, dw, dh,
-                                    form->win.x - WM_BG_MARGIN,
-                                    form->win.y - WM_BG_MARGIN,
-                                    form->win.w + (WM_BG_MARGIN * 2),
-                                    form->win.h + (WM_BG_MARGIN * 2))) {
-                    if (i < min_index_to_draw) min_index_to_draw = i;
-                }
-            }
-        }
+        /* Nothing outside the dirty rect is touched; windows with no
+           visible part inside it are skipped. Without a free clip slot
+           everything is drawn, which is only slower. */
+        int clipped = gfx_push_clip(dx, dy, dw, dh) == 0;
 
-        /* If nothing intersects, nothing to do. Otherwise draw from the
-           lowest affected window up to the top in back-to-front order. */
-        if (min_index_to_draw < wm->count) {
-            for (int i = min_index_to_draw; i < wm->count; i++) {
-                gui_form_t *form = wm->windows[i];
-                if (!form || !form->win.is_visible) continue;
-
-                if (form->win.is_minimized) {
-                    if (form->win.minimized_icon_id != -1 && form->controls) {
-                        for (int j = 0; j < form->ctrl_count; j++) {
-                            gui_control_t *ctrl = &form->controls[j];
-                            if (ctrl->type == CTRL_ICON && ctrl->id == form->win.minimized_icon_id) {
-                                int ix = ctrl->x;
-                                int iy = ctrl->y;
-                                int iw = ctrl->w > 0 ? ctrl->w : WM_ICON_TOTAL_WIDTH;
-                                int label_lines = icon_count_label_lines(ctrl->text, 49);
-                                int ih = icon_calc_total_height(32, label_lines);
-                                if (rects_intersect(dx, dy, dw, dh, ix, iy, iw, ih)) {
-                                    ctrl_draw_icon(ctrl, ctrl->x, ctrl->y, 0);
-                                }
-                                break;
-                            }
-                        }
-                    }
-                } else {
-                    /* Draw windows in z-order (bottom->top); we intentionally
-                       draw some windows even if they don't intersect the dirty
-                       rect so they can properly cover earlier windows that do. */
-                    int is_focused = (i == wm->focused_index);
-                    win_draw_focused(&form->win, is_focused);
-                    if (form->menubar_enabled) {
-                        menubar_draw(&form->menubar, form->win.x, form->win.y, form->win.w);
-                    }
-                    compositor_draw_controls(form);
-                }
-            }
-        }
+        compositor_draw_windows(wm);
 
         /* Draw popup menus on top of all windows (final pass) */
         for (int i = 0; i < wm->count; i++) {
@@ -205,50 +265,18 @@ void compositor_draw_all(window_manager_t *wm) {
             }
         }
 
+        if (clipped) gfx_pop_clip();
+
         /* Clear the dirty rect after drawing */
         wm->dirty_x = wm->dirty_y = wm->dirty_w = wm->dirty_h = 0;
 
         mouse_invalidate_buffer();
+        gfx_release();
         return;
     }
 
-    /* Full redraw path (or when needs_full_redraw was set)
-       1) Draw all minimized icons first so they appear underneath windows.
-        2) Then draw windows/front-to-back normally. */
-
-    /* Draw all minimized icons (underneath everything) */
-    for (int i = 0; i < wm->count; i++) {
-        gui_form_t *form = wm->windows[i];
-        if (!form || !form->win.is_visible) continue;
-        if (form->win.is_minimized) {
-            if (form->win.minimized_icon_id != -1 && form->controls) {
-                for (int j = 0; j < form->ctrl_count; j++) {
-                    gui_control_t *ctrl = &form->controls[j];
-                    if (ctrl->type == CTRL_ICON && ctrl->id == form->win.minimized_icon_id) {
-                        ctrl_draw_icon(ctrl, ctrl->x, ctrl->y, 0);
-                        break;
-                    }
-                }
-            }
-        }
-    }
-
-    /* Now draw windows in z-order on top of icons */
-    for (int i = 0; i < wm->count; i++) {
-        gui_form_t *form = wm->windows[i];
-        if (!form || !form->win.is_visible) continue;
-
-        int is_focused = (i == wm->focused_index);
-        win_draw_focused(&form->win, is_focused);
-
-        /* Draw menubar if enabled */
-        if (!form->win.is_minimized && form->menubar_enabled) {
-            menubar_draw(&form->menubar, form->win.x, form->win.y, form->win.w);
-        }
-
-        /* Draw controls if not minimized */
-        compositor_draw_controls(form);
-    }
+    /* Full redraw path (or when needs_full_redraw was set) */
+    compositor_draw_windows(wm);
 
     /* Draw popup menus on top of ALL windows (final pass) */
     for (int i = 0; i < wm->count; i++) {
@@ -279,47 +307,35 @@ void compositor_draw_all(window_manager_t *wm) {
         compositor_draw_dropdowns(form);
     }
     mouse_invalidate_buffer();
+    gfx_release();
 }
 
 void compositor_draw_single(window_manager_t *wm, gui_form_t *form) {
     if (!form || !form->win.is_visible) return;
     mouse_restore();
 
-    int is_focused = 0;
+    wm_update_visibility(wm);
+
+    int index = -1;
     for (int i = 0; i < wm->count; i++) {
         if (wm->windows[i] == form) {
-            is_focused = (i == wm->focused_index);
+            index = i;
             break;
         }
     }
-
-    /* If the single form is minimized, draw its icon only (icons are
-       treated underneath normal windows). Otherwise draw the full form. */
-    if (form->win.is_minimized) {
-        if (form->win.minimized_icon_id != -1 && form->controls) {
-            for (int j = 0; j < form->ctrl_count; j++) {
-                gui_control_t *ctrl = &form->controls[j];
-                if (ctrl->type == CTRL_ICON && ctrl->id == form->win.minimized_icon_id) {
-                    ctrl_draw_icon(ctrl, ctrl->x, ctrl->y, 0);
-                    break;
-                }
-            }
-        }
+    if (index < 0) {
         mouse_invalidate_buffer();
         return;
     }
 
-    /* Draw the window */
-    win_draw_focused(&form->win, is_focused);
-
-    /* Draw menubar if enabled */
-    if (!form->win.is_minimized && form->menubar_enabled) {
-        menubar_draw(&form->menubar, form->win.x, form->win.y, form->win.w);
+    /* Only the part of the form no other window covers is drawn */
+    form->win.surface_stale = 1;
+    compositor_paint_alone(wm, index);
+    if (form->win.is_minimized) {
+        mouse_invalidate_buffer();
+        return;
     }
 
-    /* Draw controls if not minimized */
-    compositor_draw_controls(form);
-
     /* Draw open dropdown lists on top */
     compositor_draw_dropdowns(form);
 
@@ -347,7 +363,6 @@ void compositor_draw_single(window_manager_t *wm, gui_form_t *form) {
 }
 
 void compositor_draw_control_by_id(window_manager_t *wm, gui_form_t *form, int16_t ctrl_id) {
-    (void)wm;  /* Unused but kept for API consistency */
     if (!form || !form->win.is_visible || form->win.is_minimized) return;
     if (!form->controls) return;
 
@@ -365,7 +380,33 @@ void compositor_draw_control_by_id(window_manager_t *wm, gui_form_t *form, int16
             ctrl_y_offset += menubar_get_height(&form->menubar);
         }
 
-        ctrl_draw_with_offset(&form->win, ctrl, ctrl_y_offset);
+        /* Render the control into the window's surface when it is current
+           and laid out for this x, otherwise the whole window again, then
+           copy its area out through the visible part of the window */
+        window_t *win = &form->win;
+        wm_update_visibility(wm);
+        for (int i = 0; i < wm->count; i++) {
+            if (wm->windows[i] != form) continue;
+            if (win->surface && !win->surface_stale &&
+                ((win->surface_x ^ win->x) & 1) == 0 &&
+                gfx_begin_surface(win->surface, SURFACE_PITCH(win->w), win->x, win->y, win->w, win->h) == 0) {
+                ctrl_draw_with_offset(win, ctrl, ctrl_y_offset);
+                gfx_end_surface();
+            } else {
+                win->surface_stale = 1;
+            }
+            int clipped;
+            gfx_acquire();
+            if (ctrl->w > 0 && ctrl->h > 0)
+                clipped = gfx_push_clip(win->x + ctrl->x - 2, win->y + ctrl->y + ctrl_y_offset - 2,
+                                        ctrl->w + 4, ctrl->h + 4) == 0;
+            else
+                clipped = gfx_push_clip(win->x, win->y, win->w, win->h) == 0;
+            compositor_paint_alone(wm, i);
+            if (clipped) gfx_pop_clip();
+            gfx_release();
+            break;
+        }
         /* If it's a dropdown with an open list, redraw that too */
         if (ctrl->type == CTRL_DROPDOWN && ctrl->dropdown.dropdown_open) {
             win_draw_dropdown_list(&form->win, ctrl, ctrl_y_offset);
@@ -472,3 +513,13 @@ void compositor_set_dirty_rect(window_manager_t *wm, int x, int y, int w, int h)
         wm->dirty_h = (y2 > oy2 ? y2 : oy2) - ny;
     }
 }
+
+void compositor_invalidate_form(gui_form_t *form) {
+    if (form) form->win.surface_stale = 1;
+}
+
+void compositor_invalidate_all(window_manager_t *wm) {
+    for (int i = 0; i < wm->count; i++) {
+        compositor_invalidate_form(wm->windows[i]);
+    }
+}
@@ -29,6 +29,8 @@ void win_create(window_t *win, int x, int y, int w, int h, const char *title) {
     win->is_visible = 1;
     win->dirty = 1;
     win->saved_bg = NULL;
+    win->surface = NULL;
+    win->surface_stale = 1;
     win->is_minimized = 0;
     win->minimized_icon_id = -1;
     win->resizable = 1;
@@ -80,6 +82,10 @@ void win_destroy(window_t *win) {
         kfree(win->saved_bg);
         win->saved_bg = NULL;
     }
+    if (win->surface) {
+        kfree(win->surface);
+        win->surface = NULL;
+    }
     mouse_invalidate_buffer();
 }
 
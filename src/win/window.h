@@ -15,6 +15,10 @@ typedef struct {
     int is_visible;
     int dirty;
     uint8_t *saved_bg;
+    uint8_t *surface;           /* Retained rendering of the window, see compositor.c */
+    int surface_x, surface_w, surface_h;  /* Where and at what size it was rendered */
+    int surface_focused;        /* Focus state it was rendered with */
+    int surface_stale;          /* Content changed since it was rendered */
     int is_minimized;
     int16_t minimized_icon_id;  /* Control ID for minimized window icon */
     int resizable;
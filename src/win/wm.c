@@ -1,6 +1,7 @@
 #include "wm.h"
 #include "window.h"
 #include "menu.h"
+#include "icon.h"
 #include "../drivers/mouse.h"
 
 void wm_init(window_manager_t *wm) {
@@ -17,6 +18,7 @@ void wm_init(window_manager_t *wm) {
     wm->dirty_y = 0;
     wm->dirty_w = 0;
     wm->dirty_h = 0;
+    wm->vis_count = -1;
 
     for (int i = 0; i < WM_MAX_WINDOWS; i++) {
         wm->windows[i] = NULL;
@@ -34,6 +36,7 @@ int wm_register_window(window_manager_t *wm, gui_form_t *form) {
 
     // Make new window focused
     wm->focused_index = wm->count - 1;
+    wm->vis_count = -1;
 
     return 1;  // Success
 }
@@ -59,6 +62,7 @@ void wm_unregister_window(window_manager_t *wm, gui_form_t *form) {
 
     wm->windows[wm->count - 1] = NULL;
     wm->count--;
+    wm->vis_count = -1;
 
     // Adjust focused index
     if (wm->focused_index == found_index) {
@@ -98,6 +102,7 @@ int wm_bring_to_front(window_manager_t *wm, gui_form_t *form) {
     }
     wm->windows[wm->count - 1] = temp;
     wm->focused_index = wm->count - 1;
+    wm->vis_count = -1;
     return 1;  // Z-order changed
 }
 
@@ -313,3 +318,118 @@ void wm_snap_to_slot(int x, int y, int *out_x, int *out_y) {
     if (*out_x < WM_ICON_MARGIN) *out_x = WM_ICON_MARGIN;
     if (*out_y < WM_ICON_MARGIN) *out_y = WM_ICON_MARGIN;
 }
+
+/* Screen area a window paints: its frame, or for a minimized window the
+   icon together with the label background ctrl_draw_icon saves. */
+static int wm_paint_area(gui_form_t *form, wm_rect_t *r) {
+    r->x = r->y = r->w = r->h = 0;
+    if (!form || !form->win.is_visible) return 0;
+
+    if (!form->win.is_minimized) {
+        r->x = form->win.x;
+        r->y = form->win.y;
+        r->w = form->win.w;
+        r->h = form->win.h;
+        return r->w > 0 && r->h > 0;
+    }
+
+    gui_control_t *ctrl = wm_get_minimized_icon(form);
+    if (!ctrl) return 0;
+    int label_w = (ctrl->w > 0 ? ctrl->w : 48) + 14;
+    int lines = ctrl->h > 0
+              ? icon_count_label_lines_limited(ctrl->text, label_w - 2, 2)
+              : icon_count_label_lines(ctrl->text, label_w - 2);
+    int total_h = icon_calc_total_height(32, lines);
+    if (ctrl->h > 0 && total_h > ctrl->h) total_h = ctrl->h;
+    r->x = ctrl->x - 8;
+    r->y = ctrl->y - 1;
+    r->w = label_w + 2;
+    r->h = total_h + 2;
+    return 1;
+}
+
+/* Remove cut from the region. A rect that overlaps it leaves up to four
+   pieces: the bands above and below, and the parts left and right of it.
+   If the pieces do not fit, the region is left as it was: everything is
+   still painted back to front, so the window above just paints over it. */
+static void wm_region_subtract(wm_region_t *rgn, const wm_rect_t *cut) {
+    wm_rect_t out[WM_REGION_RECTS];
+    int n = 0;
+    int cx1 = cut->x + cut->w;
+    int cy1 = cut->y + cut->h;
+
+    for (int i = 0; i < rgn->count; i++) {
+        wm_rect_t *r = &rgn->rects[i];
+        int rx1 = r->x + r->w;
+        int ry1 = r->y + r->h;
+
+        if (cut->x >= rx1 || cx1 <= r->x || cut->y >= ry1 || cy1 <= r->y) {
+            if (n == WM_REGION_RECTS) {
+                rgn->inexact = 1;
+                return;
+            }
+            out[n++] = *r;
+            continue;
+        }
+
+        int top = cut->y > r->y ? cut->y : r->y;
+        int bottom = cy1 < ry1 ? cy1 : ry1;
+        wm_rect_t piece[4];
+        int pieces = 0;
+        if (top > r->y)
+            piece[pieces++] = (wm_rect_t){ r->x, r->y, r->w, top - r->y };
+        if (bottom < ry1)
+            piece[pieces++] = (wm_rect_t){ r->x, bottom, r->w, ry1 - bottom };
+        if (cut->x > r->x)
+            piece[pieces++] = (wm_rect_t){ r->x, top, cut->x - r->x, bottom - top };
+        if (cx1 < rx1)
+            piece[pieces++] = (wm_rect_t){ cx1, top, rx1 - cx1, bottom - top };
+
+        if (n + pieces > WM_REGION_RECTS) {
+            rgn->inexact = 1;
+            return;
+        }
+        for (int k = 0; k < pieces; k++) out[n++] = piece[k];
+    }
+
+    for (int i = 0; i < n; i++) rgn->rects[i] = out[i];
+    rgn->count = n;
+}
+
+void wm_update_visibility(window_manager_t *wm) {
+    wm_rect_t area[WM_MAX_WINDOWS];
+    int changed = (wm->vis_count != wm->count);
+
+    for (int i = 0; i < wm->count; i++) {
+        wm_paint_area(wm->windows[i], &area[i]);
+        if (wm->vis_forms[i] != wm->windows[i] ||
+            wm->vis_area[i].x != area[i].x || wm->vis_area[i].y != area[i].y ||
+            wm->vis_area[i].w != area[i].w || wm->vis_area[i].h != area[i].h)
+            changed = 1;
+    }
+    if (!changed) return;
+
+    /* A window is covered by every window above it; icons sit on the
+       desktop underneath all windows. Icons cover nothing. */
+    for (int i = 0; i < wm->count; i++) {
+        gui_form_t *form = wm->windows[i];
+        wm_region_t *rgn = &wm->visible[i];
+        wm->vis_forms[i] = form;
+        wm->vis_area[i] = area[i];
+
+        rgn->count = 0;
+        rgn->inexact = 0;
+        if (area[i].w <= 0 || area[i].h <= 0) continue;
+        rgn->rects[0] = area[i];
+        rgn->count = 1;
+
+        int first = form->win.is_minimized ? 0 : i + 1;
+        for (int j = first; j < wm->count && rgn->count > 0; j++) {
+            gui_form_t *above = wm->windows[j];
+            if (j == i || !above || above->win.is_minimized) continue;
+            if (area[j].w <= 0 || area[j].h <= 0) continue;
+            wm_region_subtract(rgn, &area[j]);
+        }
+    }
+    wm->vis_count = wm->count;
+}
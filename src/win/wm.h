@@ -7,6 +7,19 @@ typedef struct {
 } icon_slot_t;
 
 #define WM_MAX_FREE_SLOTS 32
+#define WM_REGION_RECTS 16
+
+typedef struct {
+    int x, y, w, h;
+} wm_rect_t;
+
+// Part of a window not covered by anything above it, as disjoint rects.
+// inexact: a split did not fit, so the rects still include covered area.
+typedef struct {
+    int count;
+    int inexact;
+    wm_rect_t rects[WM_REGION_RECTS];
+} wm_region_t;
 
 // Window manager state
 typedef struct {
@@ -22,6 +35,10 @@ typedef struct {
     int needs_full_redraw;                       // Flag: desktop should do full redraw
     int backgrounds_invalid;                     // Saved backgrounds need fresh desktop pixels
     int dirty_x, dirty_y, dirty_w, dirty_h;      // Dirty rectangle for partial redraw
+    wm_region_t visible[WM_MAX_WINDOWS];         // Visible region of each window, by z-index
+    wm_rect_t vis_area[WM_MAX_WINDOWS];          // Area each region was computed from
+    gui_form_t *vis_forms[WM_MAX_WINDOWS];       // Window each region was computed for
+    int vis_count;                               // Windows covered by visible[] (-1: stale)
 } window_manager_t;
 
 void wm_init(window_manager_t *wm);
@@ -29,6 +46,10 @@ int wm_register_window(window_manager_t *wm, gui_form_t *form);
 void wm_unregister_window(window_manager_t *wm, gui_form_t *form);
 int wm_bring_to_front(window_manager_t *wm, gui_form_t *form);
 
+// Bring visible[] up to date after windows moved, resized, changed z-order,
+// were minimized or closed. Cheap when nothing changed.
+void wm_update_visibility(window_manager_t *wm);
+
 // Find window at given screen coordinates
 // Returns pointer to window or NULL if none found
 gui_form_t* wm_get_window_at(window_manager_t *wm, int x, int y);
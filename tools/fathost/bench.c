@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "drivers/blkdev.h"
+#include "drivers/fat32.h"
+
+/* Throughput benchmarks. Each phase reports wall time next to the I/O it
+ * caused: block layer requests, the device commands they were merged into,
+ * sectors moved and cache flushes. Read phases start from a fresh mount,
+ * so nothing is cached yet. bench-ram runs the same phases on a RAM disk,
+ * which leaves only the cost of the filesystem code itself. */
+
+#define BENCH_CHUNK 65536
+#define BENCH_SMALL_FILES 500
+#define BENCH_SMALL_SIZE 1024
+#define BENCH_SEEKS 2000
+
+typedef struct {
+    double start;
+    blk_stats_t stats;
+} bench_mark_t;
+
+static bench_mark_t mark;
+
+static void bench_begin(void) {
+    mark.stats = host_device()->stats;
+    mark.start = host_now();
+}
+
+static void bench_end(const char *name, uint64_t bytes, uint32_t ops) {
+    double secs = host_now() - mark.start;
+    blk_stats_t *now = &host_device()->stats;
+    uint32_t requests = now->requests - mark.stats.requests;
+    uint32_t cmds = now->commands - mark.stats.commands;
+    uint32_t rd = now->sectors_read - mark.stats.sectors_read;
+    uint32_t wr = now->sectors_written - mark.stats.sectors_written;
+    uint32_t fl = now->flushes - mark.stats.flushes;
+
+    printf("%-14s %9.3f ms", name, secs * 1000.0);
+    if (bytes) printf(" %9.1f MB/s", secs > 0 ? bytes / secs / 1048576.0 : 0.0);
+    else printf(" %9.0f op/s", secs > 0 ? ops / secs : 0.0);
+    printf(" %8u req %8u cmd %9u rd %9u wr %6u fl\n", requests, cmds, rd, wr, fl);
+}
+
+static int bench_seq_write(const char *path, uint8_t *buf, uint32_t size) {
+    fat32_file_t *f = fat32_open(path, "w");
+    if (!f) return -1;
+    bench_begin();
+    for (uint32_t done = 0; done < size; done += BENCH_CHUNK) {
+        if (fat32_write(f, buf, BENCH_CHUNK) != BENCH_CHUNK) {
+            fat32_close(f);
+            return -1;
+        }
+    }
+    fat32_close(f);
+    bench_end("seq_write", size, 0);
+    return 0;
+}
+
+static int bench_seq_read(const char *name, const char *path, uint8_t *buf, uint32_t size, uint32_t chunk) {
+    if (host_remount() != 0) return -1;
+    fat32_file_t *f = fat32_open(path, "r");
+    if (!f) return -1;
+    bench_begin();
+    uint32_t got = 0;
+    int n;
+    while ((n = fat32_read(f, buf, chunk)) > 0) got += (uint32_t)n;
+    fat32_close(f);
+    bench_end(name, got, 0);
+    return got == size ? 0 : -1;
+}
+
+static int bench_copy(const char *from, const char *to, uint32_t size) {
+    if (host_remount() != 0) return -1;
+    fat32_file_t *src = fat32_open(from, "r");
+    fat32_file_t *dst = fat32_open(to, "w");
+    uint32_t total = 0;
+    int n = -1;
+    bench_begin();
+    if (src && dst) {
+        while ((n = fat32_copy(dst, src, 256 * 1024)) > 0) total += (uint32_t)n;
+    }
+    if (dst) fat32_close(dst);
+    if (src) fat32_close(src);
+    bench_end("copy", total, 0);
+    return n == 0 && total == size ? 0 : -1;
+}
+
+static int bench_seek(const char *path, uint8_t *buf, uint32_t size) {
+    if (host_remount() != 0) return -1;
+    fat32_file_t *f = fat32_open(path, "r");
+    if (!f) return -1;
+    uint32_t pos = 1;
+    int rc = 0;
+    bench_begin();
+    for (int i = 0; i < BENCH_SEEKS && rc == 0; i++) {
+        pos = (pos * 1103515245 + 12345) % (size - 4096);
+        if (fat32_seek(f, pos) != 0 || fat32_read(f, buf, 4096) != 4096) rc = -1;
+    }
+    fat32_close(f);
+    bench_end("seek_read_4k", 0, BENCH_SEEKS);
+    return rc;
+}
+
+static int bench_small_files(uint8_t *buf) {
+    char path[64];
+    fat32_dirent_t e;
+    int rc = 0;
+
+    if (fat32_mkdir("C:/SMALL") != 0) return -1;
+    bench_begin();
+    for (int i = 0; i < BENCH_SMALL_FILES && rc == 0; i++) {
+        snprintf(path, sizeof(path), "C:/SMALL/%04d small file.txt", i);
+        fat32_file_t *f = fat32_open(path, "w");
+        if (!f || fat32_write(f, buf, BENCH_SMALL_SIZE) != BENCH_SMALL_SIZE) rc = -1;
+        if (f) fat32_close(f);
+    }
+    bench_end("small_create", 0, BENCH_SMALL_FILES);
+    if (rc != 0 || host_remount() != 0) return -1;
+
+    bench_begin();
+    fat32_dir_t *dir = fat32_opendir("C:/SMALL");
+    int n = 0;
+    if (dir) {
+        while (fat32_readdir(dir, &e) == 1) n++;
+        fat32_closedir(dir);
+    }
+    bench_end("dir_list", 0, (uint32_t)n);
+    if (n != BENCH_SMALL_FILES) return -1;
+
+    bench_begin();
+    for (int i = 0; i < BENCH_SMALL_FILES && rc == 0; i++) {
+        snprintf(path, sizeof(path), "C:/SMALL/%04d small file.txt", i);
+        fat32_file_t *f = fat32_open(path, "r");
+        if (!f || fat32_read(f, buf, BENCH_SMALL_SIZE) != BENCH_SMALL_SIZE) rc = -1;
+        if (f) fat32_close(f);
+    }
+    bench_end("small_read", 0, BENCH_SMALL_FILES);
+
+    bench_begin();
+    for (int i = 0; i < BENCH_SMALL_FILES && rc == 0; i++) {
+        snprintf(path, sizeof(path), "C:/SMALL/%04d small file.txt", i);
+        if (fat32_unlink(path) != 0) rc = -1;
+    }
+    bench_end("small_unlink", 0, BENCH_SMALL_FILES);
+    return rc;
+}
+
+int run_bench(const char *image, uint32_t size_mb, uint32_t spc, int ram) {
+    uint32_t size = (size_mb / 4) << 20;
+    if (size > (64u << 20)) size = 64u << 20;
+    if (size < BENCH_CHUNK * 16) size = BENCH_CHUNK * 16;
+
+    if (ram) {
+        if (host_mount_ram(size_mb, spc) != 0) return -1;
+    } else if (image_format(image, size_mb, spc) != 0 || host_mount(image) != 0) {
+        return -1;
+    }
+
+    uint8_t *buf = malloc(BENCH_CHUNK);
+    for (uint32_t i = 0; i < BENCH_CHUNK; i++) buf[i] = (uint8_t)(i * 7);
+
+    printf("%u MB %s, %u sectors per cluster, %u MB test file\n", size_mb, ram ? "RAM disk" : "image",
+           spc, size >> 20);
+    int rc = bench_seq_write("C:/SEQ.BIN", buf, size);
+    if (rc == 0) rc = bench_seq_read("seq_read_64k", "C:/SEQ.BIN", buf, size, BENCH_CHUNK);
+    if (rc == 0) rc = bench_seq_read("seq_read_512", "C:/SEQ.BIN", buf, size, 512);
+    if (rc == 0) rc = bench_seek("C:/SEQ.BIN", buf, size);
+    if (rc == 0) rc = bench_copy("C:/SEQ.BIN", "C:/SEQCOPY.BIN", size);
+    if (rc == 0) rc = bench_small_files(buf);
+    free(buf);
+
+    host_unmount();
+    if (rc != 0) printf("benchmark failed\n");
+    if (ram && host_dump(host_device(), image) != 0) return -1;
+    if (image_check(image, 1) != 0) rc = -1;
+    return rc;
+}
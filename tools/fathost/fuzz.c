@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "host.h"
+#include "drivers/fat32.h"
+
+/* Randomized operation fuzzer. A fixed set of paths is driven through
+ * random writes, partial overwrites, renames, unlinks, remounts and so on,
+ * and every file's contents are tracked in memory to compare against. */
+
+#define FUZZ_FILES 10
+
+static const char *fuzz_paths[FUZZ_FILES] = {
+    "C:/A.TXT", "C:/B.BIN", "C:/D1/C.DAT", "C:/D1/Long File Name 1.data", "C:/D1/SUB/E.TXT",
+    "C:/F.WAV", "C:/D1/SUB/another long name.txt", "C:/G", "C:/H.H", "C:/D1/I.I"
+};
+
+typedef struct {
+    uint8_t *data;
+    uint32_t size;
+    int exists;
+} shadow_t;
+
+static shadow_t shadow[FUZZ_FILES];
+static uint32_t rng;
+
+#define FUZZ_CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("fuzz: line %d: ", __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        return -1; \
+    } \
+} while (0)
+
+static uint32_t rnd(uint32_t n) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return n ? rng % n : 0;
+}
+
+static void random_fill(uint8_t *buf, uint32_t size) {
+    for (uint32_t i = 0; i < size; i++) buf[i] = (uint8_t)rnd(256);
+}
+
+static void shadow_set(int i, uint8_t *data, uint32_t size) {
+    free(shadow[i].data);
+    shadow[i].data = data;
+    shadow[i].size = size;
+    shadow[i].exists = 1;
+}
+
+static int op_verify(int i) {
+    fat32_file_t *f = fat32_open(fuzz_paths[i], "r");
+    if (!shadow[i].exists) {
+        if (f) fat32_close(f);
+        FUZZ_CHECK(!f, "%s should not exist", fuzz_paths[i]);
+        return 0;
+    }
+    FUZZ_CHECK(f, "open %s", fuzz_paths[i]);
+    FUZZ_CHECK(f->size == shadow[i].size, "%s size %u, expected %u", fuzz_paths[i], f->size, shadow[i].size);
+
+    uint8_t *buf = malloc(shadow[i].size + 20001);
+    uint32_t got = 0;
+    int n;
+    while ((n = fat32_read(f, buf + got, 1 + rnd(rnd(2) ? 40 : 20000))) > 0 && got <= shadow[i].size)
+        got += (uint32_t)n;
+    fat32_close(f);
+
+    int ok = n >= 0 && got == shadow[i].size && memcmp(buf, shadow[i].data, got) == 0;
+    free(buf);
+    FUZZ_CHECK(ok, "%s contents differ (read %u of %u)", fuzz_paths[i], got, shadow[i].size);
+    return 0;
+}
+
+static int op_seek_read(int i) {
+    if (!shadow[i].exists || shadow[i].size == 0) return 0;
+    fat32_file_t *f = fat32_open(fuzz_paths[i], "r");
+    FUZZ_CHECK(f, "open %s", fuzz_paths[i]);
+
+    uint8_t buf[3000];
+    int ok = 1;
+    for (int k = 0; k < 20 && ok; k++) {
+        uint32_t pos = rnd(shadow[i].size);
+        uint32_t len = 1 + rnd(sizeof(buf));
+        uint32_t expect = pos + len > shadow[i].size ? shadow[i].size - pos : len;
+        ok = fat32_seek(f, pos) == 0 && fat32_read(f, buf, len) == (int)expect &&
+             memcmp(buf, shadow[i].data + pos, expect) == 0;
+    }
+    fat32_close(f);
+    FUZZ_CHECK(ok, "seek/read mismatch in %s", fuzz_paths[i]);
+    return 0;
+}
+
+static int op_write(int i) {
+    uint32_t size = rnd(4) == 0 ? rnd(300000) : rnd(5000);
+    uint8_t *data = malloc(size + 1);
+    random_fill(data, size);
+
+    fat32_file_t *f = fat32_open(fuzz_paths[i], "w");
+    if (!f) free(data);
+    FUZZ_CHECK(f, "create %s", fuzz_paths[i]);
+
+    uint32_t done = 0;
+    int ok = 1;
+    while (done < size && ok) {
+        uint32_t n = 1 + rnd(rnd(2) ? 64 : 20000);
+        if (n > size - done) n = size - done;
+        ok = fat32_write(f, data + done, n) == (int)n;
+        done += n;
+    }
+    fat32_close(f);
+    shadow_set(i, data, size);
+    FUZZ_CHECK(ok, "write to %s", fuzz_paths[i]);
+    return 0;
+}
+
+static int op_patch(int i) {
+    if (!shadow[i].exists) return 0;
+    uint32_t pos = rnd(shadow[i].size + 1);
+    uint32_t len = 1 + rnd(10000);
+    uint8_t *patch = malloc(len);
+    random_fill(patch, len);
+
+    fat32_file_t *f = fat32_open(fuzz_paths[i], "a");
+    int n = -1;
+    if (f) {
+        if (fat32_seek(f, pos) == 0) n = fat32_write(f, patch, len);
+        fat32_close(f);
+    }
+    if (n == (int)len) {
+        if (pos + len > shadow[i].size) {
+            shadow[i].data = realloc(shadow[i].data, pos + len);
+            shadow[i].size = pos + len;
+        }
+        memcpy(shadow[i].data + pos, patch, len);
+    }
+    free(patch);
+    FUZZ_CHECK(n == (int)len, "patch %s at %u", fuzz_paths[i], pos);
+    return 0;
+}
+
+/* Two files written alternately, so their clusters interleave on disk. */
+static int op_interleave(int a, int b) {
+    if (a == b) return 0;
+    uint32_t size[2] = { rnd(100000), rnd(100000) };
+    uint8_t *data[2] = { malloc(size[0] + 1), malloc(size[1] + 1) };
+    fat32_file_t *f[2] = { fat32_open(fuzz_paths[a], "w"), fat32_open(fuzz_paths[b], "w") };
+    uint32_t done[2] = { 0, 0 };
+    int ok = f[0] && f[1];
+
+    random_fill(data[0], size[0]);
+    random_fill(data[1], size[1]);
+    while (ok && (done[0] < size[0] || done[1] < size[1])) {
+        uint32_t chunk = 1 + rnd(3000);
+        for (int k = 0; k < 2 && ok; k++) {
+            uint32_t n = size[k] - done[k] < chunk ? size[k] - done[k] : chunk;
+            if (n) ok = fat32_write(f[k], data[k] + done[k], n) == (int)n;
+            done[k] += n;
+        }
+    }
+    if (f[0]) fat32_close(f[0]);
+    if (f[1]) fat32_close(f[1]);
+    shadow_set(a, data[0], size[0]);
+    shadow_set(b, data[1], size[1]);
+    FUZZ_CHECK(ok, "interleaved writes to %s and %s", fuzz_paths[a], fuzz_paths[b]);
+    return 0;
+}
+
+/* A reader must see what another handle on the same file just wrote. */
+static int op_coherent(int i) {
+    if (!shadow[i].exists || shadow[i].size < 2) return 0;
+    fat32_file_t *r = fat32_open(fuzz_paths[i], "r");
+    fat32_file_t *w = fat32_open(fuzz_paths[i], "a");
+    uint8_t before[64], patch[64];
+    uint32_t pos = rnd(shadow[i].size - 1);
+    uint32_t len = 1 + rnd(40);
+    int n = -1;
+
+    if (pos + len > shadow[i].size) len = shadow[i].size - pos;
+    random_fill(patch, len);
+    if (r && w) {
+        fat32_seek(r, pos);
+        fat32_read(r, before, 1);
+        fat32_seek(w, pos);
+        if (fat32_write(w, patch, len) == (int)len) {
+            memcpy(shadow[i].data + pos, patch, len);
+            fat32_seek(r, pos);
+            n = fat32_read(r, before, len);
+        }
+    }
+    if (w) fat32_close(w);
+    if (r) fat32_close(r);
+    FUZZ_CHECK(n == (int)len && memcmp(before, patch, len) == 0, "stale read of %s at %u",
+               fuzz_paths[i], pos);
+    return 0;
+}
+
+static int op_unlink(int i) {
+    int rc = fat32_unlink(fuzz_paths[i]);
+    FUZZ_CHECK((rc == 0) == (shadow[i].exists != 0), "unlink %s returned %d", fuzz_paths[i], rc);
+    shadow[i].exists = 0;
+    return 0;
+}
+
+static int op_rename(int i, int j) {
+    if (i == j) return 0;
+    int rc = fat32_rename(fuzz_paths[i], fuzz_paths[j]);
+    int expect = shadow[i].exists && !shadow[j].exists;
+    FUZZ_CHECK((rc == 0) == expect, "rename %s to %s returned %d", fuzz_paths[i], fuzz_paths[j], rc);
+    if (rc == 0) {
+        free(shadow[j].data);
+        shadow[j] = shadow[i];
+        memset(&shadow[i], 0, sizeof(shadow[i]));
+    }
+    return 0;
+}
+
+static int op_stat(int i) {
+    fat32_dirent_t e;
+    int rc = fat32_stat(fuzz_paths[i], &e);
+    FUZZ_CHECK((rc == 0) == (shadow[i].exists != 0), "stat %s returned %d", fuzz_paths[i], rc);
+    FUZZ_CHECK(rc != 0 || e.size == shadow[i].size, "stat %s size %u", fuzz_paths[i], e.size);
+    return 0;
+}
+
+static int op_list(void) {
+    fat32_dirent_t *entries = malloc(sizeof(*entries) * 64);
+    int n = fat32_list_dir("C:/D1", entries, 64);
+    int bad = -1;
+
+    for (int i = 0; i < FUZZ_FILES && bad < 0; i++) {
+        const char *name = fuzz_paths[i] + 6;
+        if (strncmp(fuzz_paths[i], "C:/D1/", 6) != 0 || strchr(name, '/')) continue;
+        int found = 0;
+        for (int k = 0; k < n; k++) {
+            if (strcasecmp(entries[k].name, name) != 0) continue;
+            found = 1;
+            if (entries[k].size != shadow[i].size) bad = i;
+        }
+        if (found != shadow[i].exists) bad = i;
+    }
+    free(entries);
+    FUZZ_CHECK(bad < 0, "listing of C:/D1 disagrees about %s", fuzz_paths[bad]);
+    return 0;
+}
+
+static int op_dir_churn(void) {
+    fat32_dirent_t e;
+    FUZZ_CHECK(fat32_mkdir("C:/D1/SUB/TMPD") == 0, "mkdir");
+    fat32_file_t *f = fat32_open("C:/D1/SUB/TMPD/X.TXT", "w");
+    FUZZ_CHECK(f, "create in new directory");
+    fat32_write(f, "hi", 2);
+    fat32_close(f);
+    FUZZ_CHECK(fat32_stat("C:/D1/SUB/TMPD/X.TXT", &e) == 0 && e.size == 2, "stat new file");
+    FUZZ_CHECK(fat32_rmdir("C:/D1/SUB/TMPD") != 0, "rmdir of a non-empty directory");
+    FUZZ_CHECK(fat32_unlink("C:/D1/SUB/TMPD/X.TXT") == 0, "unlink");
+    FUZZ_CHECK(fat32_rmdir("C:/D1/SUB/TMPD") == 0, "rmdir");
+    FUZZ_CHECK(fat32_stat("C:/D1/SUB/TMPD", &e) != 0, "directory survived rmdir");
+    return 0;
+}
+
+static int fuzz_step(void) {
+    int op = (int)rnd(100);
+    int i = (int)rnd(FUZZ_FILES);
+
+    if (op < 30) return op_write(i);
+    if (op < 50) return op_verify(i);
+    if (op < 60) return op_seek_read(i);
+    if (op < 70) return op_patch(i);
+    if (op < 78) return op_unlink(i);
+    if (op < 84) return op_interleave(i, (int)rnd(FUZZ_FILES));
+    if (op < 88) {
+        FUZZ_CHECK(host_remount() == 0, "remount");
+        return 0;
+    }
+    if (op < 90) return op_list();
+    if (op < 92) return op_coherent(i);
+    if (op < 93) {
+        host_run_tasks();
+        return 0;
+    }
+    if (op < 96) return op_rename(i, (int)rnd(FUZZ_FILES));
+    if (op < 98) return op_stat(i);
+    return op_dir_churn();
+}
+
+int run_fuzz(const char *image, uint32_t seed, uint32_t iters, uint32_t spc) {
+    int rc = 0;
+    rng = seed * 2654435761u + 1;
+    memset(shadow, 0, sizeof(shadow));
+
+    if (image_format(image, 64, spc) != 0 || host_mount(image) != 0) return -1;
+    host_io_reset();
+    fat32_set_scrub(seed & 1);
+    if (fat32_mkdir("C:/D1") != 0 || fat32_mkdir("C:/D1/SUB") != 0) rc = -1;
+
+    for (uint32_t it = 0; it < iters && rc == 0; it++) rc = fuzz_step();
+
+    host_run_tasks();
+    if (rc == 0 && host_remount() != 0) rc = -1;
+    for (int i = 0; i < FUZZ_FILES && rc == 0; i++) rc = op_verify(i);
+    fat32_set_scrub(0);
+    host_unmount();
+
+    int problems = image_check(image, 1);
+    printf("seed %u spc %u: %s (%llu reads/%llu sectors, %llu writes/%llu sectors)\n", seed, spc,
+           rc == 0 && problems == 0 ? "ok" : "FAIL",
+           (unsigned long long)host_io.reads, (unsigned long long)host_io.sectors_read,
+           (unsigned long long)host_io.writes, (unsigned long long)host_io.sectors_written);
+
+    for (int i = 0; i < FUZZ_FILES; i++) free(shadow[i].data);
+    return rc == 0 && problems == 0 ? 0 : -1;
+}
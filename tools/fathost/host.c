@@ -0,0 +1,261 @@
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "host.h"
+#include "drivers/blkdev.h"
+#include "drivers/ramdisk.h"
+#include "drivers/fat32.h"
+#include "rtc.h"
+
+/* Stand-ins for the kernel services the FAT32 driver and the block layer
+ * link against. The kernel headers that declare them also declare a
+ * printf that clashes with stdio, so the prototypes are repeated here. */
+
+struct task;
+
+void memcpy_s(void *dst, const void *src, size_t n);
+void memset_s(void *dst, int value, size_t n);
+int strcmp_s(const char *a, const char *b);
+int strcasecmp_s(const char *a, const char *b);
+size_t strlen_s(const char *s);
+void strcpy_s(char *dst, const char *src, size_t max);
+char toupper_s(char c);
+void *kmalloc(size_t size);
+void kfree(void *ptr);
+void task_yield(void);
+void task_sleep(uint32_t milliseconds);
+struct task *task_get_current(void);
+uint32_t task_create(void (*entry)(void), const char *name, int priority);
+uint32_t timer_get_ticks(void);
+uint32_t timer_get_frequency(void);
+void rtc_read_time(rtc_time_t *t);
+int ata_read_sectors(uint32_t lba, uint8_t sector_count, void *buffer);
+int ata_write_sectors(uint32_t lba, uint8_t sector_count, const void *buffer);
+int ata_flush_cache(void);
+size_t pmm_count_free_frames(void);
+
+#define HOST_MAX_TASKS 8
+
+host_io_t host_io;
+uint32_t boot_device = 0xFFFFFFFF;
+
+static int disk_fd = -1;
+static blkdev_t *host_dev;  /* what drive C: is mounted from */
+static void (*pending_tasks[HOST_MAX_TASKS])(void);
+static int pending_count;
+
+void memcpy_s(void *dst, const void *src, size_t n) {
+    memmove(dst, src, n);
+}
+
+void memset_s(void *dst, int value, size_t n) {
+    memset(dst, value, n);
+}
+
+int strcmp_s(const char *a, const char *b) {
+    return strcmp(a, b);
+}
+
+int strcasecmp_s(const char *a, const char *b) {
+    return strcasecmp(a, b);
+}
+
+size_t strlen_s(const char *s) {
+    return strlen(s);
+}
+
+void strcpy_s(char *dst, const char *src, size_t max) {
+    if (max == 0) return;
+    size_t i = 0;
+    for (; i < max - 1 && src[i]; i++) dst[i] = src[i];
+    dst[i] = '\0';
+}
+
+char toupper_s(char c) {
+    return (char)toupper((unsigned char)c);
+}
+
+void *kmalloc(size_t size) {
+    return malloc(size);
+}
+
+void kfree(void *ptr) {
+    free(ptr);
+}
+
+void task_yield(void) {
+}
+
+/* Background tasks only run from host_run_tasks, so there is no one to
+ * wait for */
+void task_sleep(uint32_t milliseconds) {
+    (void)milliseconds;
+}
+
+struct task *task_get_current(void) {
+    return NULL;
+}
+
+/* Background tasks (the idle scrubber, the flusher) are queued and only run when a test
+ * asks for it, so their I/O shows up at a predictable point. */
+uint32_t task_create(void (*entry)(void), const char *name, int priority) {
+    (void)name;
+    (void)priority;
+    if (pending_count >= HOST_MAX_TASKS) return 0;
+    pending_tasks[pending_count++] = entry;
+    return (uint32_t)pending_count;
+}
+
+void host_run_tasks(void) {
+    while (pending_count > 0) {
+        void (*entry)(void) = pending_tasks[0];
+        pending_count--;
+        memmove(pending_tasks, pending_tasks + 1, pending_count * sizeof(pending_tasks[0]));
+        entry();
+    }
+}
+
+uint32_t timer_get_ticks(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 100 + ts.tv_nsec / 10000000);
+}
+
+uint32_t timer_get_frequency(void) {
+    return 100;
+}
+
+void rtc_read_time(rtc_time_t *t) {
+    memset(t, 0, sizeof(*t));
+    t->year = 2024;
+    t->month = 1;
+    t->day = 1;
+}
+
+double host_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int ata_read_sectors(uint32_t lba, uint8_t sector_count, void *buffer) {
+    size_t len = (size_t)sector_count * BLK_SECTOR_SIZE;
+    host_io.reads++;
+    host_io.sectors_read += sector_count;
+    if (disk_fd < 0) return -1;
+    return pread(disk_fd, buffer, len, (off_t)lba * BLK_SECTOR_SIZE) == (ssize_t)len ? 0 : -1;
+}
+
+int ata_write_sectors(uint32_t lba, uint8_t sector_count, const void *buffer) {
+    size_t len = (size_t)sector_count * BLK_SECTOR_SIZE;
+    host_io.writes++;
+    host_io.sectors_written += sector_count;
+    if (disk_fd < 0) return -1;
+    return pwrite(disk_fd, buffer, len, (off_t)lba * BLK_SECTOR_SIZE) == (ssize_t)len ? 0 : -1;
+}
+
+int ata_flush_cache(void) {
+    host_io.flushes++;
+    return 0;
+}
+
+/* The host never runs short of memory as far as the driver can tell */
+size_t pmm_count_free_frames(void) {
+    return 1u << 20;
+}
+
+/* Point the boot disk at an image file. blk_init() registers hd0 on top of
+ * ata_*_sectors exactly as the kernel does. */
+int host_disk_open(const char *path) {
+    host_disk_close();
+    disk_fd = open(path, O_RDWR);
+    if (disk_fd < 0) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+void host_disk_close(void) {
+    if (disk_fd >= 0) close(disk_fd);
+    disk_fd = -1;
+}
+
+void host_io_reset(void) {
+    memset(&host_io, 0, sizeof(host_io));
+}
+
+static void host_blk_init(void) {
+    static int blk_ready;
+    if (!blk_ready) {
+        blk_init();
+        blk_ready = 1;
+    }
+}
+
+/* Bring the driver up on an image as drive C:. */
+int host_mount(const char *path) {
+    if (host_disk_open(path) != 0) return -1;
+    host_blk_init();
+    fat32_init();
+    host_dev = blk_boot_device();
+    if (fat32_mount_device('C', host_dev, 0) != 0) {
+        printf("%s: mount failed\n", path);
+        host_disk_close();
+        return -1;
+    }
+    return 0;
+}
+
+/* Format a new RAM disk and mount it as drive C: instead of an image. */
+int host_mount_ram(uint32_t size_mb, uint32_t spc) {
+    host_blk_init();
+    fat32_init();
+    host_dev = ramdisk_create("ram0", size_mb * 2048);
+    if (!host_dev || fat32_format(host_dev, 0, size_mb * 2048, spc, "FATHOST") != 0 ||
+        fat32_mount_device('C', host_dev, 0) != 0) {
+        printf("RAM disk: mount failed\n");
+        return -1;
+    }
+    return 0;
+}
+
+blkdev_t *host_device(void) {
+    return host_dev;
+}
+
+/* Copy a whole device into an image file so image_check can look at it. */
+int host_dump(blkdev_t *dev, const char *path) {
+    uint8_t buf[BLK_MAX_TRANSFER * BLK_SECTOR_SIZE];
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    int rc = 0;
+    for (uint32_t lba = 0; lba < dev->sector_count && rc == 0; lba += BLK_MAX_TRANSFER) {
+        uint32_t n = dev->sector_count - lba < BLK_MAX_TRANSFER ? dev->sector_count - lba : BLK_MAX_TRANSFER;
+        if (blk_read(dev, lba, n, buf) != 0 || fwrite(buf, BLK_SECTOR_SIZE, n, f) != n) rc = -1;
+    }
+    if (fclose(f) != 0) rc = -1;
+    return rc;
+}
+
+/* Drop every cache by unmounting and mounting again. */
+int host_remount(void) {
+    fat32_unmount_drive('C');
+    return fat32_mount_device('C', host_dev, 0);
+}
+
+void host_unmount(void) {
+    host_run_tasks();
+    fat32_unmount_drive('C');
+    host_disk_close();
+}
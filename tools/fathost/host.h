@@ -0,0 +1,38 @@
+#pragma once
+#include <stdint.h>
+
+struct blkdev;
+
+/* Host-side harness for the FAT32 driver. The driver and the block layer
+ * are compiled unchanged; only the ATA entry points and the handful of
+ * kernel services they call are replaced (host.c). */
+
+typedef struct {
+    uint64_t reads;            /* ata_read_sectors calls */
+    uint64_t writes;           /* ata_write_sectors calls */
+    uint64_t flushes;          /* ata_flush_cache calls */
+    uint64_t sectors_read;
+    uint64_t sectors_written;
+} host_io_t;
+
+extern host_io_t host_io;
+
+int host_disk_open(const char *path);
+void host_disk_close(void);
+int host_mount(const char *path);
+int host_mount_ram(uint32_t size_mb, uint32_t spc);
+struct blkdev *host_device(void);
+int host_dump(struct blkdev *dev, const char *path);
+int host_remount(void);
+void host_unmount(void);
+void host_io_reset(void);
+void host_run_tasks(void);
+double host_now(void);
+
+/* image.c */
+int image_format(const char *path, uint32_t size_mb, uint32_t spc);
+int image_check(const char *path, int verbose);
+
+int run_tests(const char *image);
+int run_fuzz(const char *image, uint32_t seed, uint32_t iters, uint32_t spc);
+int run_bench(const char *image, uint32_t size_mb, uint32_t spc, int ram);
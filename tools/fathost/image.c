@@ -0,0 +1,299 @@
+#define _GNU_SOURCE
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "host.h"
+
+/* Image creation and an offline consistency check. mkfs.fat/fsck.fat are
+ * used when dosfstools is installed; the built-in formatter lays out the
+ * same structure for hosts without it (and for geometries mkfs.fat turns
+ * down, such as small images with large clusters). */
+
+#define SECTOR 512
+#define RESERVED_SECTORS 32
+#define NUM_FATS 2
+
+static void put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t get16(const uint8_t *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static int have_tool(const char *name) {
+    char cmd[128];
+    snprintf(cmd, sizeof(cmd), "command -v %s >/dev/null 2>&1", name);
+    return system(cmd) == 0;
+}
+
+static int write_sector(FILE *f, uint32_t lba, const uint8_t *buf) {
+    if (fseek(f, (long)lba * SECTOR, SEEK_SET) != 0) return -1;
+    return fwrite(buf, SECTOR, 1, f) == 1 ? 0 : -1;
+}
+
+static int format_builtin(const char *path, uint32_t size_mb, uint32_t spc) {
+    uint32_t total = size_mb * 2048;
+    uint32_t fat_size = 1;
+    uint32_t clusters;
+
+    /* Grow the FAT until it covers every cluster left after it */
+    for (;;) {
+        clusters = (total - RESERVED_SECTORS - NUM_FATS * fat_size) / spc;
+        uint32_t need = ((clusters + 2) * 4 + SECTOR - 1) / SECTOR;
+        if (need <= fat_size) break;
+        fat_size = need;
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    if (ftruncate(fileno(f), (off_t)total * SECTOR) != 0) {
+        fclose(f);
+        return -1;
+    }
+
+    uint8_t s[SECTOR];
+    int err = 0;
+
+    memset(s, 0, sizeof(s));
+    s[0] = 0xEB; s[1] = 0x58; s[2] = 0x90;
+    memcpy(s + 3, "MSWIN4.1", 8);
+    put16(s + 11, SECTOR);
+    s[13] = (uint8_t)spc;
+    put16(s + 14, RESERVED_SECTORS);
+    s[16] = NUM_FATS;
+    s[21] = 0xF8;
+    put16(s + 24, 32);
+    put16(s + 26, 64);
+    put32(s + 32, total);
+    put32(s + 36, fat_size);
+    put32(s + 44, 2);          /* root directory cluster */
+    put16(s + 48, 1);          /* FSInfo sector */
+    put16(s + 50, 6);          /* backup boot sector */
+    s[64] = 0x80;
+    s[66] = 0x29;
+    put32(s + 67, 0x0F47A7E5);
+    memcpy(s + 71, "FATHOST    ", 11);
+    memcpy(s + 82, "FAT32   ", 8);
+    s[510] = 0x55; s[511] = 0xAA;
+    err |= write_sector(f, 0, s);
+    err |= write_sector(f, 6, s);
+
+    memset(s, 0, sizeof(s));
+    put32(s, 0x41615252);
+    put32(s + 484, 0x61417272);
+    put32(s + 488, clusters - 1);
+    put32(s + 492, 3);
+    put32(s + 508, 0xAA550000);
+    err |= write_sector(f, 1, s);
+    err |= write_sector(f, 7, s);
+
+    memset(s, 0, sizeof(s));
+    put32(s, 0x0FFFFFF8);
+    put32(s + 4, 0x0FFFFFFF);
+    put32(s + 8, 0x0FFFFFFF);  /* root directory */
+    for (uint32_t i = 0; i < NUM_FATS; i++)
+        err |= write_sector(f, RESERVED_SECTORS + i * fat_size, s);
+
+    if (fclose(f) != 0) err = -1;
+    return err ? -1 : 0;
+}
+
+int image_format(const char *path, uint32_t size_mb, uint32_t spc) {
+    if (have_tool("mkfs.fat")) {
+        char cmd[512];
+        unlink(path);
+        snprintf(cmd, sizeof(cmd),
+                 "mkfs.fat -F 32 -S 512 -s %u -R %u -n FATHOST -C '%s' %u >/dev/null 2>&1",
+                 spc, RESERVED_SECTORS, path, size_mb * 1024);
+        if (system(cmd) == 0) return 0;
+    }
+    return format_builtin(path, size_mb, spc);
+}
+
+typedef struct {
+    uint8_t *img;
+    size_t size;
+    uint32_t bps;
+    uint32_t spc;
+    uint32_t fat_start;
+    uint32_t fat_size;
+    uint32_t first_data;
+    uint32_t clusters;
+    uint8_t *used;
+    int errors;
+    int verbose;
+} check_t;
+
+static void problem(check_t *c, const char *what, const char *fmt, ...) {
+    c->errors++;
+    if (!c->verbose) return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    printf("check: %s: ", what);
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+}
+
+static uint32_t fat_entry(check_t *c, uint32_t cluster) {
+    return get32(c->img + (size_t)c->fat_start * c->bps + cluster * 4) & 0x0FFFFFFF;
+}
+
+static uint8_t *cluster_data(check_t *c, uint32_t cluster) {
+    return c->img + ((size_t)c->first_data + (size_t)(cluster - 2) * c->spc) * c->bps;
+}
+
+static int cluster_valid(check_t *c, uint32_t cluster) {
+    return cluster >= 2 && cluster < c->clusters + 2;
+}
+
+/* Mark a chain as used; returns its length. */
+static uint32_t walk_chain(check_t *c, uint32_t cluster, const char *what) {
+    uint32_t n = 0;
+    while (cluster < 0x0FFFFFF8) {
+        if (!cluster_valid(c, cluster)) {
+            problem(c, what, "cluster %u out of range", cluster);
+            break;
+        }
+        if (c->used[cluster]) {
+            problem(c, what, "cluster %u cross-linked", cluster);
+            break;
+        }
+        c->used[cluster] = 1;
+        n++;
+        uint32_t next = fat_entry(c, cluster);
+        if (next == 0) {
+            problem(c, what, "chain runs into a free cluster after %u", cluster);
+            break;
+        }
+        cluster = next;
+    }
+    return n;
+}
+
+static void walk_dir(check_t *c, uint32_t first, const char *path, int depth) {
+    uint32_t cluster_size = c->bps * c->spc;
+    if (depth > 32) {
+        problem(c, path, "nested %d levels deep", depth);
+        return;
+    }
+
+    for (uint32_t cl = first; cluster_valid(c, cl); cl = fat_entry(c, cl)) {
+        uint8_t *d = cluster_data(c, cl);
+        for (uint32_t i = 0; i < cluster_size / 32; i++) {
+            uint8_t *e = d + i * 32;
+            if (e[0] == 0x00) return;
+            if (e[0] == 0xE5 || e[11] == 0x0F || (e[11] & 0x08)) continue;
+            if (e[0] == '.') continue;
+
+            char name[512];
+            snprintf(name, sizeof(name), "%s/%.11s", path, (const char*)e);
+            uint32_t fc = (uint32_t)get16(e + 20) << 16 | get16(e + 26);
+            uint32_t size = get32(e + 28);
+
+            if (e[11] & 0x10) {
+                if (!fc) {
+                    problem(c, name, "directory without clusters");
+                    continue;
+                }
+                walk_chain(c, fc, name);
+                walk_dir(c, fc, name, depth + 1);
+            } else {
+                uint32_t n = fc ? walk_chain(c, fc, name) : 0;
+                uint32_t need = (size + cluster_size - 1) / cluster_size;
+                if (n != need && !(size == 0 && n <= 1))
+                    problem(c, name, "size needs %u clusters, chain has %u", need, n);
+            }
+        }
+    }
+}
+
+static int run_fsck_fat(const char *path, int verbose) {
+    char cmd[512];
+    snprintf(cmd, sizeof(cmd), "fsck.fat -n '%s' %s", path, verbose ? "" : ">/dev/null 2>&1");
+    return system(cmd) == 0 ? 0 : -1;
+}
+
+int image_check(const char *path, int verbose) {
+    check_t c;
+    memset(&c, 0, sizeof(c));
+    c.verbose = verbose;
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    c.size = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    c.img = malloc(c.size);
+    if (!c.img || fread(c.img, 1, c.size, f) != c.size) {
+        fclose(f);
+        free(c.img);
+        return -1;
+    }
+    fclose(f);
+
+    c.bps = get16(c.img + 11);
+    c.spc = c.img[13];
+    c.fat_start = get16(c.img + 14);
+    c.fat_size = get32(c.img + 36);
+    c.first_data = c.fat_start + c.img[16] * c.fat_size;
+    c.clusters = (get32(c.img + 32) - c.first_data) / c.spc;
+    if (c.fat_size * c.bps / 4 < c.clusters + 2) c.clusters = c.fat_size * c.bps / 4 - 2;
+    c.used = calloc(c.clusters + 2, 1);
+
+    for (uint32_t i = 1; i < c.img[16]; i++) {
+        if (memcmp(c.img + (size_t)c.fat_start * c.bps,
+                   c.img + (size_t)(c.fat_start + i * c.fat_size) * c.bps,
+                   (size_t)c.fat_size * c.bps) != 0)
+            problem(&c, "FAT", "copy %u differs from copy 0", i);
+    }
+
+    uint32_t root = get32(c.img + 44);
+    walk_chain(&c, root, "/");
+    walk_dir(&c, root, "", 0);
+
+    uint32_t lost = 0, free_count = 0;
+    for (uint32_t cl = 2; cl < c.clusters + 2; cl++) {
+        uint32_t v = fat_entry(&c, cl);
+        if (v == 0) free_count++;
+        else if (!c.used[cl]) lost++;
+    }
+    if (lost) problem(&c, "FAT", "%u lost clusters", lost);
+
+    uint8_t *fsinfo = c.img + (size_t)get16(c.img + 48) * c.bps;
+    uint32_t hint = get32(fsinfo + 488);
+    if (hint != 0xFFFFFFFF && hint != free_count)
+        problem(&c, "FSInfo", "free count %u, actually %u free", hint, free_count);
+
+    free(c.used);
+    free(c.img);
+
+    if (have_tool("fsck.fat") && run_fsck_fat(path, verbose) != 0) {
+        if (verbose) printf("check: fsck.fat reported problems\n");
+        c.errors++;
+    }
+    return c.errors;
+}
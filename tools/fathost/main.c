@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+
+static void usage(void) {
+    printf("usage: fathost [-i image] test\n"
+           "       fathost [-i image] fuzz [seed [iterations [sectors-per-cluster]]]\n"
+           "       fathost [-i image] fuzz-range first last [iterations]\n"
+           "       fathost [-i image] bench [size-mb [sectors-per-cluster]]\n"
+           "       fathost [-i image] bench-ram [size-mb [sectors-per-cluster]]\n"
+           "       fathost check image\n");
+}
+
+static uint32_t arg(int argc, char **argv, int i, uint32_t def) {
+    return i < argc ? (uint32_t)strtoul(argv[i], NULL, 0) : def;
+}
+
+int main(int argc, char **argv) {
+    const char *image = "fathost.img";
+    int a = 1;
+
+    if (a + 1 < argc && strcmp(argv[a], "-i") == 0) {
+        image = argv[a + 1];
+        a += 2;
+    }
+    if (a >= argc) {
+        usage();
+        return 2;
+    }
+
+    const char *cmd = argv[a++];
+    int rc;
+
+    if (strcmp(cmd, "test") == 0) {
+        rc = run_tests(image);
+    } else if (strcmp(cmd, "fuzz") == 0) {
+        rc = run_fuzz(image, arg(argc, argv, a, 1), arg(argc, argv, a + 1, 400), arg(argc, argv, a + 2, 1));
+    } else if (strcmp(cmd, "fuzz-range") == 0) {
+        uint32_t first = arg(argc, argv, a, 1), last = arg(argc, argv, a + 1, 20);
+        uint32_t iters = arg(argc, argv, a + 2, 400);
+        int failed = 0;
+        /* Cycle through 1, 2, 4 and 8 sectors per cluster */
+        for (uint32_t seed = first; seed <= last; seed++) {
+            if (run_fuzz(image, seed, iters, 1u << (seed % 4)) != 0) failed++;
+        }
+        printf("%d of %u seeds failed\n", failed, last - first + 1);
+        rc = failed ? -1 : 0;
+    } else if (strcmp(cmd, "bench") == 0) {
+        rc = run_bench(image, arg(argc, argv, a, 256), arg(argc, argv, a + 1, 8), 0);
+    } else if (strcmp(cmd, "bench-ram") == 0) {
+        rc = run_bench(image, arg(argc, argv, a, 256), arg(argc, argv, a + 1, 8), 1);
+    } else if (strcmp(cmd, "check") == 0 && a < argc) {
+        rc = image_check(argv[a], 1) == 0 ? 0 : -1;
+        printf("%s: %s\n", argv[a], rc == 0 ? "clean" : "problems found");
+    } else {
+        usage();
+        return 2;
+    }
+    return rc == 0 ? 0 : 1;
+}
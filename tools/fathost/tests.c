@@ -0,0 +1,450 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "host.h"
+#include "drivers/blkdev.h"
+#include "drivers/fat32.h"
+#include "drivers/ramdisk.h"
+
+/* Correctness tests. Each one starts from a freshly formatted image and the
+ * image is checked offline after it has been unmounted. */
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("    line %d: ", __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        return -1; \
+    } \
+} while (0)
+
+static uint32_t cluster_bytes;
+static const char *test_image;
+
+static void fill(uint8_t *buf, uint32_t size, uint32_t seed) {
+    for (uint32_t i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = (uint8_t)(seed >> 16);
+    }
+}
+
+static int write_file(const char *path, const uint8_t *data, uint32_t size, uint32_t chunk) {
+    fat32_file_t *f = fat32_open(path, "w");
+    if (!f) return -1;
+    uint32_t done = 0;
+    while (done < size) {
+        uint32_t n = size - done < chunk ? size - done : chunk;
+        if (fat32_write(f, data + done, n) != (int)n) {
+            fat32_close(f);
+            return -1;
+        }
+        done += n;
+    }
+    fat32_close(f);
+    return 0;
+}
+
+/* Read the whole file back in uneven pieces and compare. */
+static int verify_file(const char *path, const uint8_t *data, uint32_t size) {
+    fat32_file_t *f = fat32_open(path, "r");
+    if (!f) return -1;
+    if (f->size != size) {
+        fat32_close(f);
+        return -1;
+    }
+
+    uint8_t *buf = malloc(size + 4096);
+    uint32_t got = 0, step = 1;
+    int n;
+    while ((n = fat32_read(f, buf + got, step)) > 0) {
+        got += (uint32_t)n;
+        step = step * 3 + 7;
+        if (step > 4096) step = 1;
+    }
+    fat32_close(f);
+
+    int ok = n == 0 && got == size && memcmp(buf, data, size) == 0;
+    free(buf);
+    return ok ? 0 : -1;
+}
+
+static uint32_t free_clusters(void) {
+    uint32_t total = 0, free_count = 0, bytes = 0;
+    if (fat32_statfs('C', &total, &free_count, &bytes) != 0) return 0;
+    return free_count;
+}
+
+static int test_empty_volume(void) {
+    uint32_t total = 0, free_count = 0;
+    CHECK(fat32_statfs('C', &total, &free_count, &cluster_bytes) == 0, "statfs failed");
+    CHECK(total > 0 && free_count == total - 1, "total %u free %u", total, free_count);
+
+    fat32_dirent_t entries[4];
+    CHECK(fat32_list_dir("C:/", entries, 4) == 0, "root directory not empty");
+    CHECK(fat32_open("C:/NOPE.TXT", "r") == NULL, "opened a file that does not exist");
+    return 0;
+}
+
+static int test_roundtrip(void) {
+    uint32_t sizes[] = { 0, 1, 511, 512, 513, cluster_bytes - 1, cluster_bytes, cluster_bytes + 1,
+                         100000, 1 << 20 };
+    int count = (int)(sizeof(sizes) / sizeof(sizes[0]));
+    uint8_t *data = malloc(1 << 20);
+    char path[32];
+
+    for (int i = 0; i < count; i++) {
+        snprintf(path, sizeof(path), "C:/R%d.BIN", i);
+        fill(data, sizes[i], (uint32_t)i);
+        CHECK(write_file(path, data, sizes[i], 1000 + i * 777) == 0, "write %s", path);
+        CHECK(verify_file(path, data, sizes[i]) == 0, "%s differs before remount", path);
+    }
+    CHECK(host_remount() == 0, "remount");
+    for (int i = 0; i < count; i++) {
+        snprintf(path, sizeof(path), "C:/R%d.BIN", i);
+        fill(data, sizes[i], (uint32_t)i);
+        CHECK(verify_file(path, data, sizes[i]) == 0, "%s differs after remount", path);
+    }
+    free(data);
+    return 0;
+}
+
+static int test_overwrite(void) {
+    uint8_t data[30000], patch[12000];
+    fill(data, 20000, 1);
+    fill(patch, sizeof(patch), 2);
+    CHECK(write_file("C:/OVER.DAT", data, 20000, 20000) == 0, "write");
+
+    fat32_file_t *f = fat32_open("C:/OVER.DAT", "a");
+    CHECK(f, "open for update");
+    CHECK(fat32_seek(f, 15000) == 0, "seek");
+    CHECK(fat32_write(f, patch, sizeof(patch)) == (int)sizeof(patch), "write past the end");
+    CHECK(fat32_tell(f) == 27000, "position %u", fat32_tell(f));
+    fat32_close(f);
+
+    memcpy(data + 15000, patch, sizeof(patch));
+    CHECK(verify_file("C:/OVER.DAT", data, 27000) == 0, "contents after overwrite");
+
+    CHECK(write_file("C:/OVER.DAT", patch, 100, 100) == 0, "truncating rewrite");
+    CHECK(verify_file("C:/OVER.DAT", patch, 100) == 0, "contents after truncation");
+    return 0;
+}
+
+static int test_seek(void) {
+    uint32_t size = 300000;
+    uint8_t *data = malloc(size);
+    uint8_t buf[5000];
+    fill(data, size, 3);
+    CHECK(write_file("C:/SEEK.BIN", data, size, 65536) == 0, "write");
+
+    fat32_file_t *f = fat32_open("C:/SEEK.BIN", "r");
+    CHECK(f, "open");
+    uint32_t pos = 12345;
+    for (int i = 0; i < 200; i++) {
+        pos = (pos * 7919 + 104729) % size;
+        uint32_t len = 1 + (pos % sizeof(buf));
+        uint32_t expect = pos + len > size ? size - pos : len;
+        CHECK(fat32_seek(f, pos) == 0, "seek %u", pos);
+        int n = fat32_read(f, buf, len);
+        CHECK(n == (int)expect && memcmp(buf, data + pos, expect) == 0, "read %u at %u", len, pos);
+    }
+    CHECK(fat32_seek(f, size) == 0 && fat32_read(f, buf, 10) == 0, "read at end of file");
+    fat32_close(f);
+    free(data);
+    return 0;
+}
+
+static int test_copy(void) {
+    uint32_t size = (1 << 20) + 123;
+    uint8_t *data = malloc(size);
+    fill(data, size, 8);
+    CHECK(write_file("C:/ORIG.BIN", data, size, 65536) == 0, "write");
+
+    fat32_file_t *src = fat32_open("C:/ORIG.BIN", "r");
+    fat32_file_t *dst = fat32_open("C:/COPY.BIN", "w");
+    CHECK(src && dst, "open");
+    uint32_t total = 0;
+    int n;
+    while ((n = fat32_copy(dst, src, 100000)) > 0) total += (uint32_t)n;
+    fat32_close(dst);
+    CHECK(n == 0 && total == size, "copied %u of %u, last result %d", total, size, n);
+    CHECK(verify_file("C:/COPY.BIN", data, size) == 0, "copy differs");
+
+    /* Starting part way into a cluster */
+    dst = fat32_open("C:/TAIL.BIN", "w");
+    CHECK(dst && fat32_seek(src, 777) == 0, "open tail");
+    CHECK(fat32_copy(dst, src, size) == (int)(size - 777), "tail copy");
+    fat32_close(dst);
+    fat32_close(src);
+    CHECK(verify_file("C:/TAIL.BIN", data + 777, size - 777) == 0, "tail differs");
+    free(data);
+    return 0;
+}
+
+static int test_preallocate(void) {
+    uint32_t size = 300000, written = 200000;
+    uint32_t need = (size + cluster_bytes - 1) / cluster_bytes;
+    uint32_t keep = (written + cluster_bytes - 1) / cluster_bytes;
+    uint8_t *data = malloc(size);
+    fill(data, size, 9);
+    uint32_t before = free_clusters();
+
+    fat32_file_t *f = fat32_open("C:/PRE.BIN", "w");
+    CHECK(f && fat32_preallocate(f, size) == 0, "preallocate");
+    CHECK(f->size == 0, "size %u after preallocating", f->size);
+    CHECK(free_clusters() == before - need, "free %u, expected %u", free_clusters(), before - need);
+    CHECK(f->last_cluster - f->first_cluster + 1 == need, "reserved run is not contiguous");
+
+    /* Small appends interleaved with another file growing */
+    fat32_file_t *g = fat32_open("C:/OTHER.BIN", "w");
+    CHECK(g, "open other");
+    for (uint32_t done = 0; done < written; done += 1000) {
+        CHECK(fat32_write(f, data + done, 1000) == 1000, "append at %u", done);
+        CHECK(fat32_write(g, data, 100) == 100, "other append");
+    }
+    CHECK(f->size == written, "size %u, expected %u", f->size, written);
+    uint32_t other = (g->size + cluster_bytes - 1) / cluster_bytes;
+    fat32_close(g);
+    fat32_close(f);
+
+    CHECK(free_clusters() == before - keep - other, "free %u after close, expected %u",
+          free_clusters(), before - keep - other);
+    CHECK(verify_file("C:/PRE.BIN", data, written) == 0, "contents differ");
+    CHECK(host_remount() == 0, "remount");
+    CHECK(verify_file("C:/PRE.BIN", data, written) == 0, "contents differ after remount");
+
+    /* Only writers may reserve space */
+    f = fat32_open("C:/PRE.BIN", "r");
+    CHECK(f && fat32_preallocate(f, size) != 0, "preallocated a read-only file");
+    fat32_close(f);
+    free(data);
+    return 0;
+}
+
+/* Metadata is written back lazily; whatever fsync and sync return from
+ * must already be on the image. */
+static int test_sync(void) {
+    uint8_t data[10000];
+    fill(data, sizeof(data), 10);
+
+    fat32_file_t *f = fat32_open("C:/OPEN.BIN", "w");
+    CHECK(f && fat32_write(f, data, 5000) == 5000, "write");
+    CHECK(fat32_mkdir("C:/DIR") == 0, "mkdir");
+    CHECK(write_file("C:/DIR/GONE.TXT", data, 3000, 3000) == 0, "create");
+    CHECK(fat32_unlink("C:/DIR/GONE.TXT") == 0, "unlink");
+
+    uint64_t flushes = host_io.flushes;
+    CHECK(fat32_flush(f) == 0, "fsync");
+    CHECK(host_io.flushes > flushes, "fsync did not flush the disk cache");
+    CHECK(image_check(test_image, 1) == 0, "image after fsync");
+
+    CHECK(fat32_write(f, data + 5000, 5000) == 5000, "second write");
+    CHECK(write_file("C:/DIR/KEPT.TXT", data, 7000, 1000) == 0, "create");
+    CHECK(fat32_sync() == 0, "sync");
+    CHECK(image_check(test_image, 1) == 0, "image after sync");
+
+    /* The flusher writes the same things on its own */
+    CHECK(fat32_unlink("C:/DIR/KEPT.TXT") == 0, "unlink");
+    host_run_tasks();
+    CHECK(image_check(test_image, 1) == 0, "image after the flusher ran");
+    fat32_close(f);
+
+    /* Write-through: every operation is on disk when it returns */
+    fat32_set_writeback(0);
+    CHECK(write_file("C:/DIR/NOW.TXT", data, 9000, 4096) == 0, "create");
+    CHECK(image_check(test_image, 1) == 0, "image with write-through");
+    CHECK(verify_file("C:/OPEN.BIN", data, sizeof(data)) == 0, "contents");
+    return 0;
+}
+
+/* A RAM disk formatted in place and mounted as a second drive. */
+static int test_ramdisk(void) {
+    uint32_t sectors = 8 * 2048;
+    uint32_t size = 200000;
+    uint8_t *data = malloc(size);
+    fill(data, size, 11);
+
+    blkdev_t *dev = ramdisk_create("ramtest", sectors);
+    CHECK(dev && fat32_format(dev, 0, sectors, 0, "RAMTEST") == 0, "format");
+    CHECK(fat32_mount_device('R', dev, 0) == 0, "mount");
+    CHECK(fat32_format(dev, 0, sectors, 0, "AGAIN") != 0, "formatted a mounted device");
+
+    uint32_t total = 0, free_before = 0, cluster = 0;
+    CHECK(fat32_statfs('R', &total, &free_before, &cluster) == 0, "statfs");
+    CHECK(cluster == 512 && total > 0 && free_before == total - 1, "%u clusters, %u free, %u bytes",
+          total, free_before, cluster);
+
+    CHECK(write_file("C:/SRC.BIN", data, size, 4096) == 0, "write C:");
+    fat32_file_t *src = fat32_open("C:/SRC.BIN", "r");
+    fat32_file_t *dst = fat32_open("R:/DST.BIN", "w");
+    CHECK(src && dst, "open");
+    int n;
+    while ((n = fat32_copy(dst, src, 65536)) > 0) {}
+    fat32_close(dst);
+    fat32_close(src);
+    CHECK(n == 0, "copy to R:");
+    CHECK(fat32_mkdir("R:/SUB") == 0, "mkdir");
+    CHECK(write_file("R:/SUB/OWN.BIN", data, size / 2, 1000) == 0, "write R:");
+    CHECK(verify_file("R:/DST.BIN", data, size) == 0, "copy differs");
+    CHECK(verify_file("R:/SUB/OWN.BIN", data, size / 2) == 0, "contents differ");
+
+    uint32_t free_after = 0;
+    fat32_statfs('R', NULL, &free_after, NULL);
+    CHECK(free_after == free_before - 1 - (size + 511) / 512 - (size / 2 + 511) / 512,
+          "%u free after writing", free_after);
+
+    fat32_unmount_drive('R');
+    char path[512];
+    snprintf(path, sizeof(path), "%s.ram", test_image);
+    CHECK(host_dump(dev, path) == 0, "dump");
+    int problems = image_check(path, 1);
+    remove(path);
+    CHECK(problems == 0, "RAM disk image");
+    free(data);
+    return 0;
+}
+
+static int test_long_names(void) {
+    const char *name = "A fairly long file name.text";
+    uint8_t data[64];
+    fill(data, sizeof(data), 4);
+    CHECK(write_file("C:/A fairly long file name.text", data, sizeof(data), 64) == 0, "create");
+
+    fat32_dirent_t e;
+    CHECK(fat32_stat("C:/A FAIRLY LONG FILE NAME.TEXT", &e) == 0, "lookup ignores case");
+    CHECK(e.size == sizeof(data), "size %u", e.size);
+
+    fat32_dirent_t entries[8];
+    int n = fat32_list_dir("C:/", entries, 8);
+    CHECK(n == 1 && strcmp(entries[0].name, name) == 0, "listed %d entries, first '%s'",
+          n, n > 0 ? entries[0].name : "");
+    return 0;
+}
+
+static int test_directories(void) {
+    fat32_dirent_t e;
+    uint8_t data[10];
+    fill(data, sizeof(data), 5);
+
+    CHECK(fat32_mkdir("C:/ONE") == 0, "mkdir");
+    CHECK(fat32_mkdir("C:/ONE/TWO") == 0, "nested mkdir");
+    CHECK(fat32_mkdir("C:/ONE") != 0, "mkdir over an existing directory");
+    CHECK(write_file("C:/ONE/TWO/F.TXT", data, sizeof(data), 10) == 0, "create in subdirectory");
+    CHECK(fat32_stat("C:/ONE/TWO", &e) == 0 && e.is_directory, "stat directory");
+
+    CHECK(fat32_chdir("C:/ONE") == 0, "chdir");
+    CHECK(verify_file("TWO/F.TXT", data, sizeof(data)) == 0, "relative path");
+    CHECK(fat32_chdir("C:/") == 0, "chdir back");
+
+    CHECK(fat32_rmdir("C:/ONE/TWO") != 0, "removed a directory that is not empty");
+    CHECK(fat32_unlink("C:/ONE/TWO/F.TXT") == 0, "unlink");
+    CHECK(fat32_rmdir("C:/ONE/TWO") == 0, "rmdir");
+    CHECK(fat32_rmdir("C:/ONE") == 0, "rmdir parent");
+    CHECK(fat32_stat("C:/ONE", &e) != 0, "directory still there");
+    return 0;
+}
+
+static int test_rename(void) {
+    uint8_t data[5000];
+    fill(data, sizeof(data), 6);
+    CHECK(fat32_mkdir("C:/DST") == 0, "mkdir");
+    CHECK(write_file("C:/SRC.BIN", data, sizeof(data), 5000) == 0, "create");
+    CHECK(write_file("C:/DST/TAKEN.BIN", data, 10, 10) == 0, "create target");
+
+    CHECK(fat32_rename("C:/SRC.BIN", "C:/DST/TAKEN.BIN") != 0, "renamed over an existing file");
+    CHECK(fat32_rename("C:/SRC.BIN", "C:/DST/Moved here.bin") == 0, "rename");
+    CHECK(fat32_open("C:/SRC.BIN", "r") == NULL, "old name still resolves");
+    CHECK(verify_file("C:/DST/Moved here.bin", data, sizeof(data)) == 0, "contents after rename");
+    return 0;
+}
+
+static int test_unlink_frees(void) {
+    uint32_t before = free_clusters();
+    uint8_t *data = malloc(1 << 20);
+    fill(data, 1 << 20, 7);
+    CHECK(write_file("C:/BIG.BIN", data, 1 << 20, 65536) == 0, "write");
+    CHECK(free_clusters() < before, "no clusters allocated");
+    CHECK(fat32_unlink("C:/BIG.BIN") == 0, "unlink");
+    CHECK(free_clusters() == before, "free %u, expected %u", free_clusters(), before);
+    CHECK(fat32_unlink("C:/BIG.BIN") != 0, "unlinked twice");
+    free(data);
+    return 0;
+}
+
+static int test_big_directory(void) {
+    const int count = 600;
+    char path[64], name[64];
+    CHECK(fat32_mkdir("C:/MANY") == 0, "mkdir");
+    for (int i = 0; i < count; i++) {
+        snprintf(path, sizeof(path), "C:/MANY/%04d long name.txt", i);
+        CHECK(write_file(path, (const uint8_t*)path, (uint32_t)strlen(path), 64) == 0, "create %s", path);
+    }
+    CHECK(host_remount() == 0, "remount");
+
+    fat32_dir_t *dir = fat32_opendir("C:/MANY");
+    CHECK(dir, "opendir");
+    fat32_dirent_t e;
+    int n = 0;
+    while (fat32_readdir(dir, &e) == 1) {
+        snprintf(name, sizeof(name), "%04d long name.txt", n);
+        if (strcmp(name, e.name) != 0) break;
+        n++;
+    }
+    fat32_closedir(dir);
+    CHECK(n == count, "readdir stopped after %d entries", n);
+
+    snprintf(path, sizeof(path), "C:/MANY/%04d LONG NAME.TXT", count - 1);
+    CHECK(fat32_stat(path, &e) == 0, "lookup of the last entry");
+    return 0;
+}
+
+typedef struct {
+    const char *name;
+    int (*run)(void);
+} test_t;
+
+static const test_t tests[] = {
+    { "empty_volume", test_empty_volume },
+    { "roundtrip", test_roundtrip },
+    { "overwrite", test_overwrite },
+    { "seek", test_seek },
+    { "copy", test_copy },
+    { "preallocate", test_preallocate },
+    { "sync", test_sync },
+    { "ramdisk", test_ramdisk },
+    { "long_names", test_long_names },
+    { "directories", test_directories },
+    { "rename", test_rename },
+    { "unlink_frees", test_unlink_frees },
+    { "big_directory", test_big_directory },
+};
+
+int run_tests(const char *image) {
+    int failed = 0;
+    int count = (int)(sizeof(tests) / sizeof(tests[0]));
+    test_image = image;
+
+    for (int i = 0; i < count; i++) {
+        if (image_format(image, 64, 1) != 0 || host_mount(image) != 0) {
+            printf("%-16s cannot set up %s\n", tests[i].name, image);
+            return -1;
+        }
+        fat32_statfs('C', NULL, NULL, &cluster_bytes);
+        host_io_reset();
+
+        int rc = tests[i].run();
+        host_unmount();
+        int problems = image_check(image, 1);
+        if (rc == 0 && problems == 0) {
+            printf("%-16s ok    (%llu reads, %llu writes)\n", tests[i].name,
+                   (unsigned long long)host_io.reads, (unsigned long long)host_io.writes);
+        } else {
+            printf("%-16s FAIL%s\n", tests[i].name, problems ? " (image check)" : "");
+            failed++;
+        }
+    }
+
+    printf("%d of %d tests passed\n", count - failed, count);
+    return failed ? -1 : 0;
+}